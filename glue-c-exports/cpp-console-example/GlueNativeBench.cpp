@@ -0,0 +1,2483 @@
+/*
+ * Microbenchmarks for the Glue C exports helpers.
+ *
+ * Run from the console example with 'bench_<name>', e.g. 'bench_arena'.
+ * The benchmarks only build/consume payloads locally - nothing is sent to Glue.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "GlueNativeBench.h"
+#include "GlueArena.h"
+#include "GlueBatch.h"
+#include "GlueColumns.h"
+#include "GlueConflate.h"
+#include "GlueCoro.h"
+#include "GlueDiff.h"
+#include "GlueFlat.h"
+#include "GlueHash.h"
+#include "GlueInvokeAll.h"
+#include "GlueInvokeCache.h"
+#include "GlueJson.h"
+#include "GlueJsonReader.h"
+#include "GlueMicroBatch.h"
+#include "GluePath.h"
+#include "GluePipeline.h"
+#include "GlueReflect.h"
+#include "GlueSchema.h"
+#include "GlueShm.h"
+#include "GlueSingleFlight.h"
+#include "GlueSubscriberQueue.h"
+
+#ifdef GLUE_LOOPBACK
+#include "loopback/GlueLoopbackStats.h"
+#endif
+
+struct bench_contact
+{
+	std::string name;
+	std::string email;
+};
+
+GLUE_FIELDS(bench_contact, name, email);
+
+struct bench_quote
+{
+	std::string symbol;
+	double bid;
+	double ask;
+	long long size;
+	int level;
+	bool firm;
+	bench_contact trader;
+	std::vector<double> depth;
+	std::tuple<int, bool, double> tuple_ibd;
+};
+
+GLUE_FIELDS(bench_quote, symbol, bid, ask, size, level, firm, trader, depth, tuple_ibd);
+
+struct bench_book
+{
+	std::vector<bench_quote> quotes;
+	std::string source;
+};
+
+GLUE_FIELDS(bench_book, quotes, source);
+
+namespace
+{
+	/**
+	 * \brief Defeats dead code elimination of benchmarked results.
+	 */
+	volatile long long bench_sink;
+
+	/**
+	 * \brief Times iterations of a benchmark body and prints ns per iteration.
+	 */
+	template <typename F>
+	double measure(const char* label, int iterations, F&& body)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			body(i);
+		}
+		const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		const auto per_iteration = elapsed / iterations;
+		std::cout << "  " << label << ": " << per_iteration << " ns/op" << std::endl;
+		return per_iteration;
+	}
+
+	// arena - building the console example result with new[] per nested array vs glue_arena
+
+	void bench_arena()
+	{
+		const int iterations = 1000000;
+
+		const auto heap = measure("new[] + delete[]", iterations, [](int i)
+			{
+				glue_arg result[] = {
+					glarg_i("xyz", i),
+					glarg_s("some_string", "that's the one"),
+					glarg_comp("sender", new glue_arg[]
+					{
+						glarg_comp("contact", new glue_arg[]
+						{
+							glarg_s("name", "xaoc")
+						}, 1),
+						glarg_s("email", "xaoc@xaoc.xaoc")
+					}, 2),
+					glarg_dt("date", 1050500),
+					glarg_tuple("tuple_ibd", new glue_value[]{ glv_i(5), glv_b(true), glv_d(3.14) }, 3) };
+
+				bench_sink = bench_sink + result[0].value.i + result[2].value.len;
+
+				delete[] result[2].value.composite[0].value.composite;
+				delete[] result[2].value.composite;
+				delete[] result[4].value.tuple;
+			});
+
+		glue_arena arena;
+		const auto arena_time = measure("glue_arena", iterations, [&arena](int i)
+			{
+				glue_arg result[] = {
+					glarg_i("xyz", i),
+					glarg_s(arena, "some_string", "that's the one"),
+					glarg_comp(arena, "sender",
+					{
+						glarg_comp(arena, "contact",
+						{
+							glarg_s(arena, "name", "xaoc")
+						}),
+						glarg_s(arena, "email", "xaoc@xaoc.xaoc")
+					}),
+					glarg_dt("date", 1050500),
+					glarg_tuple(arena, "tuple_ibd", { glv_i(5), glv_b(true), glv_d(3.14) }) };
+
+				bench_sink = bench_sink + result[0].value.i + result[2].value.len;
+
+				// glue_push_payload(endpoint, result, std::size(result), arena) resets the arena after pushing
+				arena.reset();
+			});
+
+		std::cout << "  speedup: " << heap / arena_time << "x" << std::endl;
+	}
+
+	// reflect - glue_encode of a reflected struct vs the same payload built by hand
+
+	void bench_reflect()
+	{
+		const int iterations = 1000000;
+		const bench_quote quote{ "VOD.L", 101.25, 101.5, 5000, 1, true, { "xaoc", "xaoc@xaoc.xaoc" }, { 101.25, 101.0, 100.75, 100.5 }, { 5, true, 3.14 } };
+
+		glue_arena arena;
+		const auto by_hand = measure("hand-built glarg_*", iterations, [&arena, &quote](int i)
+			{
+				glue_arg result[] = {
+					glarg_s("symbol", quote.symbol.c_str()),
+					glarg_d("bid", quote.bid),
+					glarg_d("ask", quote.ask),
+					glarg_l("size", quote.size + i),
+					glarg_i("level", quote.level),
+					glarg_b("firm", quote.firm),
+					glarg_comp(arena, "trader",
+					{
+						glarg_s("name", quote.trader.name.c_str()),
+						glarg_s("email", quote.trader.email.c_str())
+					}),
+					glarg_dd("depth", const_cast<double*>(quote.depth.data()), static_cast<int>(quote.depth.size())),
+					glarg_tuple(arena, "tuple_ibd", { glv_i(std::get<0>(quote.tuple_ibd)), glv_b(std::get<1>(quote.tuple_ibd)), glv_d(std::get<2>(quote.tuple_ibd)) }) };
+
+				bench_sink = bench_sink + result[3].value.l + result[6].value.len;
+				arena.reset();
+			});
+
+		const auto reflected = measure("glue_encode", iterations, [&arena, &quote](int i)
+			{
+				const auto result = glue_encode(arena, quote);
+
+				bench_sink = bench_sink + result[3].value.l + i + result[6].value.len;
+				arena.reset();
+			});
+
+		std::cout << "  encode/hand-built: " << reflected / by_hand << std::endl;
+	}
+
+	// decode - glue_decode vs one root walk per field, as done by per-field glue_read_ calls
+
+	const glue_value* find_by_path(const glue_arg* args, int len, const char* field_path)
+	{
+		const glue_value* found = nullptr;
+		while (true)
+		{
+			const auto dot = strchr(field_path, '.');
+			const auto segment_len = dot != nullptr ? static_cast<size_t>(dot - field_path) : strlen(field_path);
+
+			found = nullptr;
+			for (int i = 0; i < len; ++i)
+			{
+				if (strncmp(args[i].name, field_path, segment_len) == 0 && args[i].name[segment_len] == 0)
+				{
+					found = &args[i].value;
+					break;
+				}
+			}
+
+			if (found == nullptr || dot == nullptr)
+			{
+				return found;
+			}
+			if (found->type != glue_type::glue_composite)
+			{
+				return nullptr;
+			}
+			args = found->composite;
+			len = found->len;
+			field_path = dot + 1;
+		}
+	}
+
+	void bench_decode()
+	{
+		const int iterations = 1000000;
+		const bench_quote quote{ "VOD.L", 101.25, 101.5, 5000, 1, true, { "xaoc", "xaoc@xaoc.xaoc" }, { 101.25, 101.0, 100.75, 100.5 }, { 5, true, 3.14 } };
+
+		glue_arena arena;
+		const auto args = glue_encode(arena, quote);
+		const glue_payload payload{ nullptr, "bench", 0, args.data(), static_cast<int>(args.size()) };
+
+		const auto by_path = measure("root walk per field", iterations, [&payload](int i)
+			{
+				bench_quote out{};
+				out.symbol = find_by_path(payload.args, payload.args_len, "symbol")->s;
+				out.bid = find_by_path(payload.args, payload.args_len, "bid")->d;
+				out.ask = find_by_path(payload.args, payload.args_len, "ask")->d;
+				out.size = find_by_path(payload.args, payload.args_len, "size")->l;
+				out.level = find_by_path(payload.args, payload.args_len, "level")->i;
+				out.firm = find_by_path(payload.args, payload.args_len, "firm")->b;
+				out.trader.name = find_by_path(payload.args, payload.args_len, "trader.name")->s;
+				out.trader.email = find_by_path(payload.args, payload.args_len, "trader.email")->s;
+				const auto depth = find_by_path(payload.args, payload.args_len, "depth");
+				out.depth.assign(depth->dd, depth->dd + depth->len);
+				const auto tuple = find_by_path(payload.args, payload.args_len, "tuple_ibd");
+				out.tuple_ibd = std::make_tuple(tuple->tuple[0].i, tuple->tuple[1].b, tuple->tuple[2].d);
+
+				bench_sink = bench_sink + out.size + i;
+			});
+
+		const auto decoded = measure("glue_decode", iterations, [&payload](int i)
+			{
+				const auto out = glue_decode<bench_quote>(payload);
+
+				bench_sink = bench_sink + out.size + i;
+			});
+
+		std::cout << "  speedup: " << by_path / decoded << "x" << std::endl;
+	}
+
+	// path - reading data.contact.displayName by string path vs by compiled path
+
+	void bench_path()
+	{
+		const int iterations = 5000000;
+
+		glue_arena arena;
+		const glue_arg context[] = {
+			glarg_s("type", "channel"),
+			glarg_comp(arena, "data",
+			{
+				glarg_s("ticker", "VOD.L"),
+				glarg_d("price", 101.25),
+				glarg_comp(arena, "contact",
+				{
+					glarg_s("id", "42"),
+					glarg_s("email", "xaoc@xaoc.xaoc"),
+					glarg_comp(arena, "name",
+					{
+						glarg_s("first", "John"),
+						glarg_s("last", "Smith")
+					}),
+					glarg_s("displayName", "John Smith")
+				})
+			})
+		};
+		const glue_payload payload{ nullptr, "bench", 0, context, static_cast<int>(std::size(context)) };
+
+		const auto by_string = measure("string path", iterations, [&payload](int i)
+			{
+				bench_sink = bench_sink + find_by_path(payload.args, payload.args_len, "data.contact.displayName")->s[i & 7];
+			});
+
+		const auto display_name = glue_compile_path("data.contact.displayName");
+		const auto compiled = measure("compiled path", iterations, [&payload, display_name](int i)
+			{
+				bench_sink = bench_sink + glue_read_s_p(&payload, display_name)[i & 7];
+			});
+		glue_delete_path(display_name);
+
+		std::cout << "  speedup: " << by_string / compiled << "x" << std::endl;
+	}
+
+	// batch - reading 32 paths of a deep context with one glue_read_batch vs 32 separate reads
+
+	void bench_batch()
+	{
+		const int iterations = 200000;
+		const int width = 8;
+
+		// data.book.section<s>.level<l>.{bid, ask, size, venue} - 8 x 8 x 4 leaves, 5 levels deep
+		glue_arena arena;
+		std::vector<std::string> names;
+		for (int i = 0; i < width; ++i)
+		{
+			names.push_back("section" + std::to_string(i));
+			names.push_back("level" + std::to_string(i));
+		}
+
+		std::vector<glue_arg> sections;
+		for (int s = 0; s < width; ++s)
+		{
+			std::vector<glue_arg> levels;
+			for (int l = 0; l < width; ++l)
+			{
+				levels.push_back(glarg_comp(arena, names[l * 2 + 1].c_str(),
+				{
+					glarg_d("bid", 100.0 + l),
+					glarg_d("ask", 100.5 + l),
+					glarg_l("size", 1000LL * s + l),
+					glarg_s("venue", "XLON")
+				}));
+			}
+			sections.push_back(glarg_comp(arena, names[s * 2].c_str(), levels.data(), width));
+		}
+		const glue_arg context[] = {
+			glarg_s("type", "channel"),
+			glarg_comp(arena, "data",
+			{
+				glarg_s("ticker", "VOD.L"),
+				glarg_comp(arena, "book", sections.data(), width)
+			})
+		};
+		const glue_payload payload{ nullptr, "bench", 0, context, static_cast<int>(std::size(context)) };
+
+		// 32 paths - 4 fields of 8 levels spread over the sections
+		std::vector<std::string> path_texts;
+		for (int l = 0; l < width; ++l)
+		{
+			for (const auto field : { "bid", "ask", "size", "venue" })
+			{
+				path_texts.push_back("data.book." + names[(l % 4) * 2] + "." + names[l * 2 + 1] + "." + field);
+			}
+		}
+		std::vector<const char*> paths;
+		std::vector<const glue_path*> compiled_paths;
+		for (const auto& text : path_texts)
+		{
+			paths.push_back(text.c_str());
+			compiled_paths.push_back(glue_compile_path(text.c_str()));
+		}
+		const auto n = static_cast<int>(paths.size());
+		std::vector<glue_value> out(n);
+
+		const auto by_string = measure("32 string path reads", iterations, [&](int i)
+			{
+				for (int p = 0; p < n; ++p)
+				{
+					out[p] = *find_by_path(payload.args, payload.args_len, paths[p]);
+				}
+				bench_sink = bench_sink + out[i % n].len;
+			});
+
+		const auto by_compiled = measure("32 compiled path reads", iterations, [&](int i)
+			{
+				for (int p = 0; p < n; ++p)
+				{
+					out[p] = glue_read_glue_value_p(&payload, compiled_paths[p]);
+				}
+				bench_sink = bench_sink + out[i % n].len;
+			});
+
+		const auto batch = glue_compile_batch(paths.data(), n);
+		const auto batched = measure("glue_read_batch", iterations, [&](int i)
+			{
+				bench_sink = bench_sink + glue_read_batch(&payload, batch, out.data()) + out[i % n].len;
+			});
+
+		glue_delete_batch(batch);
+		for (const auto path : compiled_paths)
+		{
+			glue_delete_path(path);
+		}
+
+		std::cout << "  speedup vs string paths: " << by_string / batched << "x, vs compiled paths: " << by_compiled / batched << "x" << std::endl;
+	}
+
+	// index - reading 10 fields of a 100 field composite, linearly vs through a glue_index_cache
+
+	void bench_index()
+	{
+		const int iterations = 500000;
+		const int width = 100;
+
+		std::vector<std::string> names;
+		for (int i = 0; i < width; ++i)
+		{
+			names.push_back("field" + std::to_string(i));
+		}
+
+		std::vector<glue_arg> fields;
+		for (int i = 0; i < width; ++i)
+		{
+			fields.push_back(glarg_d(names[i].c_str(), i * 0.5));
+		}
+		const glue_arg record[] = { glarg_comp("record", fields.data(), width) };
+		const glue_payload payload{ nullptr, "bench", 0, record, 1 };
+
+		std::vector<const glue_path*> paths;
+		for (int i = 0; i < 10; ++i)
+		{
+			paths.push_back(glue_compile_path(("record." + names[width - 1 - i * 7]).c_str()));
+		}
+
+		const auto linear = measure("linear scan", iterations, [&](int i)
+			{
+				double sum = 0;
+				for (const auto path : paths)
+				{
+					sum += glue_read_d_p(&payload, path);
+				}
+				bench_sink = bench_sink + static_cast<long long>(sum) + i;
+			});
+
+		glue_index_cache cache;
+		const auto indexed = measure("glue_index_cache", iterations, [&](int i)
+			{
+				double sum = 0;
+				for (const auto path : paths)
+				{
+					sum += glue_read_d_p(&payload, path, &cache);
+				}
+				bench_sink = bench_sink + static_cast<long long>(sum) + i;
+			});
+
+		for (const auto path : paths)
+		{
+			glue_delete_path(path);
+		}
+
+		std::cout << "  speedup: " << linear / indexed << "x" << std::endl;
+	}
+
+	void bench_columns()
+	{
+		const int iterations = 200;
+		const int row_count = 50000;
+
+		const char* symbols[] = { "VOD.L", "BARC.L", "HSBA.L", "BP.L" };
+		std::vector<glue_arg> fields;
+		fields.reserve(static_cast<size_t>(row_count) * 3);
+		std::vector<glue_arg> rows;
+		for (int r = 0; r < row_count; ++r)
+		{
+			const auto row = fields.data() + fields.size();
+			fields.push_back(glarg_s("symbol", symbols[r % 4]));
+			fields.push_back(glarg_d("price", 100 + (r % 97) * 0.25));
+			fields.push_back(glarg_l("size", 100 + r % 1000));
+			rows.push_back(glarg_comp("", row, 3));
+		}
+		const auto trades = glv_comps(rows.data(), row_count);
+
+		const auto price_path = glue_compile_path("price");
+		const auto size_path = glue_compile_path("size");
+		const auto by_row = measure("vwap by row", iterations, [&](int i)
+			{
+				double notional = 0;
+				long long volume = 0;
+				for (int r = 0; r < row_count; ++r)
+				{
+					const auto& row = trades.composite[r].value;
+					const auto size = glue_read_l_p(row, size_path);
+					notional += glue_read_d_p(row, price_path) * static_cast<double>(size);
+					volume += size;
+				}
+				bench_sink = bench_sink + static_cast<long long>(notional / static_cast<double>(volume)) + i;
+			});
+		glue_delete_path(price_path);
+		glue_delete_path(size_path);
+
+		glue_columns columns;
+		const auto build = measure("glue_columns build", iterations, [&](int i)
+			{
+				columns.build(trades);
+				bench_sink = bench_sink + columns.rows() + i;
+			});
+
+		const auto price = columns.find("price")->d;
+		const auto size = columns.find("size")->l;
+		const auto vwap = measure("glue_column_vwap", iterations, [&](int i)
+			{
+				bench_sink = bench_sink + static_cast<long long>(glue_column_vwap(price, size, row_count)) + i;
+			});
+
+		measure("glue_column_sum/min/max", iterations, [&](int i)
+			{
+				const auto total = glue_column_sum(price, row_count) + glue_column_min(price, row_count) + glue_column_max(price, row_count);
+				bench_sink = bench_sink + static_cast<long long>(total) + i;
+			});
+
+		std::cout << "  speedup (aggregate only): " << by_row / vwap << "x" << std::endl;
+		std::cout << "  speedup (build + aggregate): " << by_row / (build + vwap) << "x" << std::endl;
+	}
+
+	// flat - deep copying a payload tree per allocation vs into a single flat block
+
+	glue_value deep_copy(const glue_value& v);
+
+	const char* deep_copy(const char* s)
+	{
+		if (s == nullptr)
+		{
+			return nullptr;
+		}
+		const auto len = strlen(s) + 1;
+		const auto copy = new char[len];
+		memcpy(copy, s, len);
+		return copy;
+	}
+
+	glue_arg* deep_copy(const glue_arg* args, int len)
+	{
+		const auto copy = new glue_arg[len];
+		for (int i = 0; i < len; ++i)
+		{
+			copy[i].name = deep_copy(args[i].name);
+			copy[i].value = deep_copy(args[i].value);
+		}
+		return copy;
+	}
+
+	glue_value deep_copy(const glue_value& v)
+	{
+		auto copy = v;
+		if (v.len < 0)
+		{
+			copy.s = v.type == glue_type::glue_string ? deep_copy(v.s) : v.s;
+			return copy;
+		}
+
+		switch (v.type)
+		{
+		case glue_type::glue_double:
+			copy.dd = new double[v.len];
+			memcpy(copy.dd, v.dd, v.len * sizeof(double));
+			break;
+		case glue_type::glue_tuple:
+			copy.tuple = new glue_value[v.len];
+			for (int i = 0; i < v.len; ++i)
+			{
+				copy.tuple[i] = deep_copy(v.tuple[i]);
+			}
+			break;
+		case glue_type::glue_composite:
+		case glue_type::glue_composite_array:
+			copy.composite = deep_copy(v.composite, v.len);
+			break;
+		default:
+			break;
+		}
+		return copy;
+	}
+
+	void deep_delete(const glue_value& v)
+	{
+		if (v.len < 0)
+		{
+			if (v.type == glue_type::glue_string)
+			{
+				delete[] v.s;
+			}
+			return;
+		}
+
+		switch (v.type)
+		{
+		case glue_type::glue_double:
+			delete[] v.dd;
+			break;
+		case glue_type::glue_tuple:
+			for (int i = 0; i < v.len; ++i)
+			{
+				deep_delete(v.tuple[i]);
+			}
+			delete[] v.tuple;
+			break;
+		case glue_type::glue_composite:
+		case glue_type::glue_composite_array:
+			for (int i = 0; i < v.len; ++i)
+			{
+				delete[] v.composite[i].name;
+				deep_delete(v.composite[i].value);
+			}
+			delete[] v.composite;
+			break;
+		default:
+			break;
+		}
+	}
+
+	void bench_flat()
+	{
+		const int iterations = 20000;
+
+		glue_arena arena;
+		std::vector<bench_quote> quotes;
+		for (int i = 0; i < 32; ++i)
+		{
+			quotes.push_back(bench_quote{ "VOD.L", 101.25 + i, 101.5 + i, 5000, i, true, { "xaoc", "xaoc@xaoc.xaoc" }, { 101.25, 101.0, 100.75, 100.5 }, { 5, true, 3.14 } });
+		}
+		const auto book = glue_encode_value(arena, quotes);
+
+		const auto deep = measure("deep copy + delete", iterations, [&book](int i)
+			{
+				const auto copy = deep_copy(book);
+				bench_sink = bench_sink + copy.len + i;
+				deep_delete(copy);
+			});
+
+		const auto flat = measure("glue_flatten + glue_delete_flat", iterations, [&book](int i)
+			{
+				const auto copy = glue_flatten(book);
+				bench_sink = bench_sink + glue_flat_value(copy).len + i;
+				glue_delete_flat(copy);
+			});
+
+		const auto block = glue_flatten(book);
+		const auto copied = measure("glue_flat_copy + glue_delete_flat", iterations, [block](int i)
+			{
+				const auto copy = glue_flat_copy(block);
+				bench_sink = bench_sink + glue_flat_value(copy).len + i;
+				glue_delete_flat(copy);
+			});
+		std::cout << "  block size: " << glue_flat_size(block) << " bytes" << std::endl;
+		glue_delete_flat(block);
+
+		std::cout << "  speedup (flatten): " << deep / flat << "x" << std::endl;
+		std::cout << "  speedup (flat copy): " << deep / copied << "x" << std::endl;
+	}
+
+	// diff - republishing a wide context where a single field moves: flattening the whole context vs diffing it
+
+	void bench_diff()
+	{
+		const int iterations = 2000;
+		const int sections = 20;
+		const int width = 100;
+
+		std::vector<std::string> names;
+		for (int i = 0; i < width; ++i)
+		{
+			names.push_back("field" + std::to_string(i));
+		}
+		std::vector<std::string> section_names;
+		for (int i = 0; i < sections; ++i)
+		{
+			section_names.push_back("section" + std::to_string(i));
+		}
+
+		std::vector<glue_arg> previous_fields;
+		for (int s = 0; s < sections; ++s)
+		{
+			for (int i = 0; i < width; ++i)
+			{
+				previous_fields.push_back(glarg_d(names[i].c_str(), s * width + i));
+			}
+		}
+		auto current_fields = previous_fields;
+		current_fields[7 * width + 42] = glarg_d(names[42].c_str(), -1);
+
+		std::vector<glue_arg> previous_sections;
+		std::vector<glue_arg> current_sections;
+		for (int s = 0; s < sections; ++s)
+		{
+			previous_sections.push_back(glarg_comp(section_names[s].c_str(), previous_fields.data() + s * width, width));
+			current_sections.push_back(glarg_comp(section_names[s].c_str(), current_fields.data() + s * width, width));
+		}
+		const auto previous = glv_comp(previous_sections.data(), sections);
+		const auto current = glv_comp(current_sections.data(), sections);
+
+		const auto whole = measure("flatten the whole context", iterations, [&current](int i)
+			{
+				const auto flat = glue_flatten(current);
+				bench_sink = bench_sink + static_cast<long long>(glue_flat_size(flat)) + i;
+				glue_delete_flat(flat);
+			});
+
+		std::vector<glue_change> patch;
+		const auto diffed = measure("glue_diff", iterations, [&](int i)
+			{
+				patch.clear();
+				bench_sink = bench_sink + glue_diff(previous, current, patch, "data") + i;
+			});
+
+		const auto full = glue_flatten(current);
+		size_t patch_size = 0;
+		for (const auto& change : patch)
+		{
+			const auto flat = glue_flatten(change.value);
+			patch_size += change.path.size() + glue_flat_size(flat);
+			glue_delete_flat(flat);
+		}
+		std::cout << "  written: " << glue_flat_size(full) << " bytes in 1 write vs " << patch_size << " bytes in " << patch.size() << " write(s)" << std::endl;
+		std::cout << "  patch: " << patch[0].path << std::endl;
+		glue_delete_flat(full);
+
+		std::cout << "  diff cost relative to a full flatten: " << diffed / whole << "x" << std::endl;
+	}
+
+	// hash - hashing and comparing numeric arrays element by element vs as whole blocks
+
+	void bench_hash()
+	{
+		const int iterations = 20000;
+		const int len = 4096;
+
+		std::vector<double> prices(len);
+		std::vector<long long> sizes(len);
+		for (int i = 0; i < len; ++i)
+		{
+			prices[i] = 100 + i * 0.01;
+			sizes[i] = i * 100;
+		}
+		auto prices_copy = prices;
+		auto sizes_copy = sizes;
+		const glue_arg a[] = { glarg_s("symbol", "VOD.L"), glarg_dd("prices", prices.data(), len), glarg_ll("sizes", sizes.data(), len) };
+		const glue_arg b[] = { glarg_s("symbol", "VOD.L"), glarg_dd("prices", prices_copy.data(), len), glarg_ll("sizes", sizes_copy.data(), len) };
+
+		const auto by_element = measure("hash + compare per element", iterations, [&](int i)
+			{
+				uint64_t h = 0;
+				bool equal = true;
+				for (int f = 1; f < 3; ++f)
+				{
+					const auto& x = a[f].value;
+					const auto& y = b[f].value;
+					for (int e = 0; e < len; ++e)
+					{
+						uint64_t bits;
+						memcpy(&bits, x.type == glue_type::glue_double ? static_cast<const void*>(&x.dd[e]) : &x.ll[e], sizeof(bits));
+						h = glue_hash_combine(h, bits);
+						equal = equal && (x.type == glue_type::glue_double ? x.dd[e] == y.dd[e] : x.ll[e] == y.ll[e]);
+					}
+				}
+				bench_sink = bench_sink ^ static_cast<long long>(h ^ (equal ? 1 : 0) ^ i);
+			});
+
+		const auto by_block = measure("glue_args_hash + glue_args_equal", iterations, [&](int i)
+			{
+				const auto h = glue_args_hash(a, 3);
+				const auto equal = glue_args_equal(a, 3, b, 3);
+				bench_sink = bench_sink ^ static_cast<long long>(h ^ (equal ? 1 : 0) ^ i);
+			});
+
+		std::cout << "  speedup: " << by_element / by_block << "x" << std::endl;
+	}
+
+	// json - relaxed JSON parsing throughput and a differential check of the parser's results
+
+	std::string bench_json_text(int records, bool pretty)
+	{
+		const auto nl = pretty ? "\n  " : "";
+		std::string json = "{quotes: [";
+		for (int r = 0; r < records; ++r)
+		{
+			json += r > 0 ? "," : "";
+			json += nl;
+			json += "{symbol: 'VOD.L', venue: \"XLON\", bid: " + std::to_string(100 + r * 0.25) + ", ask: " + std::to_string(100.5 + r * 0.25);
+			json += ", size: " + std::to_string(1000 + r) + ", firm: " + (r % 2 ? "true" : "false");
+			json += ", trader: {name: 'xaoc', email: \"xaoc@xaoc.xaoc\", desk: 'EMEA equities \\'cash\\''}";
+			json += ", depth: [101.25, 101, 100.75, 100.5], levels: [1, 2, 3, 4]}";
+		}
+		json += nl;
+		json += "], source: 'bench'}";
+		return json;
+	}
+
+	void bench_json()
+	{
+		const int iterations = 200;
+
+		glue_arena arena;
+		glue_json_parser parser;
+
+		// differential check - the console example's texts against the values they denote, and a compact against a pretty printed text
+		glue_value v;
+		const glue_arg y[] = { glarg_i("a", 51), glarg_s("s", "hello") };
+		const glue_arg expected[] = { glarg_i("x", 5), glarg_comp("y", const_cast<glue_arg*>(y), 2) };
+		auto checks = parser.parse(arena, "{x: 5, y: {a: 51, s: \"hello\"}}", v) == 0 && glue_value_equal(v, glv_comp(const_cast<glue_arg*>(expected), 2));
+
+		const char* items[] = { "red", "white" };
+		const glue_arg fruit[] = { glarg_s("type", "apples"), glarg_ss("items", items, 2) };
+		const glue_arg fruits[] = { glarg_comp("fruits", const_cast<glue_arg*>(fruit), 2) };
+		checks = checks && parser.parse(arena, "{fruits: {type: 'apples', items: ['red', 'white']}}", v) == 0 && glue_value_equal(v, glv_comp(const_cast<glue_arg*>(fruits), 1));
+
+		const auto compact = bench_json_text(2000, false);
+		const auto pretty = bench_json_text(2000, true);
+		glue_value pretty_value;
+		checks = checks && parser.parse(arena, compact.c_str(), compact.size(), v) == 0 && parser.parse(arena, pretty.c_str(), pretty.size(), pretty_value) == 0 && glue_value_equal(v, pretty_value);
+		std::cout << "  differential check: " << (checks ? "passed" : "FAILED") << std::endl;
+		arena.reset();
+
+		const auto per_parse = measure("glue_json_parser", iterations, [&](int i)
+			{
+				glue_value parsed;
+				parser.parse(arena, compact.c_str(), compact.size(), parsed);
+				bench_sink = bench_sink + parsed.len + i;
+				arena.reset();
+			});
+
+		std::cout << "  throughput: " << compact.size() / per_parse * 1e9 / (1024 * 1024) << " MB/s (" << compact.size() << " bytes)" << std::endl;
+	}
+
+	// json_write - a stringstream based writer, as the console example used to dump payloads, vs glue_write_json
+
+	void stream_json(const glue_value& v, std::stringstream& str)
+	{
+		if (v.type == glue_type::glue_composite)
+		{
+			str << "{";
+			for (int i = 0; i < v.len; ++i)
+			{
+				str << (i > 0 ? "," : "") << "\"" << v.composite[i].name << "\":";
+				stream_json(v.composite[i].value, str);
+			}
+			str << "}";
+			return;
+		}
+
+		if (v.len < 0)
+		{
+			switch (v.type)
+			{
+			case glue_type::glue_bool: str << (v.b ? "true" : "false"); break;
+			case glue_type::glue_int: str << v.i; break;
+			case glue_type::glue_long: str << v.l; break;
+			case glue_type::glue_double: str << std::setprecision(17) << v.d; break;
+			case glue_type::glue_string: str << "\"" << v.s << "\""; break;
+			default: str << "null";
+			}
+			return;
+		}
+
+		str << "[";
+		for (int i = 0; i < v.len; ++i)
+		{
+			str << (i > 0 ? "," : "");
+			switch (v.type)
+			{
+			case glue_type::glue_bool: str << (v.bb[i] ? "true" : "false"); break;
+			case glue_type::glue_int: str << v.ii[i]; break;
+			case glue_type::glue_long: str << v.ll[i]; break;
+			case glue_type::glue_double: str << std::setprecision(17) << v.dd[i]; break;
+			case glue_type::glue_string: str << "\"" << v.ss[i] << "\""; break;
+			case glue_type::glue_tuple: stream_json(v.tuple[i], str); break;
+			case glue_type::glue_composite_array: stream_json(v.composite[i].value, str); break;
+			default: str << "null";
+			}
+		}
+		str << "]";
+	}
+
+	void bench_json_write()
+	{
+		const int iterations = 200;
+
+		glue_arena arena;
+		glue_json_parser parser;
+		const auto text = bench_json_text(2000, false);
+		glue_value v;
+		parser.parse(arena, text.c_str(), text.size(), v);
+
+		const auto streamed = measure("std::stringstream", iterations, [&](int i)
+			{
+				std::stringstream str;
+				stream_json(v, str);
+				bench_sink = bench_sink + static_cast<long long>(str.str().size()) + i;
+			});
+
+		std::string json;
+		const auto written = measure("glue_write_json", iterations, [&](int i)
+			{
+				json.clear();
+				glue_write_json(v, json);
+				bench_sink = bench_sink + static_cast<long long>(json.size()) + i;
+			});
+
+		glue_value back;
+		const auto round_trip = parser.parse(arena, json.c_str(), json.size(), back) == 0 && glue_value_equal(v, back);
+		std::cout << "  round trip: " << (round_trip ? "passed" : "FAILED") << std::endl;
+		std::cout << "  throughput: " << json.size() / written * 1e9 / (1024 * 1024) << " MB/s (" << json.size() << " bytes)" << std::endl;
+		std::cout << "  speedup: " << streamed / written << "x" << std::endl;
+	}
+
+	// lazy - reading 3 fields of a large JSON payload: parsing it whole vs a lazy reader
+
+	void bench_lazy()
+	{
+		const int iterations = 200;
+
+		const auto json = "{meta: {id: 42, owner: 'xaoc'}, book: " + bench_json_text(2000, false) + "}";
+		const char* paths[] = { "meta.id", "meta.owner", "book.source" };
+
+		glue_arena arena;
+		glue_json_parser parser;
+		std::vector<const glue_path*> compiled;
+		for (const auto path : paths)
+		{
+			compiled.push_back(glue_compile_path(path));
+		}
+		const auto parsed = measure("parse whole + read", iterations, [&](int i)
+			{
+				glue_value v;
+				parser.parse(arena, json.c_str(), json.size(), v);
+				const auto id = glue_read_i_p(v, compiled[0]);
+				const auto owner = glue_read_s_p(v, compiled[1]);
+				const auto source = glue_read_s_p(v, compiled[2]);
+				bench_sink = bench_sink + id + strlen(owner) + strlen(source) + i;
+				arena.reset();
+			});
+		for (const auto path : compiled)
+		{
+			glue_delete_path(path);
+		}
+
+		const auto lazy = measure("glue_open_json_reader + read", iterations, [&](int i)
+			{
+				const auto reader = glue_open_json_reader(json.c_str(), json.size(), false);
+				const auto id = glue_read_i_lazy(reader, paths[0]);
+				const auto owner = glue_read_s_lazy(reader, paths[1]);
+				const auto source = glue_read_s_lazy(reader, paths[2]);
+				bench_sink = bench_sink + id + strlen(owner) + strlen(source) + i;
+				glue_destroy_json_reader(reader);
+			});
+
+		std::cout << "  speedup: " << parsed / lazy << "x" << std::endl;
+	}
+
+	// schema - decoding a JSON payload into a struct: parsing a glue_value tree and glue_decode_args vs glue_decode_json
+
+	bool bench_books_equal(const bench_book& a, const bench_book& b)
+	{
+		if (a.source != b.source || a.quotes.size() != b.quotes.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < a.quotes.size(); ++i)
+		{
+			const auto& x = a.quotes[i];
+			const auto& y = b.quotes[i];
+			if (x.symbol != y.symbol || x.bid != y.bid || x.ask != y.ask || x.size != y.size || x.firm != y.firm
+				|| x.trader.name != y.trader.name || x.trader.email != y.trader.email || x.depth != y.depth)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void bench_schema()
+	{
+		const int iterations = 200;
+
+		// the records carry fields the schema does not know - venue, desk and levels are skipped
+		const auto json = bench_json_text(2000, false);
+
+		glue_arena arena;
+		glue_json_parser parser;
+		bench_book tree_book;
+		const auto tree = measure("parse + glue_decode_args", iterations, [&](int i)
+			{
+				const glue_arg* args = nullptr;
+				int len = 0;
+				parser.parse_args(arena, json.c_str(), json.size(), args, len);
+				glue_decode_args(args, len, tree_book);
+				bench_sink = bench_sink + static_cast<long long>(tree_book.quotes.size()) + i;
+				arena.reset();
+			});
+
+		bench_book schema_book;
+		const auto schema = measure("glue_decode_json", iterations, [&](int i)
+			{
+				glue_decode_json(arena, json.c_str(), json.size(), schema_book);
+				bench_sink = bench_sink + static_cast<long long>(schema_book.quotes.size()) + i;
+				arena.reset();
+			});
+
+		std::cout << "  differential check: " << (schema_book.quotes.size() == 2000 && bench_books_equal(tree_book, schema_book) ? "passed" : "FAILED") << std::endl;
+		std::cout << "  throughput: " << json.size() / schema * 1e9 / (1024 * 1024) << " MB/s (" << json.size() << " bytes)" << std::endl;
+		std::cout << "  speedup: " << tree / schema << "x" << std::endl;
+	}
+
+	// shm - streaming to a same-host subscriber: a Glue stream vs a shared memory ring
+
+	long long bench_now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/**
+	 * \brief State of a benchmarked subscriber - latencies are written by the subscriber's callbacks, indexed by sequence.
+	 */
+	struct bench_stream_probe
+	{
+		std::atomic<int> received{ 0 };
+		std::atomic<int> mismatched{ 0 };
+		std::vector<long long> latencies;
+	};
+
+	void bench_stream_received(const char*, COOKIE cookie, const glue_payload* payload)
+	{
+		auto& probe = *static_cast<bench_stream_probe*>(const_cast<void*>(cookie));
+		if (payload->args_len != 4 || payload->args[2].value.type != glue_type::glue_string || strcmp(payload->args[2].value.s, "VOD.L") != 0)
+		{
+			probe.mismatched.fetch_add(1, std::memory_order_relaxed);
+		}
+		else if (payload->args[1].value.i >= 0)
+		{
+			probe.latencies[payload->args[1].value.i] = bench_now() - payload->args[0].value.l;
+		}
+		probe.received.fetch_add(1, std::memory_order_release);
+	}
+
+	/**
+	 * \brief Waits for a number of received payloads - false after 5 seconds.
+	 */
+	bool bench_wait_received(const bench_stream_probe& probe, int received)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (probe.received.load(std::memory_order_acquire) < received)
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				return false;
+			}
+			std::this_thread::yield();
+		}
+		return true;
+	}
+
+	/**
+	 * \brief Waits for a subscription to a stream to be established - it is asynchronous and pushes before that are lost.
+	 */
+	bool bench_wait_subscribed(const void* stream, const bench_stream_probe& probe)
+	{
+		const auto ready = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (probe.received.load(std::memory_order_acquire) == 0 && std::chrono::steady_clock::now() < ready)
+		{
+			const glue_arg ping[] = { glarg_l("t", 0), glarg_i("seq", -1), glarg_s("symbol", "VOD.L"), glarg_d("bid", 0) };
+			glue_push_payload(stream, ping, static_cast<int>(std::size(ping)));
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		// pings still in flight must not count as payloads of the benchmark
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		return probe.received > 0;
+	}
+
+	struct bench_stream_result
+	{
+		double p50;
+		double p99;
+		double rate;
+	};
+
+	/**
+	 * \brief Measures a transport - latency with one payload in flight, then throughput with a window of payloads in flight.
+	 */
+	template <typename Push>
+	bool bench_stream_transport(const char* label, bench_stream_probe& probe, bench_stream_result& result, Push&& push)
+	{
+		const int pings = 10000;
+		const int burst = 200000;
+		const int window = 256;
+
+		probe.latencies.assign(pings, 0);
+		const auto send = [&](int seq)
+		{
+			const glue_arg args[] = { glarg_l("t", bench_now()), glarg_i("seq", seq), glarg_s("symbol", "VOD.L"), glarg_d("bid", 101.25) };
+			push(args, static_cast<int>(std::size(args)));
+		};
+
+		const auto base = probe.received.load(std::memory_order_acquire);
+		for (int i = 0; i < pings; ++i)
+		{
+			send(i);
+			if (!bench_wait_received(probe, base + i + 1))
+			{
+				std::cout << "  " << label << ": timed out" << std::endl;
+				return false;
+			}
+		}
+		std::sort(probe.latencies.begin(), probe.latencies.end());
+		result.p50 = static_cast<double>(probe.latencies[pings / 2]);
+		result.p99 = static_cast<double>(probe.latencies[pings * 99 / 100]);
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto first = base + pings;
+		for (int i = 0; i < burst; ++i)
+		{
+			while (first + i - probe.received.load(std::memory_order_acquire) >= window)
+			{
+				std::this_thread::yield();
+			}
+			send(-1);
+		}
+		if (!bench_wait_received(probe, first + burst))
+		{
+			std::cout << "  " << label << ": timed out" << std::endl;
+			return false;
+		}
+		result.rate = burst / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "  " << label << ": latency p50 " << result.p50 << " ns, p99 " << result.p99 << " ns, throughput " << result.rate << " payloads/s" << std::endl;
+		return true;
+	}
+
+	void bench_shm()
+	{
+		bench_stream_probe glue_probe;
+		const auto stream = glue_register_streaming_endpoint("bench_shm_stream",
+			[](const char*, COOKIE, const glue_payload*, const char*&) { return true; });
+		const auto subscription = glue_subscribe_stream("bench_shm_stream", &bench_stream_received, nullptr, 0, &glue_probe);
+
+		bench_stream_result glue_result{};
+		const auto glue_measured = bench_wait_subscribed(stream, glue_probe) && bench_stream_transport("glue stream", glue_probe, glue_result,
+			[stream](const glue_arg* args, int len) { glue_push_payload(stream, args, len); });
+		glue_destroy_resource(subscription);
+		glue_destroy_resource(stream);
+
+		// the publisher and the subscriber map the segment separately - as two processes would
+		glue_shm_remove("bench_shm_stream", nullptr);
+		bench_stream_probe shm_probe;
+		bench_stream_result shm_result{};
+		bool shm_measured;
+		{
+			glue_shm_subscriber subscriber("bench_shm_stream", nullptr, &bench_stream_received, &shm_probe);
+			glue_shm_publisher publisher("bench_shm_stream");
+			shm_measured = subscriber.is_open() && publisher.is_open() && bench_stream_transport("shm ring", shm_probe, shm_result,
+				[&publisher](const glue_arg* args, int len) { publisher.push(args, len); });
+		}
+		glue_shm_remove("bench_shm_stream", nullptr);
+
+		std::cout << "  payload check: " << (glue_probe.mismatched == 0 && shm_probe.mismatched == 0 ? "passed" : "FAILED") << std::endl;
+		if (glue_measured && shm_measured)
+		{
+			std::cout << "  latency speedup: " << glue_result.p50 / shm_result.p50 << "x, throughput speedup: " << shm_result.rate / glue_result.rate << "x" << std::endl;
+		}
+	}
+
+	// batching - a publisher pushing a burst and sparse updates: every push sent vs micro-batched frames
+
+	/**
+	 * \brief Measures a way of pushing - the throughput of a burst and the latency of pushes 1ms apart.
+	 */
+	template <typename Push>
+	void bench_batching_pushes(const char* label, bench_stream_probe& probe, Push&& push)
+	{
+		const int burst = 200000;
+		const int pings = 200;
+
+		const auto base = probe.received.load(std::memory_order_acquire);
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < burst; ++i)
+		{
+			const glue_arg args[] = { glarg_l("t", bench_now()), glarg_i("seq", -1), glarg_s("symbol", "VOD.L"), glarg_d("bid", 101.25) };
+			push(args, static_cast<int>(std::size(args)));
+		}
+		const auto delivered = bench_wait_received(probe, base + burst);
+		const auto rate = burst / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		probe.latencies.assign(pings, 0);
+		for (int i = 0; i < pings && delivered; ++i)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			const glue_arg args[] = { glarg_l("t", bench_now()), glarg_i("seq", i), glarg_s("symbol", "VOD.L"), glarg_d("bid", 101.25) };
+			push(args, static_cast<int>(std::size(args)));
+			bench_wait_received(probe, base + burst + i + 1);
+		}
+		std::sort(probe.latencies.begin(), probe.latencies.end());
+
+		if (delivered)
+		{
+			std::cout << "  " << label << ": burst " << rate << " payloads/s, idle latency p50 " << probe.latencies[pings / 2] << " ns" << std::endl;
+		}
+		else
+		{
+			std::cout << "  " << label << ": timed out" << std::endl;
+		}
+	}
+
+	void bench_batching()
+	{
+		const auto stream = glue_register_streaming_endpoint("bench_batching_stream",
+			[](const char*, COOKIE, const glue_payload*, const char*&) { return true; });
+
+		bench_stream_probe probe;
+		{
+			glue_batched_subscription subscription("bench_batching_stream", &bench_stream_received, &probe);
+			if (bench_wait_subscribed(stream, probe))
+			{
+				bench_batching_pushes("every push", probe, [stream](const glue_arg* args, int len) { glue_push_payload(stream, args, len); });
+
+				glue_batching_publisher adaptive(stream);
+				bench_batching_pushes("adaptive batching", probe, [&adaptive](const glue_arg* args, int len) { adaptive.push(args, len); });
+				std::cout << "  adaptive batching: " << adaptive.pushes() << " pushes in " << adaptive.sends() << " payloads" << std::endl;
+
+				glue_batching_options fixed_window;
+				fixed_window.adaptive = false;
+				glue_batching_publisher fixed(stream, fixed_window);
+				bench_batching_pushes("fixed 200us window", probe, [&fixed](const glue_arg* args, int len) { fixed.push(args, len); });
+			}
+		}
+		glue_destroy_resource(stream);
+		std::cout << "  payload check: " << (probe.mismatched == 0 ? "passed" : "FAILED") << std::endl;
+	}
+
+	// conflate - a context written faster than its subscriber handles the updates: every update vs the latest one per field
+
+	struct bench_conflate_probe
+	{
+		std::atomic<long long> handled{ 0 };
+		std::atomic<long long> last{ -2 };
+		std::atomic<long long> last_handled_at{ 0 };
+	};
+
+	/**
+	 * \brief Handles an update as a slow consumer would - a UI thread redrawing, say.
+	 */
+	void bench_conflate_handle(bench_conflate_probe& probe, const glue_value* value)
+	{
+		const auto busy_until = std::chrono::steady_clock::now() + std::chrono::microseconds(100);
+		while (std::chrono::steady_clock::now() < busy_until)
+		{
+		}
+
+		probe.last_handled_at.store(bench_now(), std::memory_order_relaxed);
+		if (value != nullptr && value->type == glue_type::glue_long)
+		{
+			probe.last.store(value->l, std::memory_order_release);
+		}
+		probe.handled.fetch_add(1, std::memory_order_release);
+	}
+
+	bool bench_conflate_wait_last(const bench_conflate_probe& probe, long long seq)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+		while (probe.last.load(std::memory_order_acquire) != seq)
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		return true;
+	}
+
+	/**
+	 * \brief Writes a burst of updates to a context, then measures how long the subscriber takes to catch up with the last one.
+	 */
+	void bench_conflate_writes(const char* label, const char* context, bench_conflate_probe& probe)
+	{
+		const int updates = 5000;
+
+		// the subscription is established once it has the initial value
+		glue_write_context(context, "seq", glv_l(-1));
+		if (!bench_conflate_wait_last(probe, -1))
+		{
+			std::cout << "  " << label << ": timed out" << std::endl;
+			return;
+		}
+
+		const auto base = probe.handled.load(std::memory_order_acquire);
+		for (int i = 0; i < updates; ++i)
+		{
+			glue_write_context(context, "seq", glv_l(i));
+		}
+		const auto written_at = bench_now();
+		if (!bench_conflate_wait_last(probe, updates - 1))
+		{
+			std::cout << "  " << label << ": timed out" << std::endl;
+			return;
+		}
+
+		const auto lag = (probe.last_handled_at.load(std::memory_order_relaxed) - written_at) / 1e6;
+		std::cout << "  " << label << ": " << updates << " updates, " << probe.handled.load(std::memory_order_acquire) - base << " handled, caught up "
+			<< lag << " ms after the last write" << std::endl;
+	}
+
+	void bench_conflate()
+	{
+		bench_conflate_probe every_probe;
+		const auto every = glue_subscribe_context("bench_conflate_every", "seq",
+			[](const char*, const char*, const glue_value* value, COOKIE cookie)
+			{
+				bench_conflate_handle(*static_cast<bench_conflate_probe*>(const_cast<void*>(cookie)), value);
+			}, &every_probe);
+		bench_conflate_writes("every update", "bench_conflate_every", every_probe);
+		glue_destroy_resource(every);
+
+		bench_conflate_probe latest_probe;
+		glue_conflating_queue queue;
+		std::atomic<bool> stopping{ false };
+		std::thread consumer([&]
+			{
+				while (!stopping.load(std::memory_order_acquire))
+				{
+					if (queue.wait(std::chrono::milliseconds(10)))
+					{
+						queue.drain([&](const char*, const char*, const glue_value* value, int) { bench_conflate_handle(latest_probe, value); });
+					}
+				}
+			});
+		const auto latest = queue.subscribe("bench_conflate_latest", "seq");
+		bench_conflate_writes("latest update", "bench_conflate_latest", latest_probe);
+		glue_destroy_resource(latest);
+		stopping = true;
+		consumer.join();
+
+		std::cout << "  conflating queue: " << queue.offered() << " offered, " << queue.delivered() << " delivered, " << queue.conflated() << " conflated" << std::endl;
+	}
+
+	// queues - a burst of quotes to a subscriber slower than the publisher: unbounded delivery vs bounded queues
+
+	const int bench_queue_symbols = 16;
+
+	struct bench_queue_probe
+	{
+		std::atomic<long long> delivered{ 0 };
+		// the seq of the last quote delivered per symbol - written by the delivering thread only
+		int last[bench_queue_symbols];
+	};
+
+	void bench_queue_received(const char*, COOKIE cookie, const glue_payload* payload)
+	{
+		const auto busy_until = std::chrono::steady_clock::now() + std::chrono::microseconds(5);
+		while (std::chrono::steady_clock::now() < busy_until)
+		{
+		}
+
+		const auto probe = static_cast<bench_queue_probe*>(const_cast<void*>(cookie));
+		if (payload->args_len == 3 && payload->args[0].value.i >= 0)
+		{
+			probe->last[payload->args[0].value.i] = payload->args[1].value.i;
+		}
+		probe->delivered.fetch_add(1, std::memory_order_release);
+	}
+
+	bool bench_queue_subscribed(const void* stream, const bench_queue_probe& probe)
+	{
+		const auto base = probe.delivered.load(std::memory_order_acquire);
+		const auto ready = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (probe.delivered.load(std::memory_order_acquire) == base && std::chrono::steady_clock::now() < ready)
+		{
+			const glue_arg ping[] = { glarg_i("symbol", -1), glarg_i("seq", -1), glarg_d("bid", 0) };
+			glue_push_payload(stream, ping, static_cast<int>(std::size(ping)));
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		return probe.delivered > base;
+	}
+
+	/**
+	 * \brief Pushes a burst of quotes, then waits until done() tells every quote was handled or dropped.
+	 */
+	template <typename Done>
+	void bench_queue_burst(const char* label, const void* stream, bench_queue_probe& probe, Done&& done)
+	{
+		const int burst = 100000;
+
+		std::fill(std::begin(probe.last), std::end(probe.last), -1);
+		const auto base = probe.delivered.load(std::memory_order_acquire);
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < burst; ++i)
+		{
+			const glue_arg args[] = { glarg_i("symbol", i % bench_queue_symbols), glarg_i("seq", i), glarg_d("bid", 100 + i % 100) };
+			glue_push_payload(stream, args, static_cast<int>(std::size(args)));
+		}
+		const auto pushed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+		while (!done(base + burst))
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				std::cout << "  " << label << ": timed out" << std::endl;
+				return;
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		const auto drained = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		auto latest = true;
+		for (int s = 0; s < bench_queue_symbols; ++s)
+		{
+			latest = latest && probe.last[s] == burst - bench_queue_symbols + s;
+		}
+		std::cout << "  " << label << ": pushed in " << pushed << " ms, " << probe.delivered.load(std::memory_order_acquire) - base << " handled in "
+			<< drained << " ms, latest quote per symbol " << (latest ? "handled" : "lost") << std::endl;
+	}
+
+	void bench_queues()
+	{
+		const auto stream = glue_register_streaming_endpoint("bench_queue_stream",
+			[](const char*, COOKIE, const glue_payload*, const char*&) { return true; });
+
+		// every quote buffered by Glue until the subscriber gets to it
+		bench_queue_probe unbounded_probe;
+		const auto unbounded = glue_subscribe_stream("bench_queue_stream", &bench_queue_received, nullptr, 0, &unbounded_probe);
+		if (bench_queue_subscribed(stream, unbounded_probe))
+		{
+			bench_queue_burst("unbounded", stream, unbounded_probe,
+				[&unbounded_probe](long long delivered) { return unbounded_probe.delivered.load(std::memory_order_acquire) >= delivered; });
+		}
+		glue_destroy_resource(unbounded);
+
+		const struct
+		{
+			const char* label;
+			glue_overflow_policy policy;
+		} policies[] = {
+			{ "block", glue_overflow_policy::block },
+			{ "drop oldest", glue_overflow_policy::drop_oldest },
+			{ "drop newest", glue_overflow_policy::drop_newest },
+			{ "conflate by symbol", glue_overflow_policy::conflate },
+		};
+		for (const auto& policy : policies)
+		{
+			glue_queue_options options;
+			options.capacity = 1024;
+			options.policy = policy.policy;
+			options.key_field = "symbol";
+
+			bench_queue_probe probe;
+			glue_queued_subscription subscription("bench_queue_stream", &bench_queue_received, &probe, options);
+			if (!bench_queue_subscribed(stream, probe))
+			{
+				continue;
+			}
+
+			const auto before = subscription.metrics();
+			bench_queue_burst(policy.label, stream, probe,
+				[&](long long)
+				{
+					const auto metrics = subscription.metrics();
+					return metrics.received - before.received >= 100000 && metrics.delivered + metrics.dropped + metrics.conflated == metrics.received;
+				});
+			const auto metrics = subscription.metrics();
+			std::cout << "    queue: high-water mark " << metrics.high_water_mark << ", dropped " << metrics.dropped - before.dropped << ", conflated "
+				<< metrics.conflated - before.conflated << ", blocked " << metrics.blocked - before.blocked << std::endl;
+		}
+		glue_destroy_resource(stream);
+	}
+
+	// pipeline - thousands of invocations in flight to one endpoint, answered out of order: a locked map vs the lock-free correlation table
+
+	struct bench_pipeline_server
+	{
+		std::mutex mutex;
+		std::condition_variable arrived;
+		// the invocations to answer and the seq of their requests
+		std::vector<std::pair<const void*, int>> held;
+		bool stopping = false;
+	};
+
+	/**
+	 * \brief Answers the held invocations newest first - once at least count of them are held.
+	 * \return The number answered.
+	 */
+	size_t bench_pipeline_answer(bench_pipeline_server& server, size_t count)
+	{
+		std::vector<std::pair<const void*, int>> answering;
+		{
+			std::unique_lock<std::mutex> lock(server.mutex);
+			server.arrived.wait_for(lock, std::chrono::seconds(30), [&] { return server.stopping || server.held.size() >= count; });
+			answering.swap(server.held);
+		}
+
+		for (auto it = answering.rbegin(); it != answering.rend(); ++it)
+		{
+			const auto result = glarg_i("seq", it->second);
+			glue_push_payload(it->first, &result, 1);
+		}
+		return answering.size();
+	}
+
+	struct bench_pipeline_probe
+	{
+		std::atomic<int> completed{ 0 };
+		std::atomic<int> mismatched{ 0 };
+	};
+
+	struct bench_pipeline_request
+	{
+		bench_pipeline_probe* probe;
+		int seq;
+	};
+
+	void bench_pipeline_result(const char*, COOKIE cookie, const glue_payload* payload)
+	{
+		const auto request = static_cast<const bench_pipeline_request*>(cookie);
+		if (payload->status != 0 || payload->args_len != 1 || payload->args[0].value.i != request->seq)
+		{
+			request->probe->mismatched.fetch_add(1, std::memory_order_relaxed);
+		}
+		request->probe->completed.fetch_add(1, std::memory_order_release);
+	}
+
+	/**
+	 * \brief Correlation the usual way - a map of the outstanding requests under a mutex.
+	 */
+	class bench_locked_correlation
+	{
+	public:
+		static bench_locked_correlation& instance()
+		{
+			static bench_locked_correlation correlation;
+			return correlation;
+		}
+
+		int invoke(const char* endpoint_name, const glue_arg* args, int len, payload_function callback, COOKIE cookie)
+		{
+			uintptr_t id;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				id = ++next_id_;
+				requests_.emplace(id, std::make_pair(callback, cookie));
+			}
+			return glue_invoke(endpoint_name, args, len, &bench_locked_correlation::complete, reinterpret_cast<COOKIE>(id));
+		}
+
+	private:
+		static void complete(const char* origin, COOKIE cookie, const glue_payload* payload)
+		{
+			auto& self = instance();
+			std::pair<payload_function, COOKIE> request;
+			{
+				std::lock_guard<std::mutex> lock(self.mutex_);
+				const auto it = self.requests_.find(reinterpret_cast<uintptr_t>(cookie));
+				if (it == self.requests_.end())
+				{
+					return;
+				}
+				request = it->second;
+				self.requests_.erase(it);
+			}
+			request.first(origin, request.second, payload);
+		}
+
+		std::mutex mutex_;
+		std::unordered_map<uintptr_t, std::pair<payload_function, COOKIE>> requests_;
+		uintptr_t next_id_ = 0;
+	};
+
+	/**
+	 * \brief Holds 10k invocations in flight and answers them newest first, then keeps a window of 10k in flight for a stream of invocations.
+	 * \return The throughput of the stream, in invocations per second - 0 if it timed out.
+	 */
+	template <typename Invoke>
+	double bench_pipeline_run(const char* label, bench_pipeline_server& server, Invoke&& invoke)
+	{
+		const int window = 10000;
+		const int total = 200000;
+
+		std::vector<bench_pipeline_request> requests(total);
+		bench_pipeline_probe probe;
+		for (int i = 0; i < total; ++i)
+		{
+			requests[i] = bench_pipeline_request{ &probe, i };
+		}
+		const auto send = [&](int seq)
+		{
+			const auto arg = glarg_i("seq", seq);
+			return invoke(&arg, 1, &bench_pipeline_result, &requests[seq]) >= 0;
+		};
+		const auto wait_completed = [&](int count)
+		{
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+			while (probe.completed.load(std::memory_order_acquire) < count && std::chrono::steady_clock::now() < deadline)
+			{
+				std::this_thread::yield();
+			}
+			return probe.completed >= count;
+		};
+
+		// all held by the endpoint at once
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < window; ++i)
+		{
+			if (!send(i))
+			{
+				std::cout << "  " << label << ": invocation " << i << " refused" << std::endl;
+				return 0;
+			}
+		}
+		const auto held = bench_pipeline_answer(server, window);
+		if (held != window || !wait_completed(window))
+		{
+			std::cout << "  " << label << ": timed out" << std::endl;
+			return 0;
+		}
+		const auto burst = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		// a window in flight, answered as they arrive
+		std::thread responder([&server]
+			{
+				while (bench_pipeline_answer(server, 1) > 0)
+				{
+				}
+			});
+		start = std::chrono::steady_clock::now();
+		for (int i = window; i < total; ++i)
+		{
+			while (i - probe.completed.load(std::memory_order_acquire) >= window)
+			{
+				std::this_thread::yield();
+			}
+			if (!send(i))
+			{
+				--i;
+				std::this_thread::yield();
+			}
+		}
+		const auto completed = wait_completed(total);
+		const auto rate = (total - window) / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		{
+			std::lock_guard<std::mutex> lock(server.mutex);
+			server.stopping = true;
+		}
+		server.arrived.notify_all();
+		responder.join();
+		server.stopping = false;
+
+		if (!completed)
+		{
+			std::cout << "  " << label << ": timed out" << std::endl;
+			return 0;
+		}
+		std::cout << "  " << label << ": " << window << " held in flight and answered newest first in " << burst << " ms, "
+			<< window << " in flight: " << rate << " invocations/s, results " << (probe.mismatched == 0 ? "matched" : "MISMATCHED") << std::endl;
+		return rate;
+	}
+
+	/**
+	 * \brief Times the correlation alone - threads adding requests and taking them back, each thread keeping a window of them outstanding.
+	 * \return Requests per second.
+	 */
+	template <typename Add, typename Take>
+	double bench_correlation(Add&& add, Take&& take)
+	{
+		const int threads = 4;
+		const int window = 2500;
+		const int requests = 1000000;
+
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; ++t)
+		{
+			workers.emplace_back([&]
+				{
+					std::vector<uintptr_t> outstanding(window);
+					for (int i = 0; i < requests; ++i)
+					{
+						auto& id = outstanding[i % window];
+						if (i >= window)
+						{
+							take(id);
+						}
+						id = add();
+					}
+					for (const auto id : outstanding)
+					{
+						take(id);
+					}
+				});
+		}
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+		return threads * static_cast<double>(requests) / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void bench_pipeline()
+	{
+		bench_pipeline_server server;
+		glue_register_endpoint("bench_pipeline",
+			[](const char*, COOKIE cookie, const glue_payload* payload, const void* result)
+			{
+				auto& server = *static_cast<bench_pipeline_server*>(const_cast<void*>(cookie));
+				{
+					std::lock_guard<std::mutex> lock(server.mutex);
+					server.held.emplace_back(result, payload->args_len == 1 ? payload->args[0].value.i : -1);
+				}
+				server.arrived.notify_one();
+			}, &server);
+
+		const auto locked = bench_pipeline_run("locked map", server,
+			[](const glue_arg* args, int len, payload_function callback, COOKIE cookie)
+			{
+				return bench_locked_correlation::instance().invoke("bench_pipeline", args, len, callback, cookie);
+			});
+
+		glue_pipelined_invoker invoker(10000);
+		const auto pipelined = bench_pipeline_run("correlation table", server,
+			[&invoker](const glue_arg* args, int len, payload_function callback, COOKIE cookie)
+			{
+				return invoker.invoke("bench_pipeline", args, len, callback, cookie);
+			});
+		while (!invoker.idle())
+		{
+			std::this_thread::yield();
+		}
+
+		if (locked > 0 && pipelined > 0)
+		{
+			std::cout << "  speedup: " << pipelined / locked << "x" << std::endl;
+		}
+
+		std::mutex mutex;
+		std::unordered_map<uintptr_t, glue_correlation_table::entry> map;
+		uintptr_t next_id = 0;
+		const auto map_rate = bench_correlation(
+			[&]
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				map.emplace(++next_id, glue_correlation_table::entry{ &bench_pipeline_result, nullptr, nullptr });
+				return next_id;
+			},
+			[&](uintptr_t id)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				map.erase(id);
+			});
+
+		auto& table = glue_correlation_table::instance();
+		const auto table_rate = bench_correlation(
+			[&table] { return table.add(glue_correlation_table::entry{ &bench_pipeline_result, nullptr, nullptr }); },
+			[&table](uintptr_t id)
+			{
+				glue_correlation_table::entry e;
+				table.take(id, e);
+			});
+		std::cout << "  correlation alone, 4 threads: locked map " << map_rate << " requests/s, correlation table " << table_rate << " requests/s, speedup "
+			<< table_rate / map_rate << "x" << std::endl;
+	}
+
+	// coro - invocations chained one after the other and fanned out 100 at a time: callbacks with a heap-allocated state per hop vs awaited invocations
+
+	const int bench_coro_hops = 20000;
+	const int bench_coro_rounds = 200;
+	const int bench_coro_fan_out = 100;
+
+	struct bench_coro_probe
+	{
+		std::atomic<bool> done{ false };
+		// read once done
+		int mismatched = 0;
+	};
+
+	/**
+	 * \brief The state of a hop of a callback chain - on the heap, passed as the cookie.
+	 */
+	struct bench_coro_hop
+	{
+		bench_coro_probe* probe;
+		int seq;
+	};
+
+	void bench_coro_hop_done(const char*, COOKIE cookie, const glue_payload* payload);
+
+	void bench_coro_hop_start(bench_coro_probe* probe, int seq)
+	{
+		const auto arg = glarg_i("seq", seq);
+		glue_invoke("bench_coro", &arg, 1, &bench_coro_hop_done, new bench_coro_hop{ probe, seq });
+	}
+
+	void bench_coro_hop_done(const char*, COOKIE cookie, const glue_payload* payload)
+	{
+		const std::unique_ptr<const bench_coro_hop> hop(static_cast<const bench_coro_hop*>(cookie));
+		if (payload->args_len != 1 || payload->args[0].value.i != hop->seq)
+		{
+			++hop->probe->mismatched;
+		}
+
+		if (hop->seq + 1 < bench_coro_hops)
+		{
+			bench_coro_hop_start(hop->probe, hop->seq + 1);
+		}
+		else
+		{
+			hop->probe->done.store(true, std::memory_order_release);
+		}
+	}
+
+	glue::task<> bench_coro_chain(bench_coro_probe& probe, glue::run_loop* loop)
+	{
+		for (int seq = 0; seq < bench_coro_hops; ++seq)
+		{
+			const auto arg = glarg_i("seq", seq);
+			const auto result = co_await glue::invoke("bench_coro", &arg, 1, loop);
+			const auto echoed = result.find("seq");
+			if (echoed == nullptr || echoed->i != seq)
+			{
+				++probe.mismatched;
+			}
+		}
+
+		probe.done.store(true, std::memory_order_release);
+		if (loop != nullptr)
+		{
+			loop->stop();
+		}
+	}
+
+	/**
+	 * \brief The state of a round of a callback fan-out - on the heap, as is the state of each of its invocations.
+	 */
+	struct bench_coro_fan_in
+	{
+		bench_coro_probe* probe;
+		int round;
+		std::atomic<int> remaining;
+		std::vector<int> results;
+	};
+
+	struct bench_coro_fan_call
+	{
+		bench_coro_fan_in* fan_in;
+		int index;
+	};
+
+	void bench_coro_fan_done(const char*, COOKIE cookie, const glue_payload* payload);
+
+	void bench_coro_fan_start(bench_coro_probe* probe, int round)
+	{
+		const auto fan_in = new bench_coro_fan_in{ probe, round, bench_coro_fan_out, std::vector<int>(bench_coro_fan_out) };
+		for (int i = 0; i < bench_coro_fan_out; ++i)
+		{
+			const auto arg = glarg_i("seq", i);
+			glue_invoke("bench_coro", &arg, 1, &bench_coro_fan_done, new bench_coro_fan_call{ fan_in, i });
+		}
+	}
+
+	void bench_coro_fan_done(const char*, COOKIE cookie, const glue_payload* payload)
+	{
+		const std::unique_ptr<const bench_coro_fan_call> call(static_cast<const bench_coro_fan_call*>(cookie));
+		const auto fan_in = call->fan_in;
+		fan_in->results[call->index] = payload->args_len == 1 ? payload->args[0].value.i : -1;
+		if (fan_in->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		{
+			return;
+		}
+
+		const std::unique_ptr<bench_coro_fan_in> done(fan_in);
+		for (int i = 0; i < bench_coro_fan_out; ++i)
+		{
+			if (done->results[i] != i)
+			{
+				++done->probe->mismatched;
+			}
+		}
+
+		if (done->round + 1 < bench_coro_rounds)
+		{
+			bench_coro_fan_start(done->probe, done->round + 1);
+		}
+		else
+		{
+			done->probe->done.store(true, std::memory_order_release);
+		}
+	}
+
+	glue::task<> bench_coro_fan(bench_coro_probe& probe)
+	{
+		for (int round = 0; round < bench_coro_rounds; ++round)
+		{
+			glue::invocation_group group(bench_coro_fan_out);
+			for (int i = 0; i < bench_coro_fan_out; ++i)
+			{
+				const auto arg = glarg_i("seq", i);
+				group.invoke("bench_coro", &arg, 1);
+			}
+			co_await group;
+
+			for (int i = 0; i < bench_coro_fan_out; ++i)
+			{
+				const auto echoed = group[i].find("seq");
+				if (echoed == nullptr || echoed->i != i)
+				{
+					++probe.mismatched;
+				}
+			}
+		}
+		probe.done.store(true, std::memory_order_release);
+	}
+
+	/**
+	 * \brief Times a run of invocations, started by start(probe) and completed once the probe is done.
+	 */
+	template <typename Start>
+	void bench_coro_time(const char* label, int invocations, Start&& start)
+	{
+		bench_coro_probe probe;
+		const auto begin = std::chrono::steady_clock::now();
+		start(probe);
+		const auto deadline = begin + std::chrono::seconds(30);
+		while (!probe.done.load(std::memory_order_acquire))
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				std::cout << "  " << label << ": timed out" << std::endl;
+				return;
+			}
+			std::this_thread::yield();
+		}
+
+		const auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / invocations;
+		std::cout << "  " << label << ": " << ns << " ns per invocation, results " << (probe.mismatched == 0 ? "matched" : "MISMATCHED") << std::endl;
+	}
+
+	void bench_coro()
+	{
+		glue_register_endpoint("bench_coro",
+			[](const char*, COOKIE, const glue_payload* payload, const void* result) { glue_push_payload(result, payload->args, payload->args_len); });
+
+		bench_coro_time("chain, callbacks", bench_coro_hops, [](bench_coro_probe& probe) { bench_coro_hop_start(&probe, 0); });
+		bench_coro_time("chain, co_await", bench_coro_hops, [](bench_coro_probe& probe) { bench_coro_chain(probe, nullptr).detach(); });
+		bench_coro_time("chain, co_await resuming on this thread", bench_coro_hops,
+			[](bench_coro_probe& probe)
+			{
+				glue::run_loop loop;
+				bench_coro_chain(probe, &loop).detach();
+				loop.run();
+			});
+
+		const auto fanned = bench_coro_rounds * bench_coro_fan_out;
+		bench_coro_time("fan-out/fan-in of 100, callbacks", fanned, [](bench_coro_probe& probe) { bench_coro_fan_start(&probe, 0); });
+		bench_coro_time("fan-out/fan-in of 100, co_await", fanned, [](bench_coro_probe& probe) { bench_coro_fan(probe).detach(); });
+	}
+
+	// cache - reference data lookups, 4 in 5 of them for the same 16 instruments out of 64: every lookup invoked vs served from a glue_invocation_cache
+
+	const int bench_cache_lookups = 100000;
+
+	struct bench_cache_probe
+	{
+		std::atomic<int> completed{ 0 };
+		std::atomic<int> mismatched{ 0 };
+	};
+
+	void bench_cache_result(const char*, COOKIE cookie, const glue_payload* payload)
+	{
+		auto& probe = *static_cast<bench_cache_probe*>(const_cast<void*>(cookie));
+		if (payload->status != 0 || payload->args_len != 3 || payload->args[1].value.type != glue_type::glue_string)
+		{
+			++probe.mismatched;
+		}
+		probe.completed.fetch_add(1, std::memory_order_release);
+	}
+
+	/**
+	 * \brief Times the lookups, made by invoke(args, len, callback, cookie).
+	 * \return ns per lookup - 0 if it timed out.
+	 */
+	template <typename Invoke>
+	double bench_cache_run(const char* label, Invoke&& invoke)
+	{
+		bench_cache_probe probe;
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < bench_cache_lookups; ++i)
+		{
+			const auto id = i % 5 != 0 ? i % 16 : i % 64;
+			const glue_arg args[] = { glarg_s("source", "reference"), glarg_i("id", id) };
+			invoke(args, 2, &bench_cache_result, &probe);
+		}
+		const auto deadline = start + std::chrono::seconds(30);
+		while (probe.completed.load(std::memory_order_acquire) < bench_cache_lookups)
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				std::cout << "  " << label << ": timed out" << std::endl;
+				return 0;
+			}
+			std::this_thread::yield();
+		}
+
+		const auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / bench_cache_lookups;
+		std::cout << "  " << label << ": " << ns << " ns per lookup, results " << (probe.mismatched == 0 ? "matched" : "MISMATCHED") << std::endl;
+		return ns;
+	}
+
+	void bench_cache_report(const glue_invocation_cache& cache)
+	{
+		const auto metrics = cache.metrics();
+		std::cout << "    " << metrics.hits << " hits, " << metrics.misses << " misses (" << metrics.collapsed << " collapsed), " << metrics.evictions << " evictions, "
+			<< metrics.entries << " entries of " << metrics.bytes << " bytes" << std::endl;
+	}
+
+	void bench_cache()
+	{
+		const auto endpoint = glue_register_streaming_endpoint("bench_cache", nullptr,
+			[](const char*, COOKIE, const glue_payload* payload, const void* result)
+			{
+				const auto id = glue_read_i(payload->reader, "id");
+				const auto symbol = "SYM" + std::to_string(id);
+				const glue_arg instrument[] = { glarg_i("id", id), glarg_s("symbol", symbol.c_str()), glarg_d("tick", 0.01) };
+				glue_push_payload(result, instrument, 3);
+			});
+
+		const auto invoked = bench_cache_run("glue_invoke", [](const glue_arg* args, int len, payload_function callback, COOKIE cookie)
+			{
+				return glue_invoke("bench_cache", args, len, callback, cookie);
+			});
+
+		glue_invocation_cache cache(256);
+		cache.enable("bench_cache", std::chrono::seconds(60));
+		const auto cached = bench_cache_run("cache of 256", [&cache](const glue_arg* args, int len, payload_function callback, COOKIE cookie)
+			{
+				return cache.invoke("bench_cache", args, len, callback, cookie);
+			});
+		bench_cache_report(cache);
+
+		glue_invocation_cache small(32);
+		small.enable("bench_cache", std::chrono::seconds(60));
+		bench_cache_run("cache of 32", [&small](const glue_arg* args, int len, payload_function callback, COOKIE cookie)
+			{
+				return small.invoke("bench_cache", args, len, callback, cookie);
+			});
+		bench_cache_report(small);
+
+		// the instance goes away - its results with it
+		glue_destroy_resource(endpoint);
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (cache.metrics().entries > 0 && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		std::cout << "  endpoint unregistered: " << cache.metrics().invalidations << " entries invalidated, " << cache.metrics().entries << " left" << std::endl;
+
+		if (invoked > 0 && cached > 0)
+		{
+			std::cout << "  speedup: " << invoked / cached << "x" << std::endl;
+		}
+	}
+
+	// singleflight - 10 windows opening at once, each invoking the same lookup of an endpoint taking 1 ms: every invocation sent vs identical ones collapsed
+
+	struct bench_flight_probe
+	{
+		// invocations which reached the endpoint
+		std::atomic<int> arrived{ 0 };
+		std::atomic<int> completed{ 0 };
+		std::atomic<int> mismatched{ 0 };
+	};
+
+	void bench_flight_result(const char*, COOKIE cookie, const glue_payload* payload)
+	{
+		auto& probe = *static_cast<bench_flight_probe*>(const_cast<void*>(cookie));
+		if (payload->status != 0 || payload->args_len != 1)
+		{
+			++probe.mismatched;
+		}
+		probe.completed.fetch_add(1, std::memory_order_release);
+	}
+
+	/**
+	 * \brief Opens the windows round after round - each round waits for the results of the last.
+	 */
+	template <typename Invoke>
+	void bench_flight_run(const char* label, bench_flight_probe& probe, Invoke&& invoke)
+	{
+		const int rounds = 200;
+		const int windows = 10;
+
+		probe.arrived = 0;
+		probe.completed = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < rounds; ++r)
+		{
+			const auto id = glarg_i("id", r % 4);
+			for (int w = 0; w < windows; ++w)
+			{
+				invoke(&id, 1, &bench_flight_result, &probe);
+			}
+
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+			while (probe.completed.load(std::memory_order_acquire) < (r + 1) * windows)
+			{
+				if (std::chrono::steady_clock::now() > deadline)
+				{
+					std::cout << "  " << label << ": timed out" << std::endl;
+					return;
+				}
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+		}
+
+		const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / rounds;
+		std::cout << "  " << label << ": " << probe.arrived << " of " << rounds * windows << " invocations reached the endpoint, " << ms
+			<< " ms per round, results " << (probe.mismatched == 0 ? "matched" : "MISMATCHED") << std::endl;
+	}
+
+	void bench_singleflight()
+	{
+		bench_flight_probe probe;
+		glue_register_endpoint("bench_flight",
+			[](const char*, COOKIE cookie, const glue_payload* payload, const void* result)
+			{
+				static_cast<bench_flight_probe*>(const_cast<void*>(cookie))->arrived++;
+				const auto id = payload->args_len == 1 ? payload->args[0].value.i : -1;
+				// answered from the timer thread, keeping the Glue thread free
+				glue_deadline_timer::instance().schedule(glue_deadline_timer::clock::now() + std::chrono::milliseconds(1), [result, id]
+					{
+						const auto answer = glarg_i("id", id);
+						glue_push_payload(result, &answer, 1);
+					});
+			}, &probe);
+
+		bench_flight_run("glue_invoke", probe, [](const glue_arg* args, int len, payload_function callback, COOKIE cookie)
+			{
+				return glue_invoke("bench_flight", args, len, callback, cookie);
+			});
+
+		glue_single_flight flights;
+		bench_flight_run("single flight", probe, [&flights](const glue_arg* args, int len, payload_function callback, COOKIE cookie)
+			{
+				return flights.invoke("bench_flight", args, len, callback, cookie);
+			});
+		std::cout << "    " << flights.flights() << " flights, " << flights.collapsed() << " invocations collapsed" << std::endl;
+	}
+
+#ifdef GLUE_LOOPBACK
+	// fanout - pushing to a stream with many subscribers: encoding per subscriber vs once into a shared buffer
+
+	struct bench_fanout_probe
+	{
+		std::atomic<int> accepted{ 0 };
+		std::atomic<long long> received{ 0 };
+	};
+
+	void bench_fanout()
+	{
+		const int subscribers = 200;
+		const int branch_subscribers = 50;
+		const int iterations = 2000;
+
+		glue_arena arena;
+		glue_json_parser parser;
+		const auto json = bench_json_text(20, false);
+		const glue_arg* parsed = nullptr;
+		int parsed_len = 0;
+		parser.parse_args(arena, json.c_str(), json.size(), parsed, parsed_len);
+
+		// a sequence number first - every push to the main branch carries new data
+		std::vector<glue_arg> args{ glarg_i("seq", 0) };
+		args.insert(args.end(), parsed, parsed + parsed_len);
+		const auto len = static_cast<int>(args.size());
+
+		const auto per_subscriber = measure("encode per subscriber", iterations, [&](int i)
+			{
+				args[0].value.i = i;
+				for (int s = 0; s < subscribers; ++s)
+				{
+					const auto flat = glue_flatten(args.data(), len);
+					bench_sink = bench_sink + static_cast<long long>(glue_flat_size(flat));
+					glue_delete_flat(flat);
+				}
+			});
+
+		bench_fanout_probe probe;
+		const auto stream = glue_register_streaming_endpoint("bench_fanout_stream",
+			[](const char*, COOKIE cookie, const glue_payload* payload, const char*& branch)
+			{
+				branch = glue_read_s(payload->reader, "branch");
+				static_cast<bench_fanout_probe*>(const_cast<void*>(cookie))->accepted++;
+				return true;
+			}, nullptr, &probe);
+		const auto on_payload = [](const char*, COOKIE cookie, const glue_payload*)
+		{
+			static_cast<bench_fanout_probe*>(const_cast<void*>(cookie))->received.fetch_add(1, std::memory_order_release);
+		};
+
+		std::vector<const void*> subscriptions;
+		const char* branches[] = { "a", "b" };
+		for (int s = 0; s < subscribers + 2 * branch_subscribers; ++s)
+		{
+			const auto branch = glarg_s("branch", branches[s % 2]);
+			subscriptions.push_back(glue_subscribe_stream("bench_fanout_stream", on_payload, &branch, s < subscribers ? 0 : 1, &probe));
+		}
+		const auto ready = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (probe.accepted < static_cast<int>(subscriptions.size()) && std::chrono::steady_clock::now() < ready)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		const auto a = glue_open_streaming_branch(stream, "a");
+		const auto b = glue_open_streaming_branch(stream, "b");
+
+		const auto wait_received = [&](long long expected)
+		{
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+			while (probe.received.load(std::memory_order_acquire) < expected && std::chrono::steady_clock::now() < deadline)
+			{
+				std::this_thread::yield();
+			}
+		};
+
+		// the main branch - all subscribers, one encode per push
+		glue_stream_stats before{}, after{};
+		glue_get_stream_stats(stream, &before);
+		for (int i = 0; i < iterations; ++i)
+		{
+			args[0].value.i = i;
+			glue_push_payload(stream, args.data(), len);
+		}
+		wait_received(static_cast<long long>(iterations) * static_cast<long long>(subscriptions.size()));
+		glue_get_stream_stats(stream, &after);
+
+		const auto pushes = static_cast<double>(after.pushes - before.pushes);
+		const auto shared = (after.encode_ns - before.encode_ns) / pushes;
+		std::cout << "  shared buffer: encode " << shared << " ns/push, fan-out " << (after.fan_out_ns - before.fan_out_ns) / pushes << " ns/push, "
+			<< (after.deliveries - before.deliveries) / pushes << " deliveries/push" << std::endl;
+
+		// the same data to two branches - encoded for the first, shared by the second
+		const auto received = probe.received.load();
+		glue_get_stream_stats(stream, &before);
+		for (int i = 0; i < iterations; ++i)
+		{
+			args[0].value.i = iterations + i;
+			glue_push_payload(a, args.data(), len);
+			glue_push_payload(b, args.data(), len);
+		}
+		wait_received(received + 2LL * iterations * branch_subscribers);
+		glue_get_stream_stats(stream, &after);
+		std::cout << "  branches: " << after.pushes - before.pushes << " pushes, " << after.encodes - before.encodes << " encodes" << std::endl;
+
+		for (const auto subscription : subscriptions)
+		{
+			glue_destroy_resource(subscription);
+		}
+		glue_destroy_resource(stream);
+		std::cout << "  speedup (encode): " << per_subscriber / shared << "x" << std::endl;
+	}
+
+	// partial - invoking 8 targets of a method where one responds late: all results at once vs each result as it arrives, cut short by a quorum or a timeout
+
+	struct bench_partial_target
+	{
+		std::chrono::milliseconds delay;
+		bool fails;
+	};
+
+	/**
+	 * \brief The results of one invocation of all targets - the times (in ms) of the first result and of the summary.
+	 */
+	struct bench_partial_probe
+	{
+		std::mutex mutex;
+		std::condition_variable done;
+		std::chrono::steady_clock::time_point start;
+		double first_ms = -1;
+		double done_ms = -1;
+		glue_invoke_all_summary summary{};
+	};
+
+	/**
+	 * \brief Responds to an invocation once the target's delay passed - from the timer thread, keeping the Glue thread free.
+	 */
+	void bench_partial_respond(const char*, COOKIE cookie, const glue_payload*, const void* result)
+	{
+		const auto target = static_cast<const bench_partial_target*>(cookie);
+		glue_deadline_timer::instance().schedule(glue_deadline_timer::clock::now() + target->delay, [target, result]
+			{
+				if (target->fails)
+				{
+					glue_push_failure(result, "unavailable");
+					return;
+				}
+				const auto arg = glarg_d("price", 101.25);
+				glue_push_payload(result, &arg, 1);
+			});
+	}
+
+	double bench_partial_since(const bench_partial_probe& probe)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - probe.start).count();
+	}
+
+	void bench_partial_result(const char*, COOKIE cookie, const glue_payload*)
+	{
+		auto& probe = *static_cast<bench_partial_probe*>(const_cast<void*>(cookie));
+		std::lock_guard<std::mutex> lock(probe.mutex);
+		if (probe.first_ms < 0)
+		{
+			probe.first_ms = bench_partial_since(probe);
+		}
+	}
+
+	void bench_partial_done(const char*, COOKIE cookie, const glue_invoke_all_summary* summary)
+	{
+		auto& probe = *static_cast<bench_partial_probe*>(const_cast<void*>(cookie));
+		// notified under the lock - the probe is gone as soon as the waiter sees the summary
+		std::lock_guard<std::mutex> lock(probe.mutex);
+		probe.done_ms = bench_partial_since(probe);
+		probe.summary = *summary;
+		probe.done.notify_one();
+	}
+
+	/**
+	 * \brief Times rounds of an invocation of all targets, started by invoke(probe) and finished once the probe got its summary.
+	 */
+	template <typename Invoke>
+	void bench_partial_time(const char* label, Invoke&& invoke)
+	{
+		const int rounds = 10;
+		const char* outcomes[] = { "answered", "cutoff", "no quorum", "timed out" };
+
+		double first = 0;
+		double done = 0;
+		glue_invoke_all_summary summary{};
+		for (int r = 0; r < rounds; ++r)
+		{
+			bench_partial_probe probe;
+			probe.start = std::chrono::steady_clock::now();
+			invoke(probe);
+
+			std::unique_lock<std::mutex> lock(probe.mutex);
+			if (!probe.done.wait_for(lock, std::chrono::seconds(5), [&] { return probe.done_ms >= 0; }))
+			{
+				std::cout << "  " << label << ": timed out" << std::endl;
+				return;
+			}
+			first += probe.first_ms;
+			done += probe.done_ms;
+			summary = probe.summary;
+		}
+
+		std::cout << "  " << label << ": first result in " << first / rounds << " ms, finished in " << done / rounds << " ms - "
+			<< outcomes[static_cast<int>(summary.outcome)] << ", " << summary.succeeded << " succeeded, " << summary.failed << " failed, "
+			<< summary.pending << " of " << summary.targets << " pending" << std::endl;
+	}
+
+	void bench_partial()
+	{
+		// 7 targets responding within 2 ms, 1 after 100 ms - the second method has 3 of the fast ones fail
+		std::vector<bench_partial_target> targets;
+		std::vector<bench_partial_target> failing;
+		for (int i = 0; i < 8; ++i)
+		{
+			const auto delay = std::chrono::milliseconds(i < 7 ? 1 + i % 2 : 100);
+			targets.push_back(bench_partial_target{ delay, false });
+			failing.push_back(bench_partial_target{ delay, i >= 4 && i < 7 });
+		}
+
+		std::vector<const void*> endpoints;
+		for (size_t i = 0; i < targets.size(); ++i)
+		{
+			endpoints.push_back(glue_register_streaming_endpoint("bench_partial", nullptr, &bench_partial_respond, &targets[i]));
+			endpoints.push_back(glue_register_streaming_endpoint("bench_partial_failing", nullptr, &bench_partial_respond, &failing[i]));
+		}
+
+		bench_partial_time("glue_invoke_all", [](bench_partial_probe& probe)
+			{
+				glue_invoke_all("bench_partial", nullptr, 0,
+					[](const char* origin, COOKIE cookie, const glue_payload* payloads, int len)
+					{
+						for (int i = 0; i < len; ++i)
+						{
+							bench_partial_result(origin, cookie, &payloads[i]);
+						}
+						const glue_invoke_all_summary summary{ glue_invoke_all_outcome::answered, len, len, len, 0, 0, 0 };
+						bench_partial_done(origin, cookie, &summary);
+					}, &probe);
+			});
+
+		const auto partial = [](const char* method, const glue_invoke_all_options& options)
+		{
+			return [method, options](bench_partial_probe& probe)
+			{
+				glue_invoke_all_partial(method, nullptr, 0, &bench_partial_result, &bench_partial_done, &probe, options);
+			};
+		};
+
+		glue_invoke_all_options options;
+		bench_partial_time("partial", partial("bench_partial", options));
+
+		options.quorum = 5;
+		bench_partial_time("partial, quorum of 5", partial("bench_partial", options));
+
+		options.quorum = 0;
+		options.timeout = std::chrono::milliseconds(20);
+		bench_partial_time("partial, 20 ms timeout", partial("bench_partial", options));
+
+		options.quorum = 6;
+		options.timeout = std::chrono::milliseconds(0);
+		bench_partial_time("partial, quorum of 6, 3 targets failing", partial("bench_partial_failing", options));
+
+		// the late results are still to come - their targets have to outlive them
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		for (const auto endpoint : endpoints)
+		{
+			glue_destroy_resource(endpoint);
+		}
+	}
+#endif
+
+	struct benchmark
+	{
+		const char* name;
+		void (*run)();
+	};
+
+	const benchmark benchmarks[] = {
+		{ "arena", &bench_arena },
+		{ "reflect", &bench_reflect },
+		{ "decode", &bench_decode },
+		{ "path", &bench_path },
+		{ "batch", &bench_batch },
+		{ "index", &bench_index },
+		{ "columns", &bench_columns },
+		{ "flat", &bench_flat },
+		{ "diff", &bench_diff },
+		{ "hash", &bench_hash },
+		{ "json", &bench_json },
+		{ "json_write", &bench_json_write },
+		{ "lazy", &bench_lazy },
+		{ "schema", &bench_schema },
+		{ "shm", &bench_shm },
+		{ "batching", &bench_batching },
+		{ "conflate", &bench_conflate },
+		{ "queues", &bench_queues },
+		{ "pipeline", &bench_pipeline },
+		{ "coro", &bench_coro },
+		{ "cache", &bench_cache },
+		{ "singleflight", &bench_singleflight },
+#ifdef GLUE_LOOPBACK
+		{ "fanout", &bench_fanout },
+		{ "partial", &bench_partial },
+#endif
+	};
+}
+
+void run_benchmark(const std::string& name)
+{
+	for (const auto& b : benchmarks)
+	{
+		if (name == b.name)
+		{
+			std::cout << "Benchmark " << b.name << std::endl;
+			b.run();
+			return;
+		}
+	}
+
+	std::cout << "Unknown benchmark '" << name << "', available:";
+	for (const auto& b : benchmarks)
+	{
+		std::cout << " " << b.name;
+	}
+	std::cout << std::endl;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <string>
+
+/**
+ * \brief Runs a microbenchmark by name (e.g. 'arena') and dumps its timings to the console.
+ * Used by the 'bench_<name>' console command. Unknown names list the available benchmarks.
+ */
+void run_benchmark(const std::string& name);
@@ -3,11 +3,14 @@
  *
  * - handling invocations (registered endpoints)
  * - sending invocations to other endpoints
+ * - streaming the results of invocations of all targets (invokeeach_)
+ * - chaining invocations in coroutines (chain_)
  * - subscribing to Glue channels (contexts)
  * - reading from Glue channels (contexts)
  * - writing to Glue channels (contexts)
  * - subscribing to Glue streams
  * - pushing to Glue streams/branches
+ * - streaming to same-host subscribers over shared memory (shmsub_/shmpush_)
  *
  * Note: the Glue C Exports MFC demo demonstrates:
  * - Registering Glue windows
@@ -15,10 +18,75 @@
  * - Saving/Restoring
  *
  */
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <iostream>
-#include <sstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include "GlueCLILib.h"
+#include "GlueNativeBench.h"
+#include "GlueCoro.h"
+#include "GlueHash.h"
+#include "GlueInvokeAll.h"
+#include "GlueJson.h"
+#include "GlueReflect.h"
+#include "GlueSchema.h"
+#include "GlueShm.h"
+
+/**
+ * \brief Arguments of the glue_native_cpp endpoint - decoded by its schema-bound registration.
+ */
+struct person_name
+{
+	std::string first;
+	std::string last;
+};
+
+GLUE_FIELDS(person_name, first, last);
+
+struct person
+{
+	person_name name;
+};
+
+GLUE_FIELDS(person, name);
+
+struct native_cpp_args
+{
+	person obj;
+};
+
+GLUE_FIELDS(native_cpp_args, obj);
+
+/**
+ * \brief Signalled from the Glue thread once Glue is connected.
+ */
+struct glue_ready_event
+{
+	std::mutex mutex;
+	std::condition_variable signalled;
+	bool ready = false;
+
+	void set()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			ready = true;
+		}
+		signalled.notify_all();
+	}
+
+	bool wait(std::chrono::milliseconds timeout)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		return signalled.wait_for(lock, timeout, [this] { return ready; });
+	}
+};
 
 /**
  * \brief Dumps Glue payload.
@@ -30,48 +98,41 @@ void handle_payload(const char* method, COOKIE cookie, const glue_payload* paylo
  */
 void cxt_callback(const char* cxt, const char* field_path, const glue_value* v, COOKIE cookie);
 
+/**
+ * \brief Invokes the best target of an endpoint, then all of its targets.
+ */
+glue::task<> invoke_chain(std::string method);
+
 int main()
 {
-	HANDLE initEvent = CreateEvent(
-		nullptr,
-		TRUE,
-		FALSE,
-		TEXT("GlueInitEvent")
-	);
-
-	if (initEvent == nullptr)
-	{
-		std::cout << "Something went very wrong - cannot create event" << std::endl;
-		return 0;
-	}
+	glue_ready_event init_event;
 
 	std::cout << "Hello Glue Native World!" << std::endl;
 
 	glue_init("glue_cpp_native", [](glue_state state, const char* message, const glue_payload* glue_payload, COOKIE cookie)
 		{
-			const auto glue_ready_event = const_cast<const HANDLE>(cookie);
+			const auto ready_event = static_cast<glue_ready_event*>(const_cast<void*>(cookie));
 
 			std::cout << "Glue Init state: " << enum_as_int(state) << " Message: " << message << std::endl;
 			if (state == glue_state::connected)
 			{
-				SetEvent(glue_ready_event);
+				ready_event->set();
 			}
-		});
+		}, &init_event);
 
 	glue_subscribe_endpoints_status([](const char* endpoint_name, const char* origin, bool state, COOKIE cookie)
 		{
 			std::cout << (state ? "+" : "-") << endpoint_name << " at " << origin << std::endl;
 		}, nullptr);
 
-	const auto wait_res = WaitForSingleObject(initEvent, 10000);
-	if (wait_res == WAIT_OBJECT_0)
+	if (init_event.wait(std::chrono::milliseconds(10000)))
 	{
-		glue_register_endpoint("glue_native_cpp",
-			[](const char* endpoint_name, COOKIE cookie, const glue_payload* payload, const void* endpoint)
+		glue_register_schema_endpoint<native_cpp_args>("glue_native_cpp",
+			[](const char* endpoint_name, COOKIE cookie, const native_cpp_args& args, const glue_payload* payload, const void* endpoint)
 			{
 				std::cout << "Method " << endpoint_name << " invoked by " << payload->origin << "with " << payload->args_len << " args" << std::endl;
 
-				std::cout << glue_read_s(payload->reader, "obj.name.first") << std::endl;
+				std::cout << args.obj.name.first << std::endl;
 
 				handle_payload(endpoint_name, cookie, payload);
 				/*
@@ -142,6 +203,10 @@ int main()
 			return true;
 		}, nullptr);
 
+	// same-host subscribers and publishers of native_stream branches - see the shmsub_/shmpush_ commands
+	std::vector<std::unique_ptr<glue_shm_subscriber>> shm_subscribers;
+	std::map<std::string, std::unique_ptr<glue_shm_publisher>> shm_publishers;
+
 	while (true)
 	{
 		std::string input;
@@ -152,6 +217,13 @@ int main()
 			break;
 		}
 
+		if (input.rfind("bench_", 0) == 0)
+		{
+			// run a local microbenchmark - e.g. bench_arena
+			run_benchmark(input.substr(strlen("bench_")));
+			continue;
+		}
+
 		if (input.rfind("invokeall_") == 0)
 		{
 			std::string method = input.substr(strlen("invokeall_"));
@@ -170,6 +242,26 @@ int main()
 			continue;
 		}
 
+		if (input.rfind("invokeeach_", 0) == 0)
+		{
+			std::string method = input.substr(strlen("invokeeach_"));
+
+			// send invocation to all available targets with that method - each result handled as it arrives
+			glue_invoke_all_options options;
+			options.timeout = std::chrono::seconds(5);
+			glue_invoke_all_partial(method.c_str(), nullptr, 0,
+				[](const char* origin, COOKIE cookie, const glue_payload* payload)
+				{
+					handle_payload(origin, cookie, payload);
+				},
+				[](const char* origin, COOKIE, const glue_invoke_all_summary* summary)
+				{
+					std::cout << "Finished invocation of " << origin << ": " << summary->succeeded << " succeeded, " << summary->failed << " failed, "
+						<< summary->pending << " did not respond in " << summary->elapsed_us / 1000 << " ms" << std::endl;
+				}, "each result", options);
+			continue;
+		}
+
 		if (input.rfind("invoke_") == 0)
 		{
 			std::string method = input.substr(strlen("invoke_"));
@@ -183,6 +275,13 @@ int main()
 			continue;
 		}
 
+		if (input.rfind("chain_", 0) == 0)
+		{
+			// one invocation after the other - each hop awaited, none needing a callback or a cookie
+			invoke_chain(input.substr(strlen("chain_"))).detach();
+			continue;
+		}
+
 		if (input.rfind("channel_", 0) == 0)
 		{
 			std::string channel_name = "___channel___";
@@ -194,7 +293,7 @@ int main()
 			// async channel reading
 			glue_read_context(channel_name.c_str(), "data.contact.displayName", [](const char* context_name, const char* field_path, const glue_value* glue_value, COOKIE cookie)
 				{
-					std::cout << context_name << "(" << field_path << ") = " << glue_value->len << std::endl;
+					std::cout << context_name << "(" << field_path << ") = " << (glue_value != nullptr ? glue_value->len : 0) << std::endl;
 				}, nullptr);
 
 
@@ -240,6 +339,64 @@ int main()
 			continue;
 		}
 
+		if (input.rfind("jsoncheck_", 0) == 0)
+		{
+			std::string channel_name = "___channel___";
+			channel_name.append(input.substr(strlen("jsoncheck_")));
+
+			// differential check of glue_json_parser against GlueCLILib - each text is written through a context writer and read back
+			const char* texts[] = {
+				"{x: 5, y: {a: 51, s: \"hello\"}}",
+				"{a: 5, y: {s: \"yes\", z: 5.155, abc: [12,3,4,5,66]}}",
+				"{fruits: {type: 'apples', items: ['red', 'white']}}",
+				"{big: 3000000000, neg: -1.5e3, flags: [true, false], rows: [{x: 1}, {x: 2}], mixed: [1, 'a'], esc: 'a\\nb\\u00e9'}" };
+
+			glue_arena arena;
+			glue_json_parser parser;
+			for (const auto text : texts)
+			{
+				const auto writer = glue_get_context_writer(channel_name.c_str(), "data.json_check");
+				glue_push_json_payload(writer, text);
+				glue_destroy_resource(writer);
+
+				const auto channel = glue_read_context_sync(channel_name.c_str());
+				const auto expected = glue_read_glue_value(channel, "data.json_check");
+				glue_value parsed;
+				const auto same = parser.parse(arena, text, parsed) == 0 && glue_value_equal(expected, parsed, true);
+				std::cout << (same ? "match: " : "MISMATCH: ") << text << std::endl;
+
+				glue_destroy_resource(channel);
+				arena.reset();
+			}
+			continue;
+		}
+
+		if (input.rfind("shmsub_", 0) == 0)
+		{
+			std::string branch = input.substr(strlen("shmsub_"));
+
+			// subscribe to a branch of native_stream over shared memory - run shmpush_ in another console on the same machine
+			auto subscriber = std::make_unique<glue_shm_subscriber>("native_stream", branch.c_str(), &handle_payload, "shm");
+			std::cout << (subscriber->is_open() ? "Subscribed to " : "Cannot subscribe to ") << "native_stream/" << branch << " over shared memory" << std::endl;
+			shm_subscribers.push_back(std::move(subscriber));
+			continue;
+		}
+
+		if (input.rfind("shmpush_", 0) == 0)
+		{
+			std::string branch = input.substr(strlen("shmpush_"));
+
+			// push to the same-host subscribers of a native_stream branch
+			auto& publisher = shm_publishers[branch];
+			if (publisher == nullptr)
+			{
+				publisher = std::make_unique<glue_shm_publisher>("native_stream", branch.c_str());
+			}
+			const auto pushed = publisher->push_json("{fruits: {type: 'apples', items: ['red', 'white']}}");
+			std::cout << "Pushed to " << pushed << " shared memory subscribers" << std::endl;
+			continue;
+		}
+
 		if (input.rfind("push_") == 0)
 		{
 			std::string branch = input.substr(strlen("push_"));
@@ -259,8 +416,6 @@ int main()
 			continue;
 		}
 	}
-
-	CloseHandle(initEvent);
 }
 
 void cxt_callback(const char* cxt, const char* field_path, const glue_value* v, COOKIE cookie)
@@ -278,85 +433,34 @@ void cxt_callback(const char* cxt, const char* field_path, const glue_value* v,
 }
 
 
-void traverse_glue_value(const glue_value& gv, std::stringstream& str)
-{
-#define BUILD_STR(ARR)\
-        for (int ix = 0; ix < gv.len; ++ix)\
-        {\
-			str << gv.ARR[ix] << ",";\
-        }\
-
-	if (gv.len < 0)
-	{
-		switch (gv.type)
-		{
-		case glue_type::glue_bool: str << gv.b << std::endl; break;
-		case glue_type::glue_int: str << gv.i << std::endl; break;
-		case glue_type::glue_long: str << gv.l << std::endl; break;
-		case glue_type::glue_double: str << gv.d << std::endl; break;
-		case glue_type::glue_string: str << gv.s << std::endl; break;
-		case glue_type::glue_datetime: str << gv.l << std::endl; break;
-		default:;
-		}
-	}
-	else
-	{
-		str << "(" << gv.len << ")" << "[";
-		switch (gv.type)
-		{
-		case glue_type::glue_bool:
-			BUILD_STR(bb)
-				break;
-		case glue_type::glue_int:
-			BUILD_STR(ii)
-				break;
-		case glue_type::glue_long:
-			BUILD_STR(ll)
-				break;
-		case glue_type::glue_double:
-			BUILD_STR(dd)
-				break;
-		case glue_type::glue_string:
-			BUILD_STR(ss)
-				break;
-		case glue_type::glue_datetime:
-			BUILD_STR(ll)
-				break;
-		case glue_type::glue_tuple:
-			for (int i = 0; i < gv.len; ++i)
-			{
-				traverse_glue_value(gv.tuple[i], str);
-			}
-			break;
-		case glue_type::glue_composite:
-		case glue_type::glue_composite_array:
-			for (int i = 0; i < gv.len; ++i)
-			{
-				const auto arg = gv.composite[i];
-				str << arg.name << " = ";
-				traverse_glue_value(arg.value, str);
-			}
-			break;
-		default:;
-		}
-		str << "]";
-	}
-}
-
 void handle_payload(const char* endpoint, COOKIE cookie, const glue_payload* payload)
 {
 	std::cout << static_cast<const char*>(cookie) << ": Payload from " << endpoint << " with origin " <<
 		(payload->origin != nullptr ? payload->origin : "NULL") << " with status " << payload->status << std::endl;
 
+	// one buffer reused for all args
+	std::string json;
 	for (int i = 0; i < payload->args_len; ++i)
 	{
 		const auto arg = payload->args[i];
-		std::cout << arg.name << " = ";
-
-		const auto gv = arg.value;
-		std::stringstream str;
-		traverse_glue_value(gv, str);
-		std::cout << str.str() << std::endl;
+		json.clear();
+		glue_write_json(arg.value, json);
+		std::cout << arg.name << " = " << json << std::endl;
 	}
 	std::cout << std::endl;
+}
+
+glue::task<> invoke_chain(std::string method)
+{
+	const auto best = co_await glue::invoke(method.c_str());
+	const auto payload = best.payload();
+	handle_payload(method.c_str(), "chained single result", &payload);
+
+	const auto all = co_await glue::invoke_all(method.c_str());
+	std::cout << "Finished chained invocation of " << method << " for " << all.size() << " targets" << std::endl;
+	for (const auto& result : all)
+	{
+		const auto each = result.payload();
+		handle_payload(method.c_str(), "chained multiple results", &each);
+	}
 }
\ No newline at end of file
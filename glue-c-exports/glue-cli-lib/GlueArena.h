@@ -0,0 +1,373 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+
+#include "GlueCLILib.h"
+
+/**
+ * \brief Bump allocator for building Glue payloads.
+ * All nested glue_arg/glue_value arrays and copied strings of a payload are carved from
+ * the arena's blocks, so the whole payload is released at once by reset() - typically right
+ * after glue_push_payload. Once the arena has seen its largest payload, building further
+ * payloads performs no heap allocations.
+ * Not thread safe - use one arena per publishing thread.
+ */
+class glue_arena
+{
+public:
+	explicit glue_arena(size_t block_size = 4096) : block_size_(block_size < min_block_size ? min_block_size : block_size)
+	{
+	}
+
+	~glue_arena()
+	{
+		release_blocks(head_);
+	}
+
+	glue_arena(const glue_arena&) = delete;
+	glue_arena& operator=(const glue_arena&) = delete;
+
+	/**
+	 * \brief Allocates raw memory from the arena.
+	 * \param size Number of bytes.
+	 * \param align Required alignment - must be a power of 2.
+	 * \return Pointer to the memory - valid until reset() or the arena's destruction.
+	 */
+	void* allocate(size_t size, size_t align = alignof(std::max_align_t))
+	{
+		auto p = align_up(cur_, align);
+		if (p + size > end_)
+		{
+			grow(size + align);
+			p = align_up(cur_, align);
+		}
+		cur_ = p + size;
+		return p;
+	}
+
+	/**
+	 * \brief Allocates an uninitialized array of trivially destructible items.
+	 */
+	template <typename T>
+	T* alloc(size_t len)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "arena items are never destructed");
+		return static_cast<T*>(allocate(sizeof(T) * len, alignof(T)));
+	}
+
+	/**
+	 * \brief Copies an array of trivially copyable items into the arena.
+	 */
+	template <typename T>
+	T* copy(const T* items, size_t len)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "arena items are copied bitwise");
+		if (len == 0)
+		{
+			return nullptr;
+		}
+		const auto p = alloc<T>(len);
+		memcpy(p, items, sizeof(T) * len);
+		return p;
+	}
+
+	template <typename T>
+	T* copy(std::initializer_list<T> items)
+	{
+		return copy(items.begin(), items.size());
+	}
+
+	/**
+	 * \brief Copies a zero terminated string into the arena.
+	 * \return The copy or nullptr if s is nullptr.
+	 */
+	const char* copy_string(const char* s)
+	{
+		if (s == nullptr)
+		{
+			return nullptr;
+		}
+		const auto len = strlen(s) + 1;
+		const auto p = static_cast<char*>(allocate(len, 1));
+		memcpy(p, s, len);
+		return p;
+	}
+
+	/**
+	 * \brief Releases everything allocated from the arena in one shot.
+	 * If the last payload spilled over several blocks they are merged into a single block
+	 * large enough for it, so steady-state payload building does not touch the heap.
+	 */
+	void reset()
+	{
+		if (head_ != nullptr && head_->next != nullptr)
+		{
+			size_t capacity = 0;
+			for (auto b = head_; b != nullptr; b = b->next)
+			{
+				capacity += b->size;
+			}
+			release_blocks(head_);
+			head_ = nullptr;
+			block_size_ = capacity;
+			grow(0);
+		}
+		else if (head_ != nullptr)
+		{
+			cur_ = head_->data();
+		}
+		used_before_ = 0;
+	}
+
+	/**
+	 * \brief Bytes handed out since the last reset (including alignment padding).
+	 */
+	size_t used() const
+	{
+		return head_ == nullptr ? 0 : used_before_ + static_cast<size_t>(cur_ - head_->data());
+	}
+
+private:
+	static constexpr size_t min_block_size = 256;
+
+	struct block
+	{
+		block* next;
+		size_t size;
+
+		char* data()
+		{
+			return reinterpret_cast<char*>(this + 1);
+		}
+	};
+
+	static char* align_up(char* p, size_t align)
+	{
+		const auto v = reinterpret_cast<uintptr_t>(p);
+		return reinterpret_cast<char*>((v + (align - 1)) & ~static_cast<uintptr_t>(align - 1));
+	}
+
+	static void release_blocks(block* b)
+	{
+		while (b != nullptr)
+		{
+			const auto next = b->next;
+			free(b);
+			b = next;
+		}
+	}
+
+	void grow(size_t min_size)
+	{
+		if (head_ != nullptr)
+		{
+			used_before_ += static_cast<size_t>(cur_ - head_->data());
+		}
+
+		auto size = block_size_;
+		while (size < min_size)
+		{
+			size *= 2;
+		}
+
+		const auto b = static_cast<block*>(malloc(sizeof(block) + size));
+		if (b == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+		b->next = head_;
+		b->size = size;
+		head_ = b;
+		cur_ = b->data();
+		end_ = cur_ + size;
+	}
+
+	block* head_ = nullptr;
+	char* cur_ = nullptr;
+	char* end_ = nullptr;
+	size_t block_size_;
+	size_t used_before_ = 0;
+};
+
+// arena-aware builders - strings and nested arrays are copied into the arena, names are kept as passed
+
+#define ARENA_VAL_BUILD_S(N) \
+ inline glue_value N(glue_arena& arena, const char* s) \
+ {\
+	return N(arena.copy_string(s));\
+ }
+
+#define ARENA_VAL_ARR_BUILD(T, N) \
+ inline glue_value N(glue_arena& arena, std::initializer_list<T> items) \
+ {\
+	return N(arena.copy(items), static_cast<int>(items.size()));\
+ }\
+ inline glue_value N(glue_arena& arena, const T* items, int len) \
+ {\
+	return N(arena.copy(items, len), len);\
+ }
+
+#define ARENA_ARG_BUILD_S(N) \
+ inline glue_arg N(glue_arena& arena, const char* name, const char* s) \
+ {\
+	return N(name, arena.copy_string(s));\
+ }
+
+#define ARENA_ARR_BUILD(T, N) \
+ inline glue_arg N(glue_arena& arena, const char* name, std::initializer_list<T> items) \
+ {\
+	return N(name, arena.copy(items), static_cast<int>(items.size()));\
+ }\
+ inline glue_arg N(glue_arena& arena, const char* name, const T* items, int len) \
+ {\
+	return N(name, arena.copy(items, len), len);\
+ }
+
+/**
+ * \brief Copies an array of strings and the strings themselves into the arena.
+ */
+inline const char** glue_arena_copy_strings(glue_arena& arena, const char* const* items, size_t len)
+{
+	if (len == 0)
+	{
+		return nullptr;
+	}
+	const auto ss = arena.alloc<const char*>(len);
+	for (size_t i = 0; i < len; ++i)
+	{
+		ss[i] = arena.copy_string(items[i]);
+	}
+	return ss;
+}
+
+inline glue_value glue_arena_copy_value(glue_arena& arena, const glue_value& v);
+
+/**
+ * \brief Deep copies args - their names, strings and nested arrays - into the arena.
+ */
+inline glue_arg* glue_arena_copy_args(glue_arena& arena, const glue_arg* args, int len)
+{
+	if (args == nullptr || len <= 0)
+	{
+		return nullptr;
+	}
+	const auto copy = arena.alloc<glue_arg>(static_cast<size_t>(len));
+	for (int i = 0; i < len; ++i)
+	{
+		copy[i] = glue_arg{ arena.copy_string(args[i].name), glue_arena_copy_value(arena, args[i].value) };
+	}
+	return copy;
+}
+
+/**
+ * \brief Deep copies a Glue value into the arena.
+ */
+inline glue_value glue_arena_copy_value(glue_arena& arena, const glue_value& v)
+{
+	auto copy = v;
+	if (v.len < 0)
+	{
+		if (v.type == glue_type::glue_string)
+		{
+			copy.s = arena.copy_string(v.s);
+		}
+		return copy;
+	}
+
+	const auto len = static_cast<size_t>(v.len);
+	switch (v.type)
+	{
+	case glue_type::glue_bool:
+		copy.bb = arena.copy(v.bb, len);
+		break;
+	case glue_type::glue_int:
+		copy.ii = arena.copy(v.ii, len);
+		break;
+	case glue_type::glue_long:
+	case glue_type::glue_datetime:
+		copy.ll = arena.copy(v.ll, len);
+		break;
+	case glue_type::glue_double:
+		copy.dd = arena.copy(v.dd, len);
+		break;
+	case glue_type::glue_string:
+		copy.ss = glue_arena_copy_strings(arena, v.ss, len);
+		break;
+	case glue_type::glue_tuple:
+		copy.tuple = len > 0 ? arena.alloc<glue_value>(len) : nullptr;
+		for (size_t i = 0; i < len; ++i)
+		{
+			copy.tuple[i] = glue_arena_copy_value(arena, v.tuple[i]);
+		}
+		break;
+	case glue_type::glue_composite:
+	case glue_type::glue_composite_array:
+		copy.composite = glue_arena_copy_args(arena, v.composite, v.len);
+		break;
+	default:
+		break;
+	}
+	return copy;
+}
+
+ARENA_VAL_BUILD_S(glv_s);
+
+ARENA_VAL_ARR_BUILD(bool, glv_bb);
+ARENA_VAL_ARR_BUILD(int, glv_ii);
+ARENA_VAL_ARR_BUILD(long long, glv_ll);
+ARENA_VAL_ARR_BUILD(double, glv_dd);
+ARENA_VAL_ARR_BUILD(long long, glv_dts);
+ARENA_VAL_ARR_BUILD(glue_value, glv_tuple);
+ARENA_VAL_ARR_BUILD(glue_arg, glv_comp);
+ARENA_VAL_ARR_BUILD(glue_arg, glv_comps);
+
+inline glue_value glv_ss(glue_arena& arena, std::initializer_list<const char*> items)
+{
+	return glv_ss(glue_arena_copy_strings(arena, items.begin(), items.size()), static_cast<int>(items.size()));
+}
+
+inline glue_value glv_ss(glue_arena& arena, const char* const* items, int len)
+{
+	return glv_ss(glue_arena_copy_strings(arena, items, len), len);
+}
+
+ARENA_ARG_BUILD_S(glarg_s);
+
+ARENA_ARR_BUILD(bool, glarg_bb);
+ARENA_ARR_BUILD(int, glarg_ii);
+ARENA_ARR_BUILD(long long, glarg_ll);
+ARENA_ARR_BUILD(double, glarg_dd);
+ARENA_ARR_BUILD(long long, glarg_dts);
+ARENA_ARR_BUILD(glue_value, glarg_tuple);
+ARENA_ARR_BUILD(glue_arg, glarg_comp);
+ARENA_ARR_BUILD(glue_arg, glarg_comps);
+
+inline glue_arg glarg_ss(glue_arena& arena, const char* name, std::initializer_list<const char*> items)
+{
+	return glarg_ss(name, glue_arena_copy_strings(arena, items.begin(), items.size()), static_cast<int>(items.size()));
+}
+
+inline glue_arg glarg_ss(glue_arena& arena, const char* name, const char* const* items, int len)
+{
+	return glarg_ss(name, glue_arena_copy_strings(arena, items, len), len);
+}
+
+/**
+ * \brief Pushes a payload built in an arena and resets the arena afterwards.
+ * \param endpoint The reference to the endpoint returned by the corresponding register call.
+ * \param args The pointer to the start of the array.
+ * \param len The length of the arguments array.
+ * \param arena The arena holding the payload - reset once the payload has been pushed.
+ * \return 0 if the args were pushed successfully.
+ */
+inline int glue_push_payload(const void* endpoint, const glue_arg* args, int len, glue_arena& arena)
+{
+	const auto result = glue_push_payload(endpoint, args, len);
+	arena.reset();
+	return result;
+}
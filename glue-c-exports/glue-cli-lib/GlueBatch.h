@@ -0,0 +1,260 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "GlueCLILib.h"
+#include "GluePath.h"
+
+/*
+ * Batch reads - extracting many field paths in a single traversal.
+ *
+ * glue_compile_batch builds a trie of the requested paths; glue_read_batch then visits every
+ * shared prefix only once. Compile the batch once and reuse it for every update:
+ *
+ *	static const auto batch = glue_compile_batch(paths, std::size(paths));
+ *	glue_value values[std::size(paths)];
+ *	glue_read_batch(glue_read_context_sync(channel), batch, values);
+ */
+
+/**
+ * \brief Trie node of a compiled batch - a single path segment.
+ */
+struct glue_batch_node
+{
+	glue_path_segment segment;
+	// index of the requested path ending at this node or -1
+	int target;
+	std::vector<int> children;
+};
+
+/**
+ * \brief Compiled batch of field paths - treat as opaque, obtained by glue_compile_batch.
+ */
+struct glue_batch
+{
+	std::vector<const glue_path*> paths;
+	// node 0 is the root
+	std::vector<glue_batch_node> nodes;
+	// subtrees read from readers with a single call each - the longest prefixes shared by their paths
+	std::vector<int> groups;
+	std::vector<std::string> group_paths;
+	// requested paths without any segments (the whole reader)
+	std::vector<int> root_targets;
+	// (path, earlier identical path) pairs
+	std::vector<std::pair<int, int>> duplicates;
+
+	~glue_batch()
+	{
+		for (const auto path : paths)
+		{
+			glue_delete_path(path);
+		}
+	}
+};
+
+/**
+ * \brief Compiles a batch of dot-separated field paths into a trie.
+ * \param paths The field paths - the result of the i-th path is written to the i-th read value.
+ * \param n The number of paths.
+ * \return Handle to the batch. Release it via glue_delete_batch.
+ */
+inline const glue_batch* glue_compile_batch(const char* const* paths, int n)
+{
+	const auto batch = new glue_batch();
+	batch->nodes.push_back(glue_batch_node{ glue_path_segment{ "", 0, 0 }, -1, {} });
+
+	for (int i = 0; i < n; ++i)
+	{
+		const auto path = glue_compile_path(paths[i]);
+		batch->paths.push_back(path);
+		if (path->segments.empty())
+		{
+			batch->root_targets.push_back(i);
+			continue;
+		}
+
+		int node = 0;
+		for (const auto& segment : path->segments)
+		{
+			int next = -1;
+			for (const auto child : batch->nodes[node].children)
+			{
+				const auto& s = batch->nodes[child].segment;
+				if (s.hash == segment.hash && s.len == segment.len && strncmp(s.name, segment.name, s.len) == 0)
+				{
+					next = child;
+					break;
+				}
+			}
+
+			if (next < 0)
+			{
+				next = static_cast<int>(batch->nodes.size());
+				batch->nodes.push_back(glue_batch_node{ segment, -1, {} });
+				batch->nodes[node].children.push_back(next);
+			}
+			node = next;
+		}
+
+		if (batch->nodes[node].target < 0)
+		{
+			batch->nodes[node].target = i;
+		}
+		else
+		{
+			batch->duplicates.emplace_back(i, batch->nodes[node].target);
+		}
+	}
+
+	// every top level branch is read from readers as one subtree - descend through single child prefixes
+	for (const auto top : batch->nodes[0].children)
+	{
+		auto node = top;
+		std::string text(batch->nodes[node].segment.name, batch->nodes[node].segment.len);
+		while (batch->nodes[node].target < 0 && batch->nodes[node].children.size() == 1)
+		{
+			node = batch->nodes[node].children[0];
+			text.append(".").append(batch->nodes[node].segment.name, batch->nodes[node].segment.len);
+		}
+		batch->groups.push_back(node);
+		batch->group_paths.push_back(text);
+	}
+	return batch;
+}
+
+/**
+ * \brief Releases a batch compiled via glue_compile_batch.
+ */
+inline void glue_delete_batch(const glue_batch* batch)
+{
+	delete batch;
+}
+
+/**
+ * \brief Writes the values of a trie node and all its descendants.
+ */
+inline int glue_visit_batch_node(const glue_batch* batch, int node, const glue_value& v, glue_value out[], glue_index_cache* cache)
+{
+	const auto& n = batch->nodes[node];
+
+	int found = 0;
+	if (n.target >= 0)
+	{
+		out[n.target] = v;
+		++found;
+	}
+
+	if (n.children.empty() || v.type != glue_type::glue_composite || v.len < 0)
+	{
+		return found;
+	}
+
+	for (const auto child : n.children)
+	{
+		const auto child_value = glue_find_arg(v.composite, v.len, batch->nodes[child].segment, cache);
+		if (child_value != nullptr)
+		{
+			found += glue_visit_batch_node(batch, child, *child_value, out, cache);
+		}
+	}
+	return found;
+}
+
+/**
+ * \brief Copies the values of duplicate paths from the path they share a trie node with.
+ */
+inline int glue_fill_batch_duplicates(const glue_batch* batch, glue_value out[])
+{
+	int found = 0;
+	for (const auto& duplicate : batch->duplicates)
+	{
+		out[duplicate.first] = out[duplicate.second];
+		found += out[duplicate.first].type != glue_type::glue_none ? 1 : 0;
+	}
+	return found;
+}
+
+/**
+ * \brief Reads all paths of a batch from a composite Glue value in a single traversal.
+ * \param root The composite to read from.
+ * \param batch The compiled batch.
+ * \param out Receives one value per batch path - glue_none typed values for missing fields.
+ * \param cache Optional index cache for wide composites.
+ * \return The number of paths found.
+ */
+inline int glue_read_batch(const glue_value& root, const glue_batch* batch, glue_value out[], glue_index_cache* cache = nullptr)
+{
+	for (size_t i = 0; i < batch->paths.size(); ++i)
+	{
+		out[i] = glue_value{};
+	}
+
+	for (const auto target : batch->root_targets)
+	{
+		out[target] = root;
+	}
+
+	const auto found = glue_visit_batch_node(batch, 0, root, out, cache) + static_cast<int>(batch->root_targets.size());
+	return found + glue_fill_batch_duplicates(batch, out);
+}
+
+/**
+ * \brief Reads all paths of a batch from a payload's args in a single traversal.
+ */
+inline int glue_read_batch(const glue_payload* payload, const glue_batch* batch, glue_value out[], glue_index_cache* cache = nullptr)
+{
+	return glue_read_batch(glv_comp(const_cast<glue_arg*>(payload->args), payload->args_len), batch, out, cache);
+}
+
+/**
+ * \brief Reads all paths of a batch from a reader.
+ * Each top level branch of the trie is fetched from the reader with a single glue_read_glue_value
+ * call for the longest prefix its paths share, and the branch is then resolved in memory.
+ * \param reader The reader obtained from a glue_payload or glue_read_context_sync
+ * \param batch The compiled batch.
+ * \param out Receives one value per batch path - valid for the lifetime of the reader.
+ * \param cache Optional index cache for wide composites - clear it before destroying the reader.
+ * \return The number of paths found.
+ */
+inline int glue_read_batch(const void* reader, const glue_batch* batch, glue_value out[], glue_index_cache* cache = nullptr)
+{
+	for (size_t i = 0; i < batch->paths.size(); ++i)
+	{
+		out[i] = glue_value{};
+	}
+
+	int found = 0;
+	if (!batch->root_targets.empty())
+	{
+		const auto root = glue_read_glue_value(reader, "");
+		for (const auto target : batch->root_targets)
+		{
+			out[target] = root;
+			++found;
+		}
+	}
+
+	for (size_t g = 0; g < batch->groups.size(); ++g)
+	{
+		const auto v = glue_read_glue_value(reader, batch->group_paths[g].c_str());
+		if (v.type != glue_type::glue_none)
+		{
+			found += glue_visit_batch_node(batch, batch->groups[g], v, out, cache);
+		}
+	}
+
+	return found + glue_fill_batch_duplicates(batch, out);
+}
+
+/**
+ * \brief Reads n field paths from a reader in one traversal, compiling the batch on the fly.
+ * Prefer compiling the batch once via glue_compile_batch when the same paths are read repeatedly.
+ */
+inline int glue_read_batch(const void* reader, const char* const* paths, int n, glue_value out[])
+{
+	const auto batch = glue_compile_batch(paths, n);
+	const auto found = glue_read_batch(reader, batch, out);
+	glue_delete_batch(batch);
+	return found;
+}
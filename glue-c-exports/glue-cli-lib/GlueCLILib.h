@@ -1,5 +1,7 @@
 #pragma once
 #include <type_traits>
+
+#ifdef _WIN32
 #include <Windows.h>
 
 #ifdef GLUE_LIBRARY_EXPORTS
@@ -7,6 +9,15 @@
 #else
 #define GLUE_LIB_API __declspec(dllimport)
 #endif
+#else
+// other platforms - the in-process loopback backend (see loopback/GlueLoopback.h); windows are opaque handles
+typedef struct HWND__* HWND;
+
+#ifndef __cdecl
+#define __cdecl
+#endif
+#define GLUE_LIB_API __attribute__((visibility("default")))
+#endif
 
 template <typename Enumeration>
 std::underlying_type_t<Enumeration> enum_as_int(Enumeration const value)
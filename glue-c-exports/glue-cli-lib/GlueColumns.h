@@ -0,0 +1,479 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLUE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "GlueCLILib.h"
+
+/*
+ * Columnar (struct-of-arrays) view of glue_composite_array values.
+ *
+ * A composite array of homogeneous rows is converted once into contiguous typed columns,
+ * so that aggregations run over plain arrays instead of chasing pointers per row:
+ *
+ *	glue_columns columns;
+ *	if (columns.build(rows))
+ *	{
+ *		const auto px = columns.find("price");
+ *		const auto qty = columns.find("size");
+ *		const auto vwap = glue_column_vwap(px->d, qty->l, columns.rows());
+ *	}
+ */
+
+/**
+ * \brief A single column - the pointer matching the column's type is set.
+ * Numeric columns are promoted to the widest type seen in the rows (int < long < double).
+ * String columns are an offset table into a single character block - row r spans
+ * chars[offsets[r]] .. chars[offsets[r + 1] - 1] and is zero terminated; null strings have nulls[r] set.
+ */
+struct glue_column
+{
+	const char* name;
+	glue_type type;
+
+	const bool* b;
+	const int* i;
+	const long long* l;
+	const double* d;
+
+	const uint32_t* offsets;
+	const char* chars;
+	const bool* nulls;
+};
+
+/**
+ * \brief Converts a glue_composite_array of uniformly shaped rows into typed columns.
+ * Scalar fields become columns; array, tuple and composite fields are not exposed.
+ * The column storage is reused between builds - keep one instance per blotter/stream.
+ */
+class glue_columns
+{
+public:
+	/**
+	 * \brief Converts the rows into columns.
+	 * \param rows glue_composite_array value (or an array of named composites).
+	 * \return false if the rows are not uniform - different field names/order or mismatching scalar types.
+	 */
+	bool build(const glue_value& rows)
+	{
+		rows_ = 0;
+		columns_.clear();
+		if ((rows.type != glue_type::glue_composite_array && rows.type != glue_type::glue_composite) || rows.len < 0)
+		{
+			return false;
+		}
+
+		const auto row_count = rows.len;
+		if (row_count == 0)
+		{
+			return true;
+		}
+
+		// shape of the first row
+		const auto& first = rows.composite[0].value;
+		if (first.type != glue_type::glue_composite || first.len < 0)
+		{
+			return false;
+		}
+		const auto width = first.len;
+		if (storage_.size() < static_cast<size_t>(width))
+		{
+			storage_.resize(width);
+		}
+		for (int f = 0; f < width; ++f)
+		{
+			const auto& v = first.composite[f].value;
+			storage_[f].type = v.len < 0 && v.type != glue_type::glue_tuple && v.type != glue_type::glue_composite && v.type != glue_type::glue_composite_array
+				? v.type
+				: glue_type::glue_none;
+		}
+
+		// validate the shape and widen the numeric types
+		for (int r = 1; r < row_count; ++r)
+		{
+			const auto& row = rows.composite[r].value;
+			if (row.type != glue_type::glue_composite || row.len != width)
+			{
+				return false;
+			}
+			for (int f = 0; f < width; ++f)
+			{
+				const auto name = row.composite[f].name;
+				const auto first_name = first.composite[f].name;
+				if (name != first_name && (name == nullptr || first_name == nullptr || strcmp(name, first_name) != 0))
+				{
+					return false;
+				}
+
+				auto& type = storage_[f].type;
+				if (type == glue_type::glue_none)
+				{
+					continue;
+				}
+
+				const auto& v = row.composite[f].value;
+				if (v.len >= 0)
+				{
+					return false;
+				}
+				if (v.type != type)
+				{
+					const auto widened = widen(type, v.type);
+					if (widened == glue_type::glue_none)
+					{
+						return false;
+					}
+					type = widened;
+				}
+			}
+		}
+
+		// fill the columns
+		for (int f = 0; f < width; ++f)
+		{
+			auto& s = storage_[f];
+			glue_column column{};
+			column.name = first.composite[f].name;
+			column.type = s.type;
+
+			switch (s.type)
+			{
+			case glue_type::glue_bool:
+			{
+				const auto bools = s.bools.reserve(row_count);
+				for (int r = 0; r < row_count; ++r)
+				{
+					bools[r] = rows.composite[r].value.composite[f].value.b;
+				}
+				column.b = bools;
+				break;
+			}
+			case glue_type::glue_int:
+				s.ints.resize(row_count);
+				for (int r = 0; r < row_count; ++r)
+				{
+					s.ints[r] = rows.composite[r].value.composite[f].value.i;
+				}
+				column.i = s.ints.data();
+				break;
+			case glue_type::glue_long:
+			case glue_type::glue_datetime:
+				s.longs.resize(row_count);
+				for (int r = 0; r < row_count; ++r)
+				{
+					const auto& v = rows.composite[r].value.composite[f].value;
+					s.longs[r] = v.type == glue_type::glue_int ? v.i : v.l;
+				}
+				column.l = s.longs.data();
+				break;
+			case glue_type::glue_double:
+				s.doubles.resize(row_count);
+				for (int r = 0; r < row_count; ++r)
+				{
+					const auto& v = rows.composite[r].value.composite[f].value;
+					s.doubles[r] = v.type == glue_type::glue_double ? v.d : v.type == glue_type::glue_int ? v.i : static_cast<double>(v.l);
+				}
+				column.d = s.doubles.data();
+				break;
+			case glue_type::glue_string:
+				s.offsets.resize(static_cast<size_t>(row_count) + 1);
+				s.nulls.reserve(row_count);
+				s.chars.clear();
+				for (int r = 0; r < row_count; ++r)
+				{
+					const auto str = rows.composite[r].value.composite[f].value.s;
+					s.offsets[r] = static_cast<uint32_t>(s.chars.size());
+					s.nulls.data[r] = str == nullptr;
+					if (str != nullptr)
+					{
+						s.chars.append(str);
+					}
+					s.chars.push_back(0);
+				}
+				s.offsets[row_count] = static_cast<uint32_t>(s.chars.size());
+				column.offsets = s.offsets.data();
+				column.chars = s.chars.data();
+				column.nulls = s.nulls.data.get();
+				break;
+			default:
+				continue;
+			}
+			columns_.push_back(column);
+		}
+
+		rows_ = row_count;
+		return true;
+	}
+
+	int rows() const
+	{
+		return rows_;
+	}
+
+	int width() const
+	{
+		return static_cast<int>(columns_.size());
+	}
+
+	const glue_column& column(int index) const
+	{
+		return columns_[index];
+	}
+
+	/**
+	 * \brief Finds a column by field name.
+	 * \return The column or nullptr.
+	 */
+	const glue_column* find(const char* name) const
+	{
+		for (const auto& column : columns_)
+		{
+			if (column.name != nullptr && strcmp(column.name, name) == 0)
+			{
+				return &column;
+			}
+		}
+		return nullptr;
+	}
+
+	/**
+	 * \brief Gets the string of a row in a string column - nullptr for null strings.
+	 */
+	static const char* string_at(const glue_column& column, int row)
+	{
+		return column.nulls[row] ? nullptr : column.chars + column.offsets[row];
+	}
+
+private:
+	static glue_type widen(glue_type a, glue_type b)
+	{
+		const auto numeric = [](glue_type t)
+		{
+			return t == glue_type::glue_int || t == glue_type::glue_long || t == glue_type::glue_double;
+		};
+		if (!numeric(a) || !numeric(b))
+		{
+			return glue_type::glue_none;
+		}
+		if (a == glue_type::glue_double || b == glue_type::glue_double)
+		{
+			return glue_type::glue_double;
+		}
+		return glue_type::glue_long;
+	}
+
+	/**
+	 * \brief A bool array which only grows - std::vector<bool> is packed, so it has no bool* to expose.
+	 */
+	struct bool_buffer
+	{
+		std::unique_ptr<bool[]> data;
+		size_t capacity = 0;
+
+		bool* reserve(size_t size)
+		{
+			if (capacity < size)
+			{
+				data.reset(new bool[size]);
+				capacity = size;
+			}
+			return data.get();
+		}
+	};
+
+	struct column_storage
+	{
+		glue_type type = glue_type::glue_none;
+		bool_buffer bools;
+		std::vector<int> ints;
+		std::vector<long long> longs;
+		std::vector<double> doubles;
+		std::vector<uint32_t> offsets;
+		std::string chars;
+		bool_buffer nulls;
+	};
+
+	int rows_ = 0;
+	std::vector<glue_column> columns_;
+	std::vector<column_storage> storage_;
+};
+
+// column aggregations - SSE2 with four independent accumulators where available
+// Vectorized sums add in a different order than a sequential loop, so results may differ in the last bits.
+
+inline double glue_column_sum(const double* d, int n)
+{
+	int i = 0;
+	double sum = 0;
+#ifdef GLUE_SSE2
+	auto a0 = _mm_setzero_pd();
+	auto a1 = _mm_setzero_pd();
+	auto a2 = _mm_setzero_pd();
+	auto a3 = _mm_setzero_pd();
+	for (; i + 8 <= n; i += 8)
+	{
+		a0 = _mm_add_pd(a0, _mm_loadu_pd(d + i));
+		a1 = _mm_add_pd(a1, _mm_loadu_pd(d + i + 2));
+		a2 = _mm_add_pd(a2, _mm_loadu_pd(d + i + 4));
+		a3 = _mm_add_pd(a3, _mm_loadu_pd(d + i + 6));
+	}
+	const auto a = _mm_add_pd(_mm_add_pd(a0, a1), _mm_add_pd(a2, a3));
+	double lanes[2];
+	_mm_storeu_pd(lanes, a);
+	sum = lanes[0] + lanes[1];
+#endif
+	for (; i < n; ++i)
+	{
+		sum += d[i];
+	}
+	return sum;
+}
+
+inline long long glue_column_sum(const long long* l, int n)
+{
+	int i = 0;
+	long long sum = 0;
+#ifdef GLUE_SSE2
+	auto a0 = _mm_setzero_si128();
+	auto a1 = _mm_setzero_si128();
+	for (; i + 4 <= n; i += 4)
+	{
+		a0 = _mm_add_epi64(a0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + i)));
+		a1 = _mm_add_epi64(a1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + i + 2)));
+	}
+	long long lanes[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), _mm_add_epi64(a0, a1));
+	sum = lanes[0] + lanes[1];
+#endif
+	for (; i < n; ++i)
+	{
+		sum += l[i];
+	}
+	return sum;
+}
+
+/**
+ * \brief Minimum of a double column - +infinity for empty columns.
+ */
+inline double glue_column_min(const double* d, int n)
+{
+	int i = 0;
+	auto result = std::numeric_limits<double>::infinity();
+#ifdef GLUE_SSE2
+	auto m0 = _mm_set1_pd(result);
+	auto m1 = m0;
+	for (; i + 4 <= n; i += 4)
+	{
+		m0 = _mm_min_pd(m0, _mm_loadu_pd(d + i));
+		m1 = _mm_min_pd(m1, _mm_loadu_pd(d + i + 2));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_min_pd(m0, m1));
+	result = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+#endif
+	for (; i < n; ++i)
+	{
+		result = d[i] < result ? d[i] : result;
+	}
+	return result;
+}
+
+/**
+ * \brief Maximum of a double column - -infinity for empty columns.
+ */
+inline double glue_column_max(const double* d, int n)
+{
+	int i = 0;
+	auto result = -std::numeric_limits<double>::infinity();
+#ifdef GLUE_SSE2
+	auto m0 = _mm_set1_pd(result);
+	auto m1 = m0;
+	for (; i + 4 <= n; i += 4)
+	{
+		m0 = _mm_max_pd(m0, _mm_loadu_pd(d + i));
+		m1 = _mm_max_pd(m1, _mm_loadu_pd(d + i + 2));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_max_pd(m0, m1));
+	result = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+#endif
+	for (; i < n; ++i)
+	{
+		result = d[i] > result ? d[i] : result;
+	}
+	return result;
+}
+
+/**
+ * \brief Volume weighted average price - sum(price * size) / sum(size), 0 for no volume.
+ */
+inline double glue_column_vwap(const double* price, const double* size, int n)
+{
+	int i = 0;
+	double notional = 0;
+	double volume = 0;
+#ifdef GLUE_SSE2
+	auto n0 = _mm_setzero_pd();
+	auto n1 = _mm_setzero_pd();
+	auto v0 = _mm_setzero_pd();
+	auto v1 = _mm_setzero_pd();
+	for (; i + 4 <= n; i += 4)
+	{
+		const auto s0 = _mm_loadu_pd(size + i);
+		const auto s1 = _mm_loadu_pd(size + i + 2);
+		n0 = _mm_add_pd(n0, _mm_mul_pd(_mm_loadu_pd(price + i), s0));
+		n1 = _mm_add_pd(n1, _mm_mul_pd(_mm_loadu_pd(price + i + 2), s1));
+		v0 = _mm_add_pd(v0, s0);
+		v1 = _mm_add_pd(v1, s1);
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(n0, n1));
+	notional = lanes[0] + lanes[1];
+	_mm_storeu_pd(lanes, _mm_add_pd(v0, v1));
+	volume = lanes[0] + lanes[1];
+#endif
+	for (; i < n; ++i)
+	{
+		notional += price[i] * size[i];
+		volume += size[i];
+	}
+	return volume != 0 ? notional / volume : 0;
+}
+
+/**
+ * \brief Volume weighted average price for integral sizes.
+ */
+inline double glue_column_vwap(const double* price, const long long* size, int n)
+{
+	// SSE2 has no 64 bit integer to double conversion - four independent scalar lanes instead
+	double n0 = 0, n1 = 0, n2 = 0, n3 = 0;
+	long long v0 = 0, v1 = 0, v2 = 0, v3 = 0;
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		n0 += price[i] * static_cast<double>(size[i]);
+		n1 += price[i + 1] * static_cast<double>(size[i + 1]);
+		n2 += price[i + 2] * static_cast<double>(size[i + 2]);
+		n3 += price[i + 3] * static_cast<double>(size[i + 3]);
+		v0 += size[i];
+		v1 += size[i + 1];
+		v2 += size[i + 2];
+		v3 += size[i + 3];
+	}
+	auto notional = (n0 + n1) + (n2 + n3);
+	auto volume = (v0 + v1) + (v2 + v3);
+	for (; i < n; ++i)
+	{
+		notional += price[i] * static_cast<double>(size[i]);
+		volume += size[i];
+	}
+	return volume != 0 ? notional / static_cast<double>(volume) : 0;
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "GlueCLILib.h"
+#include "GlueFlat.h"
+
+/*
+ * Last-value conflation of context updates - for consumers slower than the writers of a context.
+ *
+ * Glue delivers every update of a subscribed context on its own thread, so a consumer which handles
+ * them on a slower (e.g. the UI) thread falls ever further behind. A glue_conflating_queue keeps a
+ * single pending update per context and field path instead - the latest value - and the consumer
+ * drains it whenever it gets to it:
+ *
+ *	glue_conflating_queue updates([hwnd] { PostMessage(hwnd, WM_APP_CONTEXT, 0, 0); });
+ *	const auto subscription = updates.subscribe("Red", "data.contact");
+ *	...
+ *	// on WM_APP_CONTEXT
+ *	updates.drain([](const char* context, const char* field_path, const glue_value* value, int conflated) { ... });
+ *
+ * Updates can be offered directly as well - e.g. the data_update window events, which carry no value,
+ * to read the context once per drain rather than once per event.
+ *
+ * Values are copied into a single block per update, valid during the drain callback only.
+ * Pending updates are drained in the order their keys became pending. Destroy subscriptions before their queue.
+ * The header is C++14 - the MFC example includes it.
+ */
+
+/**
+ * \brief Pending context updates, one per context and field path - thread safe.
+ */
+class glue_conflating_queue
+{
+public:
+	/**
+	 * \param notify Called (on the offering thread) whenever the queue stops being empty - e.g. to post a message to the consumer's thread.
+	 */
+	explicit glue_conflating_queue(std::function<void()> notify = nullptr) : notify_(std::move(notify))
+	{
+	}
+
+	glue_conflating_queue(const glue_conflating_queue&) = delete;
+	glue_conflating_queue& operator=(const glue_conflating_queue&) = delete;
+
+	~glue_conflating_queue()
+	{
+		for (const auto& pending : pending_)
+		{
+			glue_delete_flat(pending.value);
+		}
+	}
+
+	/**
+	 * \brief Subscribes to a context - its updates are offered to the queue.
+	 * \return The subscription - release it via glue_destroy_resource, before the queue - or nullptr.
+	 */
+	const void* subscribe(const char* context, const char* field_path)
+	{
+		return glue_subscribe_context(context, field_path, &glue_conflating_queue::receive, this);
+	}
+
+	/**
+	 * \brief Offers an update - it replaces the pending update of the same context and field path.
+	 * \param value Copied - or nullptr for updates without a value.
+	 * \return True if the update replaced a pending one.
+	 */
+	bool offer(const char* context, const char* field_path, const glue_value* value)
+	{
+		auto key = make_key(context, field_path);
+		const auto copy = value != nullptr ? glue_flatten(*value) : nullptr;
+
+		void* replaced = nullptr;
+		bool conflated = false;
+		bool first = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			++offered_;
+			const auto it = index_.find(key);
+			if (it != index_.end())
+			{
+				auto& pending = pending_[it->second];
+				replaced = pending.value;
+				pending.value = copy;
+				++pending.conflated;
+				++conflated_;
+				conflated = true;
+			}
+			else
+			{
+				const auto context_len = strlen(context != nullptr ? context : "");
+				index_.emplace(key, pending_.size());
+				pending_.push_back(pending_update{ std::move(key), context_len, copy, 0 });
+				first = pending_.size() == 1;
+			}
+		}
+
+		glue_delete_flat(replaced);
+		if (first)
+		{
+			ready_.notify_all();
+			if (notify_)
+			{
+				notify_();
+			}
+		}
+		return conflated;
+	}
+
+	/**
+	 * \brief Delivers and removes the pending updates - to callback(context, field_path, value, conflated),
+	 * where conflated is the number of updates this one replaced. Drain from one thread at a time.
+	 * \return The number of updates delivered.
+	 */
+	template <typename F>
+	size_t drain(F&& callback)
+	{
+		std::vector<pending_update> updates;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			updates.swap(pending_);
+			index_.clear();
+		}
+
+		for (const auto& pending : updates)
+		{
+			const auto context = pending.key.c_str();
+			const auto field_path = context + pending.context_len + 1;
+			if (pending.value != nullptr)
+			{
+				const auto value = glue_flat_value(pending.value);
+				callback(context, field_path, &value, pending.conflated);
+				glue_delete_flat(pending.value);
+			}
+			else
+			{
+				callback(context, field_path, static_cast<const glue_value*>(nullptr), pending.conflated);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		delivered_ += static_cast<long long>(updates.size());
+		return updates.size();
+	}
+
+	/**
+	 * \brief Waits until there are pending updates.
+	 * \return False if there are none after the timeout.
+	 */
+	template <typename Rep, typename Period>
+	bool wait(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		return ready_.wait_for(lock, timeout, [this] { return !pending_.empty(); });
+	}
+
+	size_t pending() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return pending_.size();
+	}
+
+	long long offered() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return offered_;
+	}
+
+	long long delivered() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return delivered_;
+	}
+
+	/**
+	 * \brief Updates replaced by later ones before they were drained.
+	 */
+	long long conflated() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return conflated_;
+	}
+
+private:
+	struct pending_update
+	{
+		// context '\0' field path
+		std::string key;
+		size_t context_len;
+		void* value;
+		int conflated;
+	};
+
+	static std::string make_key(const char* context, const char* field_path)
+	{
+		std::string key = context != nullptr ? context : "";
+		key.push_back('\0');
+		key += field_path != nullptr ? field_path : "";
+		return key;
+	}
+
+	static void receive(const char* context_name, const char* field_path, const glue_value* value, COOKIE cookie)
+	{
+		static_cast<glue_conflating_queue*>(const_cast<void*>(cookie))->offer(context_name, field_path, value);
+	}
+
+	std::function<void()> notify_;
+
+	// guarded by the mutex
+	mutable std::mutex mutex_;
+	std::condition_variable ready_;
+	std::vector<pending_update> pending_;
+	std::unordered_map<std::string, size_t> index_;
+	long long offered_ = 0;
+	long long delivered_ = 0;
+	long long conflated_ = 0;
+};
@@ -0,0 +1,732 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "GlueCLILib.h"
+#include "GlueFlat.h"
+
+/*
+ * C++20 coroutine front-end of glue_invoke and glue_invoke_all.
+ *
+ * Invocations chained through payload_function callbacks need a heap-allocated state per hop, passed
+ * as the COOKIE. Awaited invocations keep that state in the awaiting coroutine's frame instead - the
+ * awaitable itself is the cookie - so chains and fan-outs read as straight-line code:
+ *
+ *	glue::task<> refresh()
+ *	{
+ *		const auto quote = co_await glue::invoke("Pricing.Quote", args, len);
+ *		if (!quote.ok()) co_return;
+ *
+ *		glue::invocation_group positions(100);					// fan-out...
+ *		for (const auto& account : accounts)
+ *			positions.invoke("Positions.Get", account.args, account.len);
+ *		co_await positions;									// ...and fan-in
+ *		for (const auto& position : positions) { ... }
+ *	}
+ *
+ *	refresh().detach();
+ *
+ * Coroutines resume on the Glue thread by default. An executor makes them resume elsewhere - per
+ * awaitable or for the whole process (glue::set_default_executor), e.g. a glue::run_loop run by the
+ * UI thread.
+ *
+ * Results are copied into a single flat block each - they outlive the Glue callback.
+ * Awaitables must be awaited, and invocation groups must be awaited before they are destroyed.
+ * This header needs C++20 - the C++ console example builds with it, the MFC example does not.
+ */
+
+namespace glue
+{
+	/**
+	 * \brief Resumes coroutines - on a thread (or a message loop) of its own choosing.
+	 */
+	class executor
+	{
+	public:
+		virtual ~executor() = default;
+		virtual void execute(std::coroutine_handle<> continuation) = 0;
+	};
+
+	inline std::atomic<executor*>& default_executor_slot()
+	{
+		static std::atomic<executor*> slot{ nullptr };
+		return slot;
+	}
+
+	/**
+	 * \brief Sets the executor of awaitables made without one - nullptr resumes them on the Glue thread.
+	 */
+	inline void set_default_executor(executor* on)
+	{
+		default_executor_slot().store(on, std::memory_order_release);
+	}
+
+	inline executor* default_executor()
+	{
+		return default_executor_slot().load(std::memory_order_acquire);
+	}
+
+	inline void resume_on(executor* on, std::coroutine_handle<> continuation)
+	{
+		if (on != nullptr)
+		{
+			on->execute(continuation);
+		}
+		else
+		{
+			continuation.resume();
+		}
+	}
+
+	/**
+	 * \brief Resumes coroutines on the thread calling run - until stop is called.
+	 */
+	class run_loop : public executor
+	{
+	public:
+		void execute(std::coroutine_handle<> continuation) override
+		{
+			// notified under the lock - the resumed coroutine may stop the loop and its owner destroy it right away
+			std::lock_guard<std::mutex> lock(mutex_);
+			queue_.push_back(continuation);
+			wake_.notify_one();
+		}
+
+		void run()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (true)
+			{
+				wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+				if (queue_.empty())
+				{
+					stopping_ = false;
+					return;
+				}
+
+				const auto continuation = queue_.front();
+				queue_.pop_front();
+				lock.unlock();
+				continuation.resume();
+				lock.lock();
+			}
+		}
+
+		/**
+		 * \brief Makes run return once the coroutines already queued have been resumed.
+		 */
+		void stop()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+			wake_.notify_one();
+		}
+
+	private:
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		std::deque<std::coroutine_handle<>> queue_;
+		bool stopping_ = false;
+	};
+
+	/**
+	 * \brief The result of an invocation - its args copied into a single flat block, kept within the result
+	 * unless it is larger than inline_size.
+	 */
+	class result
+	{
+	public:
+		static constexpr size_t inline_size = 192;
+
+		result() = default;
+
+		/**
+		 * \param origin The origin passed to the callback - used if the payload has none.
+		 * A result whose args could not be allocated is a failure (status -1) without args.
+		 */
+		result(const char* origin, const glue_payload* payload)
+			: origin_(payload->origin != nullptr ? payload->origin : origin != nullptr ? origin : ""), status_(payload->status)
+		{
+			block_ = glue_flatten_unbound(nullptr, payload->args, payload->args_len,
+				[this](size_t size) { return size <= inline_size ? inline_ : static_cast<char*>(malloc(size)); });
+			if (block_ == nullptr)
+			{
+				status_ = -1;
+				return;
+			}
+			glue_flat_bind(block_);
+		}
+
+		/**
+		 * \brief The result of an invocation glue_invoke refused to make.
+		 */
+		static result failure()
+		{
+			result r;
+			r.status_ = -1;
+			return r;
+		}
+
+		result(result&& other) noexcept : origin_(std::move(other.origin_)), status_(other.status_)
+		{
+			take_block(other);
+		}
+
+		result& operator=(result&& other) noexcept
+		{
+			if (this != &other)
+			{
+				release_block();
+				origin_ = std::move(other.origin_);
+				status_ = other.status_;
+				take_block(other);
+			}
+			return *this;
+		}
+
+		result(const result&) = delete;
+		result& operator=(const result&) = delete;
+
+		~result()
+		{
+			release_block();
+		}
+
+		/**
+		 * \brief The status of the payload - 0 for results, non-zero for failures.
+		 */
+		int status() const
+		{
+			return status_;
+		}
+
+		bool ok() const
+		{
+			return status_ == 0;
+		}
+
+		const std::string& origin() const
+		{
+			return origin_;
+		}
+
+		const glue_arg* args(int& len) const
+		{
+			len = 0;
+			return block_ != nullptr ? glue_flat_args(block_, len) : nullptr;
+		}
+
+		/**
+		 * \brief A top-level arg by name - nullptr if there is none.
+		 */
+		const glue_value* find(const char* name) const
+		{
+			int len;
+			const auto all = args(len);
+			for (int i = 0; i < len; ++i)
+			{
+				if (all[i].name != nullptr && strcmp(all[i].name, name) == 0)
+				{
+					return &all[i].value;
+				}
+			}
+			return nullptr;
+		}
+
+		/**
+		 * \brief The result as a payload - valid as long as the result; its reader is nullptr.
+		 */
+		glue_payload payload() const
+		{
+			int len;
+			const auto all = args(len);
+			return glue_payload{ nullptr, origin_.c_str(), status_, all, len };
+		}
+
+	private:
+		void take_block(result& other) noexcept
+		{
+			if (other.block_ == other.inline_)
+			{
+				// a bound block copied elsewhere is bound again at its new address
+				memcpy(inline_, other.inline_, reinterpret_cast<const glue_flat_header*>(other.inline_)->size);
+				block_ = inline_;
+				glue_flat_bind(block_);
+			}
+			else
+			{
+				block_ = other.block_;
+			}
+			other.block_ = nullptr;
+		}
+
+		void release_block() noexcept
+		{
+			if (block_ != inline_)
+			{
+				glue_delete_flat(block_);
+			}
+			block_ = nullptr;
+		}
+
+		std::string origin_;
+		int status_ = -1;
+		char* block_ = nullptr;
+		alignas(glue_flat_header) alignas(glue_arg) char inline_[inline_size];
+	};
+
+	/**
+	 * \brief co_await glue::invoke(...) - invokes the best target of an endpoint, as glue_invoke.
+	 */
+	class invoke_awaitable
+	{
+	public:
+		invoke_awaitable(const char* endpoint_name, const glue_arg* args, int len, executor* on)
+			: endpoint_name_(endpoint_name), args_(args), len_(len), executor_(on)
+		{
+		}
+
+		invoke_awaitable(const invoke_awaitable&) = delete;
+		invoke_awaitable& operator=(const invoke_awaitable&) = delete;
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		bool await_suspend(std::coroutine_handle<> continuation)
+		{
+			continuation_ = continuation;
+			if (glue_invoke(endpoint_name_, args_, len_, &invoke_awaitable::complete, this) != 0)
+			{
+				result_ = result::failure();
+				return false;
+			}
+			// the result may be resuming the coroutine already - this is not to be touched
+			return true;
+		}
+
+		result await_resume()
+		{
+			return std::move(result_);
+		}
+
+	private:
+		static void complete(const char* origin, COOKIE cookie, const glue_payload* payload)
+		{
+			const auto self = static_cast<invoke_awaitable*>(const_cast<void*>(cookie));
+			self->result_ = result(origin, payload);
+			resume_on(self->executor_, self->continuation_);
+		}
+
+		const char* endpoint_name_;
+		const glue_arg* args_;
+		int len_;
+		executor* executor_;
+		std::coroutine_handle<> continuation_;
+		result result_;
+	};
+
+	/**
+	 * \brief co_await glue::invoke_all(...) - invokes all targets of an endpoint, as glue_invoke_all.
+	 */
+	class invoke_all_awaitable
+	{
+	public:
+		invoke_all_awaitable(const char* endpoint_name, const glue_arg* args, int len, executor* on)
+			: endpoint_name_(endpoint_name), args_(args), len_(len), executor_(on)
+		{
+		}
+
+		invoke_all_awaitable(const invoke_all_awaitable&) = delete;
+		invoke_all_awaitable& operator=(const invoke_all_awaitable&) = delete;
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		bool await_suspend(std::coroutine_handle<> continuation)
+		{
+			continuation_ = continuation;
+			return glue_invoke_all(endpoint_name_, args_, len_, &invoke_all_awaitable::complete, this) == 0;
+		}
+
+		/**
+		 * \return A result per target - none if glue_invoke_all refused the invocation.
+		 */
+		std::vector<result> await_resume()
+		{
+			return std::move(results_);
+		}
+
+	private:
+		static void complete(const char* origin, COOKIE cookie, const glue_payload* payloads, int len)
+		{
+			const auto self = static_cast<invoke_all_awaitable*>(const_cast<void*>(cookie));
+			self->results_.reserve(len > 0 ? len : 0);
+			for (int i = 0; i < len; ++i)
+			{
+				self->results_.emplace_back(origin, &payloads[i]);
+			}
+			resume_on(self->executor_, self->continuation_);
+		}
+
+		const char* endpoint_name_;
+		const glue_arg* args_;
+		int len_;
+		executor* executor_;
+		std::coroutine_handle<> continuation_;
+		std::vector<result> results_;
+	};
+
+	/**
+	 * \brief Invokes the best target of an endpoint - the args are copied by the time the awaiting coroutine suspends.
+	 */
+	inline invoke_awaitable invoke(const char* endpoint_name, const glue_arg* args = nullptr, int len = 0, executor* on = default_executor())
+	{
+		return invoke_awaitable(endpoint_name, args, len, on);
+	}
+
+	/**
+	 * \brief Invokes all targets of an endpoint.
+	 */
+	inline invoke_all_awaitable invoke_all(const char* endpoint_name, const glue_arg* args = nullptr, int len = 0, executor* on = default_executor())
+	{
+		return invoke_all_awaitable(endpoint_name, args, len, on);
+	}
+
+	/**
+	 * \brief Invocations started together and awaited together - fan-out and fan-in.
+	 * The results are stored in slots allocated once, with the group.
+	 */
+	class invocation_group
+	{
+	public:
+		explicit invocation_group(size_t capacity, executor* on = default_executor()) : slots_(capacity), executor_(on)
+		{
+			for (auto& s : slots_)
+			{
+				s.group = this;
+			}
+		}
+
+		invocation_group(const invocation_group&) = delete;
+		invocation_group& operator=(const invocation_group&) = delete;
+
+		/**
+		 * \brief Starts an invocation of the best target of an endpoint - its result is the next slot.
+		 * \return False if the group is full - or awaited already.
+		 */
+		bool invoke(const char* endpoint_name, const glue_arg* args = nullptr, int len = 0)
+		{
+			if (started_ == slots_.size() || continuation_)
+			{
+				return false;
+			}
+
+			auto& s = slots_[started_++];
+			remaining_.fetch_add(1, std::memory_order_relaxed);
+			if (glue_invoke(endpoint_name, args, len, &invocation_group::complete, &s) != 0)
+			{
+				s.value = result::failure();
+				remaining_.fetch_sub(1, std::memory_order_relaxed);
+			}
+			return true;
+		}
+
+		bool await_ready() const noexcept
+		{
+			return started_ == 0;
+		}
+
+		/**
+		 * \brief Suspends until every invocation started has completed.
+		 */
+		bool await_suspend(std::coroutine_handle<> continuation)
+		{
+			continuation_ = continuation;
+			// the group's own count - whoever drops the last one resumes
+			return remaining_.fetch_sub(1, std::memory_order_acq_rel) != 1;
+		}
+
+		void await_resume() const noexcept
+		{
+		}
+
+		size_t size() const
+		{
+			return started_;
+		}
+
+		result& operator[](size_t i)
+		{
+			return slots_[i].value;
+		}
+
+		const result& operator[](size_t i) const
+		{
+			return slots_[i].value;
+		}
+
+		auto begin() const
+		{
+			return const_results(slots_.begin());
+		}
+
+		auto end() const
+		{
+			return const_results(slots_.begin() + static_cast<std::ptrdiff_t>(started_));
+		}
+
+	private:
+		struct slot
+		{
+			invocation_group* group = nullptr;
+			result value;
+		};
+
+		/**
+		 * \brief Iterates the results of the slots.
+		 */
+		class const_results
+		{
+		public:
+			explicit const_results(std::vector<slot>::const_iterator it) : it_(it)
+			{
+			}
+
+			const result& operator*() const
+			{
+				return it_->value;
+			}
+
+			const_results& operator++()
+			{
+				++it_;
+				return *this;
+			}
+
+			bool operator!=(const const_results& other) const
+			{
+				return it_ != other.it_;
+			}
+
+		private:
+			std::vector<slot>::const_iterator it_;
+		};
+
+		static void complete(const char* origin, COOKIE cookie, const glue_payload* payload)
+		{
+			const auto s = static_cast<slot*>(const_cast<void*>(cookie));
+			s->value = result(origin, payload);
+			const auto group = s->group;
+			if (group->remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				resume_on(group->executor_, group->continuation_);
+			}
+		}
+
+		std::vector<slot> slots_;
+		size_t started_ = 0;
+		// started invocations still in flight, plus one until the group is awaited
+		std::atomic<size_t> remaining_{ 1 };
+		executor* executor_;
+		std::coroutine_handle<> continuation_;
+	};
+
+	/**
+	 * \brief A lazily started coroutine - awaited by another coroutine or detached.
+	 */
+	template <typename T = void>
+	class task;
+
+	namespace detail
+	{
+		struct task_promise_base
+		{
+			std::coroutine_handle<> continuation;
+			std::exception_ptr exception;
+			bool detached = false;
+
+			std::suspend_always initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			struct final_awaiter
+			{
+				bool await_ready() const noexcept
+				{
+					return false;
+				}
+
+				template <typename Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) noexcept
+				{
+					auto& promise = finished.promise();
+					if (promise.continuation)
+					{
+						return promise.continuation;
+					}
+					if (promise.detached)
+					{
+						if (promise.exception)
+						{
+							// nobody to rethrow it to
+							std::terminate();
+						}
+						finished.destroy();
+					}
+					return std::noop_coroutine();
+				}
+
+				void await_resume() const noexcept
+				{
+				}
+			};
+
+			final_awaiter final_suspend() noexcept
+			{
+				return {};
+			}
+
+			void unhandled_exception() noexcept
+			{
+				exception = std::current_exception();
+			}
+		};
+
+		template <typename T>
+		struct task_promise : task_promise_base
+		{
+			std::optional<T> value;
+
+			task<T> get_return_object() noexcept;
+
+			template <typename U>
+			void return_value(U&& v)
+			{
+				value.emplace(std::forward<U>(v));
+			}
+
+			T take()
+			{
+				if (exception)
+				{
+					std::rethrow_exception(exception);
+				}
+				return std::move(*value);
+			}
+		};
+
+		template <>
+		struct task_promise<void> : task_promise_base
+		{
+			task<void> get_return_object() noexcept;
+
+			void return_void() noexcept
+			{
+			}
+
+			void take()
+			{
+				if (exception)
+				{
+					std::rethrow_exception(exception);
+				}
+			}
+		};
+	}
+
+	template <typename T>
+	class task
+	{
+	public:
+		using promise_type = detail::task_promise<T>;
+
+		explicit task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle)
+		{
+		}
+
+		task(task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr))
+		{
+		}
+
+		task& operator=(task&& other) noexcept
+		{
+			if (this != &other)
+			{
+				if (handle_)
+				{
+					handle_.destroy();
+				}
+				handle_ = std::exchange(other.handle_, nullptr);
+			}
+			return *this;
+		}
+
+		task(const task&) = delete;
+		task& operator=(const task&) = delete;
+
+		~task()
+		{
+			if (handle_)
+			{
+				handle_.destroy();
+			}
+		}
+
+		/**
+		 * \brief Starts the coroutine - it destroys itself once it completes.
+		 */
+		void detach() &&
+		{
+			const auto handle = std::exchange(handle_, nullptr);
+			handle.promise().detached = true;
+			handle.resume();
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+		{
+			handle_.promise().continuation = continuation;
+			return handle_;
+		}
+
+		T await_resume()
+		{
+			return handle_.promise().take();
+		}
+
+	private:
+		std::coroutine_handle<promise_type> handle_;
+	};
+
+	namespace detail
+	{
+		template <typename T>
+		task<T> task_promise<T>::get_return_object() noexcept
+		{
+			return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+		}
+
+		inline task<void> task_promise<void>::get_return_object() noexcept
+		{
+			return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+		}
+	}
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "GlueCLILib.h"
+#include "GlueHash.h"
+
+/*
+ * Structural diff of Glue value trees.
+ *
+ * glue_diff compares two versions of a context and yields the changed fields as (field path, value)
+ * pairs; glue_apply_patch writes only those fields instead of rewriting the whole context:
+ *
+ *	std::vector<glue_change> patch;
+ *	glue_diff(previous, current, patch, "data");
+ *	glue_apply_patch(channel_name, patch);
+ *
+ * Composites are compared field by field. Arrays, tuples and composite arrays can not be addressed
+ * by field paths, so a change anywhere in them replaces them as a whole.
+ */
+
+/**
+ * \brief A single changed field.
+ * The value points into the new tree - keep the tree alive while the change is used.
+ * Fields removed in the new tree have a glue_none typed value.
+ */
+struct glue_change
+{
+	std::string path;
+	glue_value value;
+};
+
+/**
+ * \brief Finds a field by name - trying the field at the same position first, as versions of a context mostly keep their field order.
+ */
+inline const glue_arg* glue_diff_find(const glue_arg* args, int len, const char* name, int hint)
+{
+	if (hint < len && (args[hint].name == name || (args[hint].name != nullptr && strcmp(args[hint].name, name) == 0)))
+	{
+		return &args[hint];
+	}
+	for (int i = 0; i < len; ++i)
+	{
+		if (args[i].name != nullptr && strcmp(args[i].name, name) == 0)
+		{
+			return &args[i];
+		}
+	}
+	return nullptr;
+}
+
+inline void glue_diff(const glue_value& old_value, const glue_value& new_value, std::vector<glue_change>& changes, std::string& path);
+
+/**
+ * \brief Diffs two arrays of named values, appending the changes under the path.
+ */
+inline void glue_diff(const glue_arg* old_args, int old_len, const glue_arg* new_args, int new_len, std::vector<glue_change>& changes, std::string& path)
+{
+	const auto prefix = path.size();
+	for (int i = 0; i < new_len; ++i)
+	{
+		const auto name = new_args[i].name;
+		if (name == nullptr)
+		{
+			continue;
+		}
+
+		const auto& new_value = new_args[i].value;
+		const auto old_arg = glue_diff_find(old_args, old_len, name, i);
+		if (old_arg != nullptr && new_value.type != glue_type::glue_composite && glue_value_equal(old_arg->value, new_value))
+		{
+			// unchanged leaf - the common case, decided without building its path
+			continue;
+		}
+
+		if (prefix > 0)
+		{
+			path.push_back('.');
+		}
+		path.append(name);
+
+		if (old_arg == nullptr)
+		{
+			changes.push_back(glue_change{ path, new_value });
+		}
+		else
+		{
+			glue_diff(old_arg->value, new_value, changes, path);
+		}
+		path.resize(prefix);
+	}
+
+	for (int i = 0; i < old_len; ++i)
+	{
+		const auto name = old_args[i].name;
+		if (name == nullptr || glue_diff_find(new_args, new_len, name, i) != nullptr)
+		{
+			continue;
+		}
+
+		if (prefix > 0)
+		{
+			path.push_back('.');
+		}
+		path.append(name);
+		changes.push_back(glue_change{ path, glue_value{} });
+		path.resize(prefix);
+	}
+}
+
+/**
+ * \brief Diffs two Glue values, appending the changes under the path.
+ */
+inline void glue_diff(const glue_value& old_value, const glue_value& new_value, std::vector<glue_change>& changes, std::string& path)
+{
+	if (old_value.type == glue_type::glue_composite && new_value.type == glue_type::glue_composite && old_value.len >= 0 && new_value.len >= 0)
+	{
+		glue_diff(old_value.composite, old_value.len, new_value.composite, new_value.len, changes, path);
+		return;
+	}
+
+	if (!glue_value_equal(old_value, new_value))
+	{
+		changes.push_back(glue_change{ path, new_value });
+	}
+}
+
+/**
+ * \brief Computes the minimal set of field writes turning the old value into the new one.
+ * \param old_value The previously written value.
+ * \param new_value The value to be written - the changes point into it.
+ * \param changes Receives the changes - appended to.
+ * \param root_path The field path both values are written at - e.g. 'data'; nullptr or "" for the context root.
+ * \return The number of changes found.
+ */
+inline int glue_diff(const glue_value& old_value, const glue_value& new_value, std::vector<glue_change>& changes, const char* root_path = nullptr)
+{
+	const auto count = changes.size();
+	std::string path = root_path != nullptr ? root_path : "";
+	glue_diff(old_value, new_value, changes, path);
+	return static_cast<int>(changes.size() - count);
+}
+
+/**
+ * \brief Computes the changes between the args of two payloads.
+ */
+inline int glue_diff(const glue_payload* old_payload, const glue_payload* new_payload, std::vector<glue_change>& changes, const char* root_path = nullptr)
+{
+	const auto count = changes.size();
+	std::string path = root_path != nullptr ? root_path : "";
+	glue_diff(old_payload->args, old_payload->args_len, new_payload->args, new_payload->args_len, changes, path);
+	return static_cast<int>(changes.size() - count);
+}
+
+/**
+ * \brief Writes the changes to a Glue context - one glue_write_context per changed field.
+ * \param context The name of the Glue context.
+ * \param changes The changes computed via glue_diff.
+ * \return 0 if all changes were written, otherwise the result of the first failed write.
+ */
+inline int glue_apply_patch(const char* context, const std::vector<glue_change>& changes)
+{
+	for (const auto& change : changes)
+	{
+		const auto result = glue_write_context(context, change.path.c_str(), change.value);
+		if (result != 0)
+		{
+			return result;
+		}
+	}
+	return 0;
+}
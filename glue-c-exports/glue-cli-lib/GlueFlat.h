@@ -0,0 +1,424 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "GlueCLILib.h"
+
+/*
+ * Flat (single buffer) encoding of Glue value trees.
+ *
+ * glue_flatten copies a glue_value tree - with all its arrays, composites and strings - into one
+ * malloc'd block. While bound, the block holds genuine glue_values, so it can be read in place:
+ *
+ *	const auto flat = glue_flatten(payload);
+ *	queue.push(flat);										// one pointer, one block
+ *	...
+ *	int len;
+ *	const auto args = glue_flat_args(flat, len);			// zero-copy view
+ *	glue_delete_flat(flat);									// a single free
+ *
+ * All internal pointers are listed in a relocation table. glue_flat_unbind turns them into offsets,
+ * making the block position independent (to be written to a file, shared memory or a socket);
+ * glue_flat_bind turns them back into pointers at the block's current address.
+ * A bound block copied via memcpy can be re-bound at its new address as well.
+ * glue_flatten_unbound writes an unbound block straight into a buffer of the caller's (e.g. a shared memory slot).
+ * glue_flatten and glue_flat_copy return nullptr if the block can not be allocated - check before reading it.
+ */
+
+/**
+ * \brief Header at the start of every flat block.
+ */
+struct glue_flat_header
+{
+	uint32_t magic;
+	// total size of the block in bytes
+	uint32_t size;
+	// offset of the root - a glue_value, or an array of root_len glue_args for flattened args
+	uint32_t root;
+	int32_t root_len;
+	// offset and count of the relocation table - the offsets of all non-null pointers in the block
+	uint32_t relocations;
+	uint32_t relocation_count;
+	// address the pointers are bound to or 0 while the block is unbound
+	uint64_t base;
+};
+
+constexpr uint32_t glue_flat_magic = 0x4c464c47; // 'GLFL'
+
+/**
+ * \brief Lays out a value tree into a flat block - measures the block when base is nullptr.
+ */
+class glue_flat_writer
+{
+public:
+	explicit glue_flat_writer(char* base) : base_(base)
+	{
+	}
+
+	uint32_t allocate(size_t size, size_t align)
+	{
+		cursor_ = (cursor_ + align - 1) & ~(align - 1);
+		const auto at = cursor_;
+		cursor_ += size;
+		return static_cast<uint32_t>(at);
+	}
+
+	void value(const glue_value& v, uint32_t at)
+	{
+		if (base_ != nullptr)
+		{
+			memcpy(base_ + at, &v, sizeof(glue_value));
+		}
+
+		if (v.len < 0)
+		{
+			if (v.type == glue_type::glue_string)
+			{
+				pointer(at + offsetof(glue_value, s), string(v.s));
+			}
+			return;
+		}
+
+		const auto len = static_cast<size_t>(v.len);
+		uint32_t items = 0;
+		switch (v.type)
+		{
+		case glue_type::glue_bool:
+			items = block(v.bb, len);
+			break;
+		case glue_type::glue_int:
+			items = block(v.ii, len);
+			break;
+		case glue_type::glue_long:
+		case glue_type::glue_datetime:
+			items = block(v.ll, len);
+			break;
+		case glue_type::glue_double:
+			items = block(v.dd, len);
+			break;
+		case glue_type::glue_string:
+			items = allocate(len * sizeof(const char*), alignof(const char*));
+			for (size_t i = 0; i < len; ++i)
+			{
+				pointer(items + i * sizeof(const char*), string(v.ss[i]));
+			}
+			break;
+		case glue_type::glue_tuple:
+			items = allocate(len * sizeof(glue_value), alignof(glue_value));
+			for (size_t i = 0; i < len; ++i)
+			{
+				value(v.tuple[i], static_cast<uint32_t>(items + i * sizeof(glue_value)));
+			}
+			break;
+		case glue_type::glue_composite:
+		case glue_type::glue_composite_array:
+			items = allocate(len * sizeof(glue_arg), alignof(glue_arg));
+			args(v.composite, v.len, items);
+			break;
+		default:
+			break;
+		}
+		pointer(at + offsetof(glue_value, composite), len > 0 ? items : 0);
+	}
+
+	void args(const glue_arg* args, int len, uint32_t at)
+	{
+		for (int i = 0; i < len; ++i)
+		{
+			const auto arg = at + i * sizeof(glue_arg);
+			value(args[i].value, static_cast<uint32_t>(arg + offsetof(glue_arg, value)));
+			pointer(arg + offsetof(glue_arg, name), string(args[i].name));
+		}
+	}
+
+	/**
+	 * \brief Stores an offset into a pointer slot and records its relocation.
+	 */
+	void pointer(size_t at, uint32_t target)
+	{
+		if (base_ != nullptr)
+		{
+			const uintptr_t offset = target;
+			memcpy(base_ + at, &offset, sizeof(offset));
+			if (target != 0)
+			{
+				relocation_table_[relocation_count_] = static_cast<uint32_t>(at);
+			}
+		}
+		relocation_count_ += target != 0 ? 1 : 0;
+	}
+
+	/**
+	 * \brief Places the relocation table - measured blocks know the count up front.
+	 */
+	void relocations(uint32_t* table)
+	{
+		relocation_table_ = table;
+		relocation_count_ = 0;
+	}
+
+	size_t size() const
+	{
+		return cursor_;
+	}
+
+	uint32_t relocation_count() const
+	{
+		return relocation_count_;
+	}
+
+private:
+	template <typename T>
+	uint32_t block(const T* items, size_t len)
+	{
+		const auto at = allocate(len * sizeof(T), alignof(T));
+		if (base_ != nullptr && len > 0)
+		{
+			memcpy(base_ + at, items, len * sizeof(T));
+		}
+		return at;
+	}
+
+	uint32_t string(const char* s)
+	{
+		if (s == nullptr)
+		{
+			return 0;
+		}
+
+		// field names repeat in every row of composite arrays - a small direct mapped cache of recent
+		// pointers stores them once; it is deterministic, so measuring and writing lay out the same
+		auto& cached = strings_[(reinterpret_cast<uintptr_t>(s) >> 3) % string_cache_size];
+		if (cached.s == s)
+		{
+			return cached.at;
+		}
+
+		const auto len = strlen(s) + 1;
+		const auto at = allocate(len, 1);
+		if (base_ != nullptr)
+		{
+			memcpy(base_ + at, s, len);
+		}
+		cached = string_entry{ s, at };
+		return at;
+	}
+
+	char* base_;
+	size_t cursor_ = sizeof(glue_flat_header);
+	uint32_t* relocation_table_ = nullptr;
+	uint32_t relocation_count_ = 0;
+	struct string_entry
+	{
+		const char* s;
+		uint32_t at;
+	};
+
+	static constexpr size_t string_cache_size = 61;
+	string_entry strings_[string_cache_size] = {};
+};
+
+/**
+ * \brief Moves all pointers of a block by the difference between two bases (0 for offsets).
+ */
+inline void glue_flat_relocate(char* flat, uintptr_t from, uintptr_t to)
+{
+	const auto header = reinterpret_cast<glue_flat_header*>(flat);
+	const auto table = reinterpret_cast<const uint32_t*>(flat + header->relocations);
+	for (uint32_t r = 0; r < header->relocation_count; ++r)
+	{
+		uintptr_t p;
+		memcpy(&p, flat + table[r], sizeof(p));
+		p = p - from + to;
+		memcpy(flat + table[r], &p, sizeof(p));
+	}
+	header->base = to;
+}
+
+/**
+ * \brief Binds a block's pointers to its current address - whether it is unbound or was bound at another address.
+ * \return false if the block is not a flat Glue block.
+ */
+inline bool glue_flat_bind(void* flat)
+{
+	const auto header = static_cast<glue_flat_header*>(flat);
+	if (header->magic != glue_flat_magic)
+	{
+		return false;
+	}
+
+	const auto address = reinterpret_cast<uintptr_t>(flat);
+	if (header->base != address)
+	{
+		glue_flat_relocate(static_cast<char*>(flat), static_cast<uintptr_t>(header->base), address);
+	}
+	return true;
+}
+
+/**
+ * \brief Turns a block's pointers into offsets - the block can then be moved, stored or sent as is.
+ * Unbound blocks can not be read until bound again.
+ */
+inline void glue_flat_unbind(void* flat)
+{
+	const auto header = static_cast<glue_flat_header*>(flat);
+	if (header->base != 0)
+	{
+		glue_flat_relocate(static_cast<char*>(flat), static_cast<uintptr_t>(header->base), 0);
+	}
+}
+
+/**
+ * \brief Lays out either a single value or an array of args as an unbound block - measures the block first,
+ * then writes it to the buffer returned by allocate(size), unless that is nullptr.
+ * \return The buffer or nullptr - also for blocks over 4GB, which are never allocated.
+ */
+template <typename Allocate>
+char* glue_flatten_unbound(const glue_value* value, const glue_arg* args, int len, Allocate&& allocate)
+{
+	glue_flat_writer measure(nullptr);
+	const auto root = measure.allocate(value != nullptr ? sizeof(glue_value) : len * sizeof(glue_arg), alignof(glue_arg));
+	if (value != nullptr)
+	{
+		measure.value(*value, root);
+	}
+	else
+	{
+		measure.args(args, len, root);
+	}
+	const auto relocations = measure.allocate(measure.relocation_count() * sizeof(uint32_t), alignof(uint32_t));
+	// the header and the relocations hold 32 bit offsets
+	if (measure.size() > UINT32_MAX)
+	{
+		return nullptr;
+	}
+
+	const auto flat = static_cast<char*>(allocate(measure.size()));
+	if (flat == nullptr)
+	{
+		return nullptr;
+	}
+
+	glue_flat_writer writer(flat);
+	writer.allocate(value != nullptr ? sizeof(glue_value) : len * sizeof(glue_arg), alignof(glue_arg));
+	writer.relocations(reinterpret_cast<uint32_t*>(flat + relocations));
+	if (value != nullptr)
+	{
+		writer.value(*value, root);
+	}
+	else
+	{
+		writer.args(args, len, root);
+	}
+
+	const auto header = reinterpret_cast<glue_flat_header*>(flat);
+	header->magic = glue_flat_magic;
+	header->size = static_cast<uint32_t>(measure.size());
+	header->root = root;
+	header->root_len = value != nullptr ? -1 : len;
+	header->relocations = relocations;
+	header->relocation_count = measure.relocation_count();
+	header->base = 0;
+	return flat;
+}
+
+/**
+ * \brief Flattens either a single value or an array of args into a single allocation.
+ * \return The bound block or nullptr if it could not be allocated.
+ */
+inline void* glue_flatten_root(const glue_value* value, const glue_arg* args, int len)
+{
+	const auto flat = glue_flatten_unbound(value, args, len, [](size_t size) { return malloc(size); });
+	if (flat != nullptr)
+	{
+		glue_flat_bind(flat);
+	}
+	return flat;
+}
+
+/**
+ * \brief Deep copies a Glue value into a single bound block.
+ * \return The block - release it via glue_delete_flat - or nullptr if it could not be allocated; check before
+ * reading it. Blocks are limited to 4GB - larger trees give nullptr as well.
+ */
+inline void* glue_flatten(const glue_value& v)
+{
+	return glue_flatten_root(&v, nullptr, 0);
+}
+
+/**
+ * \brief Deep copies an array of named Glue values into a single bound block.
+ */
+inline void* glue_flatten(const glue_arg* args, int len)
+{
+	return glue_flatten_root(nullptr, args, len);
+}
+
+/**
+ * \brief Deep copies a payload's args into a single bound block.
+ */
+inline void* glue_flatten(const glue_payload* payload)
+{
+	return glue_flatten_root(nullptr, payload->args, payload->args_len);
+}
+
+/**
+ * \brief Gets the size of a flat block in bytes.
+ */
+inline size_t glue_flat_size(const void* flat)
+{
+	return static_cast<const glue_flat_header*>(flat)->size;
+}
+
+/**
+ * \brief Copies a flat block and binds the copy.
+ * \return The copy or nullptr if it could not be allocated.
+ */
+inline void* glue_flat_copy(const void* flat)
+{
+	const auto size = glue_flat_size(flat);
+	const auto copy = malloc(size);
+	if (copy == nullptr)
+	{
+		return nullptr;
+	}
+	memcpy(copy, flat, size);
+	glue_flat_bind(copy);
+	return copy;
+}
+
+/**
+ * \brief Gets the root value of a bound block created by glue_flatten(const glue_value&).
+ * For blocks of flattened args - a composite value of the args.
+ */
+inline glue_value glue_flat_value(const void* flat)
+{
+	const auto header = static_cast<const glue_flat_header*>(flat);
+	const auto root = static_cast<const char*>(flat) + header->root;
+	if (header->root_len >= 0)
+	{
+		return glv_comp(reinterpret_cast<glue_arg*>(const_cast<char*>(root)), header->root_len);
+	}
+	return *reinterpret_cast<const glue_value*>(root);
+}
+
+/**
+ * \brief Gets the args of a bound block created from args or a payload.
+ * \param len Receives the number of args - 0 for blocks of a single value.
+ */
+inline const glue_arg* glue_flat_args(const void* flat, int& len)
+{
+	const auto header = static_cast<const glue_flat_header*>(flat);
+	len = header->root_len >= 0 ? header->root_len : 0;
+	return reinterpret_cast<const glue_arg*>(static_cast<const char*>(flat) + header->root);
+}
+
+/**
+ * \brief Releases a flat block - a single free, regardless of the tree's shape.
+ */
+inline void glue_delete_flat(const void* flat)
+{
+	free(const_cast<void*>(flat));
+}
@@ -0,0 +1,350 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLUE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "GlueCLILib.h"
+
+/*
+ * Deep hash and equality of Glue values - for deduplicating payloads and using them as cache keys.
+ *
+ *	std::unordered_map<glue_value, int, glue_value_hasher, glue_value_equal_to> seen;
+ *
+ * Numbers are compared by their bits, so that equal values always hash equally: NaN equals NaN
+ * and 0.0 differs from -0.0. Bool, int, long and double arrays are hashed and compared as whole
+ * blocks. With unordered_fields, composites with the same fields in a different order are equal
+ * (field names are expected to be unique within a composite).
+ */
+
+/**
+ * \brief Final avalanche of a 64 bit hash.
+ */
+inline uint64_t glue_hash_mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+inline uint64_t glue_hash_combine(uint64_t h, uint64_t v)
+{
+	return glue_hash_mix(h ^ (v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2)));
+}
+
+/**
+ * \brief Hashes a block of bytes.
+ * Two 64 bit lanes accumulate (lo32(x) * hi32(x)) + data for x = data ^ key - the same in the SSE2 and the scalar version.
+ */
+inline uint64_t glue_hash_bytes(const void* data, size_t len, uint64_t seed)
+{
+	const auto p = static_cast<const unsigned char*>(data);
+	const uint64_t k0 = 0xbe4ba423396cfeb8ull ^ seed;
+	const uint64_t k1 = 0x1cad21f72c81017cull + seed;
+	uint64_t acc[2] = { 0x9e3779b97f4a7c15ull ^ len, 0xc2b2ae3d27d4eb4full };
+
+	size_t i = 0;
+#ifdef GLUE_SSE2
+	auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc));
+	const auto key = _mm_set_epi64x(static_cast<long long>(k1), static_cast<long long>(k0));
+	for (; i + 16 <= len; i += 16)
+	{
+		const auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		const auto x = _mm_xor_si128(d, key);
+		a = _mm_add_epi64(a, _mm_add_epi64(_mm_mul_epu32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 1, 1))), d));
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(acc), a);
+#else
+	for (; i + 16 <= len; i += 16)
+	{
+		uint64_t d[2];
+		memcpy(d, p + i, sizeof(d));
+		const uint64_t x0 = d[0] ^ k0;
+		const uint64_t x1 = d[1] ^ k1;
+		acc[0] += (x0 & 0xffffffffu) * (x0 >> 32) + d[0];
+		acc[1] += (x1 & 0xffffffffu) * (x1 >> 32) + d[1];
+	}
+#endif
+
+	uint64_t tail[2] = { 0, 0 };
+	memcpy(tail, p + i, len - i);
+	return glue_hash_combine(glue_hash_mix(acc[0] ^ tail[0] * k1), glue_hash_mix(acc[1] ^ tail[1] * k0));
+}
+
+/**
+ * \brief Compares two blocks of bytes.
+ */
+inline bool glue_blocks_equal(const void* a, const void* b, size_t len)
+{
+	if (a == b || len == 0)
+	{
+		return true;
+	}
+
+	const auto pa = static_cast<const unsigned char*>(a);
+	const auto pb = static_cast<const unsigned char*>(b);
+	size_t i = 0;
+#ifdef GLUE_SSE2
+	for (; i + 32 <= len; i += 32)
+	{
+		const auto e0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pa + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + i)));
+		const auto e1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pa + i + 16)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + i + 16)));
+		if (_mm_movemask_epi8(_mm_and_si128(e0, e1)) != 0xffff)
+		{
+			return false;
+		}
+	}
+#endif
+	return memcmp(pa + i, pb + i, len - i) == 0;
+}
+
+inline uint64_t glue_string_hash(const char* s)
+{
+	return s != nullptr ? glue_hash_bytes(s, strlen(s), 0x5) : 0x9ae16a3b2f90404full;
+}
+
+inline bool glue_strings_equal(const char* a, const char* b)
+{
+	return a == b || (a != nullptr && b != nullptr && strcmp(a, b) == 0);
+}
+
+inline uint64_t glue_args_hash(const glue_arg* args, int len, bool unordered_fields = false);
+
+/**
+ * \brief Deep hashes a Glue value.
+ * \param v The value.
+ * \param unordered_fields Hash composites independently of their field order.
+ */
+inline uint64_t glue_value_hash(const glue_value& v, bool unordered_fields = false)
+{
+	auto h = glue_hash_mix(static_cast<uint64_t>(v.type) << 32 ^ static_cast<uint32_t>(v.len));
+	if (v.len < 0)
+	{
+		switch (v.type)
+		{
+		case glue_type::glue_bool:
+			return glue_hash_combine(h, v.b ? 1 : 0);
+		case glue_type::glue_int:
+			return glue_hash_combine(h, static_cast<uint32_t>(v.i));
+		case glue_type::glue_long:
+		case glue_type::glue_datetime:
+			return glue_hash_combine(h, static_cast<uint64_t>(v.l));
+		case glue_type::glue_double:
+		{
+			uint64_t bits;
+			memcpy(&bits, &v.d, sizeof(bits));
+			return glue_hash_combine(h, bits);
+		}
+		case glue_type::glue_string:
+			return glue_hash_combine(h, glue_string_hash(v.s));
+		default:
+			return h;
+		}
+	}
+
+	const auto len = static_cast<size_t>(v.len);
+	switch (v.type)
+	{
+	case glue_type::glue_bool:
+		return len > 0 ? glue_hash_bytes(v.bb, len * sizeof(bool), h) : h;
+	case glue_type::glue_int:
+		return len > 0 ? glue_hash_bytes(v.ii, len * sizeof(int), h) : h;
+	case glue_type::glue_long:
+	case glue_type::glue_datetime:
+		return len > 0 ? glue_hash_bytes(v.ll, len * sizeof(long long), h) : h;
+	case glue_type::glue_double:
+		return len > 0 ? glue_hash_bytes(v.dd, len * sizeof(double), h) : h;
+	case glue_type::glue_string:
+		for (size_t i = 0; i < len; ++i)
+		{
+			h = glue_hash_combine(h, glue_string_hash(v.ss[i]));
+		}
+		return h;
+	case glue_type::glue_tuple:
+		for (size_t i = 0; i < len; ++i)
+		{
+			h = glue_hash_combine(h, glue_value_hash(v.tuple[i], unordered_fields));
+		}
+		return h;
+	case glue_type::glue_composite:
+		return glue_hash_combine(h, glue_args_hash(v.composite, v.len, unordered_fields));
+	case glue_type::glue_composite_array:
+		// rows keep their order - only the fields within the rows may be unordered
+		for (size_t i = 0; i < len; ++i)
+		{
+			h = glue_hash_combine(h, glue_hash_combine(glue_string_hash(v.composite[i].name), glue_value_hash(v.composite[i].value, unordered_fields)));
+		}
+		return h;
+	default:
+		return h;
+	}
+}
+
+/**
+ * \brief Deep hashes an array of named Glue values (e.g. payload args).
+ */
+inline uint64_t glue_args_hash(const glue_arg* args, int len, bool unordered_fields)
+{
+	uint64_t h = glue_hash_mix(static_cast<uint64_t>(len));
+	for (int i = 0; i < len; ++i)
+	{
+		const auto field = glue_hash_combine(glue_string_hash(args[i].name), glue_value_hash(args[i].value, unordered_fields));
+		// a sum of the fields' hashes does not depend on their order
+		h = unordered_fields ? h + glue_hash_mix(field) : glue_hash_combine(h, field);
+	}
+	return h;
+}
+
+inline bool glue_args_equal(const glue_arg* a, int a_len, const glue_arg* b, int b_len, bool unordered_fields = false);
+
+/**
+ * \brief Deep compares two Glue values.
+ * \param unordered_fields Compare composites independently of their field order.
+ */
+inline bool glue_value_equal(const glue_value& a, const glue_value& b, bool unordered_fields = false)
+{
+	if (a.type != b.type || a.len != b.len)
+	{
+		return false;
+	}
+
+	if (a.len < 0)
+	{
+		switch (a.type)
+		{
+		case glue_type::glue_bool:
+			return a.b == b.b;
+		case glue_type::glue_int:
+			return a.i == b.i;
+		case glue_type::glue_long:
+		case glue_type::glue_datetime:
+			return a.l == b.l;
+		case glue_type::glue_double:
+			return memcmp(&a.d, &b.d, sizeof(double)) == 0;
+		case glue_type::glue_string:
+			return glue_strings_equal(a.s, b.s);
+		default:
+			return true;
+		}
+	}
+
+	const auto len = static_cast<size_t>(a.len);
+	switch (a.type)
+	{
+	case glue_type::glue_bool:
+		return glue_blocks_equal(a.bb, b.bb, len * sizeof(bool));
+	case glue_type::glue_int:
+		return glue_blocks_equal(a.ii, b.ii, len * sizeof(int));
+	case glue_type::glue_long:
+	case glue_type::glue_datetime:
+		return glue_blocks_equal(a.ll, b.ll, len * sizeof(long long));
+	case glue_type::glue_double:
+		return glue_blocks_equal(a.dd, b.dd, len * sizeof(double));
+	case glue_type::glue_string:
+		for (size_t i = 0; i < len; ++i)
+		{
+			if (!glue_strings_equal(a.ss[i], b.ss[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	case glue_type::glue_tuple:
+		for (size_t i = 0; i < len; ++i)
+		{
+			if (!glue_value_equal(a.tuple[i], b.tuple[i], unordered_fields))
+			{
+				return false;
+			}
+		}
+		return true;
+	case glue_type::glue_composite:
+		return glue_args_equal(a.composite, a.len, b.composite, b.len, unordered_fields);
+	case glue_type::glue_composite_array:
+		for (size_t i = 0; i < len; ++i)
+		{
+			if (!glue_strings_equal(a.composite[i].name, b.composite[i].name) || !glue_value_equal(a.composite[i].value, b.composite[i].value, unordered_fields))
+			{
+				return false;
+			}
+		}
+		return true;
+	default:
+		return true;
+	}
+}
+
+/**
+ * \brief Deep compares two arrays of named Glue values (e.g. payload args).
+ */
+inline bool glue_args_equal(const glue_arg* a, int a_len, const glue_arg* b, int b_len, bool unordered_fields)
+{
+	if (a_len != b_len)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < a_len; ++i)
+	{
+		const glue_arg* match = &b[i];
+		if (!glue_strings_equal(a[i].name, match->name))
+		{
+			if (!unordered_fields)
+			{
+				return false;
+			}
+
+			match = nullptr;
+			for (int j = 0; j < b_len; ++j)
+			{
+				if (glue_strings_equal(a[i].name, b[j].name))
+				{
+					match = &b[j];
+					break;
+				}
+			}
+			if (match == nullptr)
+			{
+				return false;
+			}
+		}
+
+		if (!glue_value_equal(a[i].value, match->value, unordered_fields))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * \brief Hash functor for unordered containers keyed by Glue values.
+ */
+struct glue_value_hasher
+{
+	bool unordered_fields = false;
+
+	size_t operator()(const glue_value& v) const
+	{
+		return static_cast<size_t>(glue_value_hash(v, unordered_fields));
+	}
+};
+
+/**
+ * \brief Equality functor for unordered containers keyed by Glue values.
+ */
+struct glue_value_equal_to
+{
+	bool unordered_fields = false;
+
+	bool operator()(const glue_value& a, const glue_value& b) const
+	{
+		return glue_value_equal(a, b, unordered_fields);
+	}
+};
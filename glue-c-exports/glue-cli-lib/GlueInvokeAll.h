@@ -0,0 +1,424 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "GlueCLILib.h"
+#ifdef GLUE_LOOPBACK
+#include "loopback/GlueLoopbackInvoke.h"
+#endif
+
+/*
+ * Streaming results of invocations of all targets of a method.
+ *
+ * glue_invoke_all delivers the results of all targets at once, after the last of them responded - a
+ * single slow target holds up the results of all the others. glue_invoke_all_partial delivers every
+ * result as it arrives, then a summary, and can stop waiting early - after a quorum of successful
+ * results, after the first N results of any status, or at a timeout:
+ *
+ *	glue_invoke_all_options options;
+ *	options.quorum = 2;											// two successful quotes are enough
+ *	options.timeout = std::chrono::milliseconds(500);
+ *	glue_invoke_all_partial("Pricing.Quote", args, len, &on_quote, &on_quotes_done, cookie, options);
+ *
+ *	void on_quotes_done(const char* endpoint_name, COOKIE cookie, const glue_invoke_all_summary* summary)
+ *	{
+ *		if (summary->outcome == glue_invoke_all_outcome::timed_out) { ... summary->pending targets did not respond }
+ *	}
+ *
+ * Results pushed via glue_push_failure (status != 0) count as failures. Results arriving once the
+ * summary has been delivered are discarded - the targets are not told to stop.
+ *
+ * Results are streamed by the loopback backend (glue_invoke_each). GlueCLILib.dll only delivers all
+ * results at once, so there they are passed on one by one once all have arrived - the quorum still
+ * cuts the delivery short, and the timeout still bounds the wait.
+ *
+ * Callbacks are called one at a time - results on the Glue thread, summaries on the Glue thread, on
+ * the thread timing out, or on the calling thread for methods without targets. The state of an
+ * invocation is released once every target responded, so targets never responding keep it alive.
+ * The header is C++14.
+ */
+
+enum class glue_invoke_all_outcome
+{
+	// every target responded
+	answered,
+	// options.quorum successful results or options.first_n results arrived
+	cutoff,
+	// options.quorum successful results can no longer arrive - too many targets failed
+	no_quorum,
+	// options.timeout passed first
+	timed_out,
+};
+
+struct glue_invoke_all_options
+{
+	// successful results to wait for - 0 for no quorum
+	int quorum = 0;
+	// results of any status to wait for - 0 for all
+	int first_n = 0;
+	// 0 - no timeout
+	std::chrono::milliseconds timeout{ 0 };
+};
+
+/**
+ * \brief How an invocation of all targets finished.
+ */
+struct glue_invoke_all_summary
+{
+	glue_invoke_all_outcome outcome;
+	// targets invoked - -1 if not known (a timeout before GlueCLILib.dll delivered the results)
+	int targets;
+	// results delivered
+	int results;
+	int succeeded;
+	int failed;
+	// targets which had not responded - -1 if not known
+	int pending;
+	long long elapsed_us;
+};
+
+/**
+ * \brief Callback to be called once an invocation of all targets finished.
+ */
+typedef void (*glue_invoke_all_done_function)(const char* endpoint_name, COOKIE, const glue_invoke_all_summary* summary);
+
+/**
+ * \brief Calls functions at deadlines - on a thread of its own, started with the first deadline.
+ */
+class glue_deadline_timer
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using token = std::pair<clock::time_point, long long>;
+
+	static glue_deadline_timer& instance()
+	{
+		static glue_deadline_timer timer;
+		return timer;
+	}
+
+	glue_deadline_timer(const glue_deadline_timer&) = delete;
+	glue_deadline_timer& operator=(const glue_deadline_timer&) = delete;
+
+	~glue_deadline_timer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		wake_.notify_one();
+		if (thread_.joinable())
+		{
+			thread_.join();
+		}
+	}
+
+	token schedule(clock::time_point deadline, std::function<void()> callback)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!thread_.joinable())
+		{
+			thread_ = std::thread([this] { run(); });
+		}
+
+		const token t{ deadline, ++next_id_ };
+		const auto first = timers_.empty() || deadline < timers_.begin()->first.first;
+		timers_.emplace(t, std::move(callback));
+		if (first)
+		{
+			wake_.notify_one();
+		}
+		return t;
+	}
+
+	/**
+	 * \brief Cancels a function - it may already be running.
+	 */
+	void cancel(const token& t)
+	{
+		std::function<void()> cancelled;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			const auto it = timers_.find(t);
+			if (it == timers_.end())
+			{
+				return;
+			}
+			cancelled = std::move(it->second);
+			timers_.erase(it);
+		}
+		// released without the lock - it may hold the last reference to its owner
+	}
+
+private:
+	glue_deadline_timer() = default;
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!stopping_)
+		{
+			if (timers_.empty())
+			{
+				wake_.wait(lock);
+				continue;
+			}
+
+			const auto first = timers_.begin();
+			if (clock::now() < first->first.first)
+			{
+				wake_.wait_until(lock, first->first.first);
+				continue;
+			}
+
+			auto callback = std::move(first->second);
+			timers_.erase(first);
+			lock.unlock();
+			callback();
+			callback = nullptr;
+			lock.lock();
+		}
+	}
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	bool stopping_ = false;
+	std::map<token, std::function<void()>> timers_;
+	long long next_id_ = 0;
+	std::thread thread_;
+};
+
+/**
+ * \brief The state of a glue_invoke_all_partial - alive while results are to come.
+ */
+class glue_invoke_all_state
+{
+public:
+	glue_invoke_all_state(const char* endpoint_name, payload_function on_result, glue_invoke_all_done_function on_done, COOKIE cookie, const glue_invoke_all_options& options)
+		: name_(endpoint_name), on_result_(on_result), on_done_(on_done), cookie_(cookie), options_(options), start_(glue_deadline_timer::clock::now())
+	{
+	}
+
+	static int invoke(const char* endpoint_name, const glue_arg* args, int len, payload_function on_result, glue_invoke_all_done_function on_done, COOKIE cookie, const glue_invoke_all_options& options)
+	{
+		if (endpoint_name == nullptr)
+		{
+			return -1;
+		}
+
+		const auto state = std::make_shared<glue_invoke_all_state>(endpoint_name, on_result, on_done, cookie, options);
+		state->self_ = state;
+		if (options.timeout.count() > 0)
+		{
+			std::lock_guard<std::mutex> lock(state->mutex_);
+			state->timer_ = glue_deadline_timer::instance().schedule(state->start_ + options.timeout, [state] { state->expire(); });
+			state->timed_ = true;
+		}
+
+#ifdef GLUE_LOOPBACK
+		const auto targets = glue_invoke_each(endpoint_name, args, len, &glue_invoke_all_state::receive, state.get());
+		const auto started = targets >= 0;
+		if (started)
+		{
+			state->expect(targets);
+		}
+#else
+		const auto started = glue_invoke_all(endpoint_name, args, len, &glue_invoke_all_state::receive_all, state.get()) == 0;
+#endif
+		if (!started)
+		{
+			state->abandon();
+			return -1;
+		}
+		return 0;
+	}
+
+private:
+	static void receive(const char*, COOKIE cookie, const glue_payload* payload)
+	{
+		static_cast<glue_invoke_all_state*>(const_cast<void*>(cookie))->result(payload);
+	}
+
+	static void receive_all(const char*, COOKIE cookie, const glue_payload* payloads, int len)
+	{
+		const auto state = static_cast<glue_invoke_all_state*>(const_cast<void*>(cookie));
+		// the last use might release the state
+		const auto keep = state->self_;
+		state->expect(len);
+		for (int i = 0; i < len; ++i)
+		{
+			state->result(&payloads[i]);
+		}
+	}
+
+	void expect(int targets)
+	{
+		std::shared_ptr<glue_invoke_all_state> released;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			targets_ = targets;
+			check();
+			released = release();
+		}
+		cancel_timer();
+	}
+
+	void result(const glue_payload* payload)
+	{
+		std::shared_ptr<glue_invoke_all_state> released;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			++responded_;
+			if (!done_)
+			{
+				++results_;
+				if (payload->status == 0)
+				{
+					++succeeded_;
+				}
+				else
+				{
+					++failed_;
+				}
+				if (on_result_ != nullptr)
+				{
+					on_result_(name_.c_str(), cookie_, payload);
+				}
+				check();
+			}
+			released = release();
+		}
+		cancel_timer();
+	}
+
+	void expire()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		timed_ = false;
+		if (!done_)
+		{
+			finish(glue_invoke_all_outcome::timed_out);
+		}
+	}
+
+	/**
+	 * \brief Releases the state of an invocation which failed to start.
+	 */
+	void abandon()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			done_ = true;
+			self_ = nullptr;
+		}
+		cancel_timer();
+	}
+
+	/**
+	 * \brief Finishes once the options say so - call with the mutex locked.
+	 */
+	void check()
+	{
+		if (done_)
+		{
+			return;
+		}
+
+		if ((options_.quorum > 0 && succeeded_ >= options_.quorum) || (options_.first_n > 0 && results_ >= options_.first_n))
+		{
+			finish(glue_invoke_all_outcome::cutoff);
+		}
+		else if (options_.quorum > 0 && targets_ >= 0 && succeeded_ + (targets_ - results_) < options_.quorum)
+		{
+			finish(glue_invoke_all_outcome::no_quorum);
+		}
+		else if (targets_ >= 0 && results_ >= targets_)
+		{
+			finish(glue_invoke_all_outcome::answered);
+		}
+	}
+
+	/**
+	 * \brief Delivers the summary - call with the mutex locked.
+	 */
+	void finish(glue_invoke_all_outcome outcome)
+	{
+		done_ = true;
+		if (on_done_ == nullptr)
+		{
+			return;
+		}
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(glue_deadline_timer::clock::now() - start_);
+		const glue_invoke_all_summary summary{ outcome, targets_, results_, succeeded_, failed_, targets_ >= 0 ? targets_ - results_ : -1, elapsed.count() };
+		on_done_(name_.c_str(), cookie_, &summary);
+	}
+
+	/**
+	 * \brief Takes the self reference once every target responded - call with the mutex locked.
+	 */
+	std::shared_ptr<glue_invoke_all_state> release()
+	{
+		return targets_ >= 0 && responded_ >= targets_ ? std::move(self_) : nullptr;
+	}
+
+	/**
+	 * \brief Cancels the timeout of a finished invocation - the pending timeout holds a reference.
+	 */
+	void cancel_timer()
+	{
+		glue_deadline_timer::token timer;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!done_ || !timed_)
+			{
+				return;
+			}
+			timer = timer_;
+			timed_ = false;
+		}
+		glue_deadline_timer::instance().cancel(timer);
+	}
+
+	const std::string name_;
+	const payload_function on_result_;
+	const glue_invoke_all_done_function on_done_;
+	const COOKIE cookie_;
+	const glue_invoke_all_options options_;
+	const glue_deadline_timer::clock::time_point start_;
+
+	// guarded by the mutex
+	std::mutex mutex_;
+	glue_deadline_timer::token timer_{};
+	std::shared_ptr<glue_invoke_all_state> self_;
+	bool timed_ = false;
+	bool done_ = false;
+	int targets_ = -1;
+	int responded_ = 0;
+	int results_ = 0;
+	int succeeded_ = 0;
+	int failed_ = 0;
+};
+
+/**
+ * \brief Invokes all methods available at the moment of invocation - delivering the result of each target as it arrives.
+ * \param endpoint_name The name of the method to be invoked - for all targets.
+ * \param args Invocation arguments.
+ * \param len The size of the invocation arguments.
+ * \param on_result Callback to be called with each result, until the invocation finished.
+ * \param on_done Callback to be called once with the summary - when all targets responded, the options cut the wait short or it timed out.
+ * \param cookie Optional callback cookie.
+ * \return 0 if successful.
+ */
+inline int glue_invoke_all_partial(const char* endpoint_name, const glue_arg* args, int len, payload_function on_result,
+	glue_invoke_all_done_function on_done = nullptr, COOKIE cookie = nullptr, const glue_invoke_all_options& options = {})
+{
+	return glue_invoke_all_state::invoke(endpoint_name, args, len, on_result, on_done, cookie, options);
+}
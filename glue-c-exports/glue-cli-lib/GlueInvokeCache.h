@@ -0,0 +1,430 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "GlueCLILib.h"
+#include "GlueFlat.h"
+#include "GlueHash.h"
+#include "GlueSingleFlight.h"
+
+/*
+ * Client-side memoization of glue_invoke results - opt-in per endpoint.
+ *
+ * Endpoints invoked over and over with the same args (reference data lookups and the like) can be
+ * served from a glue_invocation_cache: results are kept per endpoint name and args - the args deep
+ * hashed and compared - for the endpoint's TTL, the least recently used ones evicted once the cache
+ * is full:
+ *
+ *	glue_invocation_cache cache(4096);
+ *	cache.enable("RefData.Instrument", std::chrono::seconds(30));
+ *	...
+ *	cache.invoke("RefData.Instrument", args, len, &on_instrument, cookie);		// as glue_invoke
+ *
+ * The results of an instance (matched by their origin) are dropped as soon as glue_subscribe_endpoints_status
+ * reports its endpoint gone, and results in flight for the endpoint at that moment are not stored.
+ * Failures (status != 0) are not cached, and neither are the results of endpoints not enabled - these
+ * are plain glue_invoke calls. Misses of the same args at the same time share a single invocation
+ * (GlueSingleFlight.h).
+ *
+ * Hits are delivered on the calling thread, before invoke returns; misses on the Glue thread, as for
+ * glue_invoke. Payloads delivered from the cache have no reader (nullptr) - read their args.
+ * Destroy the cache only once the results of its invocations have been delivered.
+ * The header is C++14.
+ */
+
+/**
+ * \brief Counters of a cache, cumulative since it was created.
+ */
+struct glue_cache_metrics
+{
+	long long hits;
+	long long misses;
+	// misses attached to an identical invocation in flight - not invoked again
+	long long collapsed;
+	// results stored
+	long long stores;
+	// entries evicted to make room
+	long long evictions;
+	// entries found past their TTL
+	long long expirations;
+	// entries dropped because their instance went away - or via invalidate/disable
+	long long invalidations;
+	size_t entries;
+	size_t bytes;
+};
+
+/**
+ * \brief TTL and size bound cache of invocation results - thread safe.
+ */
+class glue_invocation_cache
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	/**
+	 * \param capacity The most entries kept.
+	 * \param max_bytes The most bytes of args and results kept - 0 for no limit.
+	 */
+	explicit glue_invocation_cache(size_t capacity = 1024, size_t max_bytes = 0) : capacity_(capacity > 0 ? capacity : 1), max_bytes_(max_bytes)
+	{
+		status_subscription_ = glue_subscribe_endpoints_status(&glue_invocation_cache::status_changed, this);
+	}
+
+	glue_invocation_cache(const glue_invocation_cache&) = delete;
+	glue_invocation_cache& operator=(const glue_invocation_cache&) = delete;
+
+	~glue_invocation_cache()
+	{
+		if (status_subscription_ != nullptr)
+		{
+			glue_destroy_resource(status_subscription_);
+		}
+	}
+
+	/**
+	 * \brief Caches the results of an endpoint from now on - or changes its TTL (for results stored from then on).
+	 */
+	void enable(const char* endpoint_name, std::chrono::milliseconds ttl)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		endpoints_[endpoint_name].ttl = ttl;
+	}
+
+	/**
+	 * \brief Stops caching the results of an endpoint and drops those cached.
+	 */
+	void disable(const char* endpoint_name)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		drop(endpoint_name, nullptr);
+		endpoints_.erase(endpoint_name);
+	}
+
+	/**
+	 * \brief Drops the cached results of an endpoint - of all its instances, or of the instance of an origin.
+	 */
+	void invalidate(const char* endpoint_name, const char* origin = nullptr)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		drop(endpoint_name, origin);
+	}
+
+	/**
+	 * \brief Invokes a single (best) method by name - as glue_invoke, unless its result is cached.
+	 * \return 0 if successful.
+	 */
+	int invoke(const char* endpoint_name, const glue_arg* args, int len, payload_function callback = nullptr, COOKIE cookie = nullptr)
+	{
+		if (endpoint_name == nullptr)
+		{
+			return -1;
+		}
+
+		const auto hash = glue_hash_combine(glue_string_hash(endpoint_name), glue_args_hash(args, len));
+		std::shared_ptr<const entry> hit;
+		long long generation;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			const auto endpoint = endpoints_.find(endpoint_name);
+			if (endpoint == endpoints_.end())
+			{
+				return glue_invoke(endpoint_name, args, len, callback, cookie);
+			}
+
+			generation = endpoint->second.generation;
+			hit = find(hash, endpoint_name, args, len);
+			if (hit != nullptr)
+			{
+				++metrics_.hits;
+			}
+			else
+			{
+				++metrics_.misses;
+			}
+		}
+
+		if (hit != nullptr)
+		{
+			if (callback != nullptr)
+			{
+				int result_len;
+				const auto result_args = glue_flat_args(hit->result, result_len);
+				const glue_payload payload{ nullptr, hit->origin.c_str(), 0, result_args, result_len };
+				callback(endpoint_name, cookie, &payload);
+			}
+			return 0;
+		}
+
+		const auto request = new pending_request{ this, endpoint_name, hash, glue_flatten(args, len), generation, callback, cookie };
+		// misses from before and after an invalidation never share a flight - the result from before would be stored for the later ones
+		const auto invoked = flights_.invoke(endpoint_name, args, len, &glue_invocation_cache::complete, request, generation);
+		if (invoked != 0)
+		{
+			glue_delete_flat(request->args);
+			delete request;
+		}
+		return invoked;
+	}
+
+	/**
+	 * \brief Drops all cached results.
+	 */
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		lru_.clear();
+		index_.clear();
+		metrics_.bytes = 0;
+	}
+
+	glue_cache_metrics metrics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto metrics = metrics_;
+		metrics.entries = lru_.size();
+		metrics.collapsed = flights_.collapsed();
+		return metrics;
+	}
+
+private:
+	/**
+	 * \brief A cached result - its args and result in flat blocks.
+	 */
+	struct entry
+	{
+		std::string endpoint_name;
+		uint64_t hash;
+		void* args;
+		void* result;
+		std::string origin;
+		size_t bytes;
+		clock::time_point expires;
+
+		~entry()
+		{
+			glue_delete_flat(args);
+			glue_delete_flat(result);
+		}
+	};
+
+	struct endpoint_policy
+	{
+		std::chrono::milliseconds ttl{ 0 };
+		// bumped whenever the endpoint's results are dropped - results in flight from before are not stored
+		long long generation = 0;
+	};
+
+	struct pending_request
+	{
+		glue_invocation_cache* cache;
+		std::string endpoint_name;
+		uint64_t hash;
+		void* args;
+		long long generation;
+		payload_function callback;
+		COOKIE cookie;
+	};
+
+	// most recently used first
+	using lru_list = std::list<std::shared_ptr<const entry>>;
+
+	static void complete(const char* origin, COOKIE cookie, const glue_payload* payload)
+	{
+		const auto request = static_cast<pending_request*>(const_cast<void*>(cookie));
+		if (payload->status == 0)
+		{
+			// takes over the request's args
+			request->cache->store(*request, payload);
+		}
+		if (request->callback != nullptr)
+		{
+			request->callback(origin, request->cookie, payload);
+		}
+		glue_delete_flat(request->args);
+		delete request;
+	}
+
+	static void status_changed(const char* endpoint_name, const char* origin, bool state, COOKIE cookie)
+	{
+		if (!state && endpoint_name != nullptr)
+		{
+			static_cast<glue_invocation_cache*>(const_cast<void*>(cookie))->invalidate(endpoint_name, origin);
+		}
+	}
+
+	using index_map = std::unordered_multimap<uint64_t, lru_list::iterator>;
+
+	/**
+	 * \brief Finds the entry of an endpoint and args, live or not - call with the mutex locked.
+	 */
+	index_map::iterator find_entry(uint64_t hash, const char* endpoint_name, const glue_arg* args, int len)
+	{
+		const auto range = index_.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			const auto& cached = **it->second;
+			int cached_len;
+			const auto cached_args = glue_flat_args(cached.args, cached_len);
+			if (cached.endpoint_name == endpoint_name && glue_args_equal(cached_args, cached_len, args, len))
+			{
+				return it;
+			}
+		}
+		return index_.end();
+	}
+
+	/**
+	 * \brief Finds the live entry of an endpoint and args and makes it the most recently used - call with the mutex locked.
+	 */
+	std::shared_ptr<const entry> find(uint64_t hash, const char* endpoint_name, const glue_arg* args, int len)
+	{
+		const auto it = find_entry(hash, endpoint_name, args, len);
+		if (it == index_.end())
+		{
+			return nullptr;
+		}
+
+		if (clock::now() >= (*it->second)->expires)
+		{
+			++metrics_.expirations;
+			erase(it);
+			return nullptr;
+		}
+		lru_.splice(lru_.begin(), lru_, it->second);
+		return *it->second;
+	}
+
+	/**
+	 * \brief True if the result of a request is to be stored - call with the mutex locked.
+	 */
+	bool storable(const pending_request& request)
+	{
+		const auto endpoint = endpoints_.find(request.endpoint_name);
+		return endpoint != endpoints_.end() && endpoint->second.generation == request.generation;
+	}
+
+	void store(pending_request& request, const glue_payload* payload)
+	{
+		int len;
+		const auto args = glue_flat_args(request.args, len);
+		{
+			// the invocations collapsed into a flight share its result - the first of them stores it
+			std::lock_guard<std::mutex> lock(mutex_);
+			const auto it = find_entry(request.hash, request.endpoint_name.c_str(), args, len);
+			if (!storable(request) || (it != index_.end() && clock::now() < (*it->second)->expires))
+			{
+				return;
+			}
+		}
+
+		auto stored = std::make_shared<entry>();
+		stored->endpoint_name = request.endpoint_name;
+		stored->hash = request.hash;
+		stored->args = request.args;
+		request.args = nullptr;
+		stored->result = glue_flatten(payload->args, payload->args_len);
+		stored->origin = payload->origin != nullptr ? payload->origin : "";
+		stored->bytes = glue_flat_size(stored->args) + glue_flat_size(stored->result);
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!storable(request))
+		{
+			return;
+		}
+		stored->expires = clock::now() + endpoints_[request.endpoint_name].ttl;
+
+		// stored meanwhile - or expired
+		const auto it = find_entry(request.hash, request.endpoint_name.c_str(), args, len);
+		if (it != index_.end())
+		{
+			erase(it);
+		}
+
+		metrics_.bytes += stored->bytes;
+		lru_.push_front(std::move(stored));
+		index_.emplace(request.hash, lru_.begin());
+		++metrics_.stores;
+
+		while (lru_.size() > capacity_ || (max_bytes_ > 0 && metrics_.bytes > max_bytes_ && lru_.size() > 1))
+		{
+			evict();
+		}
+	}
+
+	/**
+	 * \brief Evicts the least recently used entry - call with the mutex locked.
+	 */
+	void evict()
+	{
+		const auto last = std::prev(lru_.end());
+		const auto range = index_.equal_range((*last)->hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->second == last)
+			{
+				++metrics_.evictions;
+				erase(it);
+				return;
+			}
+		}
+	}
+
+	/**
+	 * \brief Removes an entry - call with the mutex locked.
+	 */
+	void erase(index_map::iterator it)
+	{
+		metrics_.bytes -= (*it->second)->bytes;
+		lru_.erase(it->second);
+		index_.erase(it);
+	}
+
+	/**
+	 * \brief Drops the entries of an endpoint (of an origin, unless nullptr) and the results in flight - call with the mutex locked.
+	 */
+	void drop(const char* endpoint_name, const char* origin)
+	{
+		const auto endpoint = endpoints_.find(endpoint_name);
+		if (endpoint == endpoints_.end())
+		{
+			return;
+		}
+		++endpoint->second.generation;
+
+		for (auto it = index_.begin(); it != index_.end();)
+		{
+			const auto& cached = **it->second;
+			if (cached.endpoint_name == endpoint_name && (origin == nullptr || cached.origin == origin))
+			{
+				++metrics_.invalidations;
+				metrics_.bytes -= cached.bytes;
+				lru_.erase(it->second);
+				it = index_.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	const size_t capacity_;
+	const size_t max_bytes_;
+
+	// guarded by the mutex
+	mutable std::mutex mutex_;
+	std::unordered_map<std::string, endpoint_policy> endpoints_;
+	lru_list lru_;
+	index_map index_;
+	glue_cache_metrics metrics_{};
+
+	glue_single_flight flights_;
+
+	const void* status_subscription_ = nullptr;
+};
@@ -0,0 +1,941 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLUE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "GlueCLILib.h"
+#include "GlueArena.h"
+
+/*
+ * Relaxed JSON parsing into arena allocated Glue values.
+ *
+ * Accepts the dialect glue_push_json_payload accepts - unquoted keys, single or double quoted
+ * strings - e.g. "{fruits: {type: 'apples', items: ['red', 'white']}}". The result is built
+ * straight into glue_arg/glue_value arrays carved from a glue_arena:
+ *
+ *	glue_json_parser parser;									// reuse - keeps its scratch stacks
+ *	glue_value v;
+ *	if (parser.parse(arena, json, v) == 0) ...
+ *
+ *	glue_push_json_payload(stream, json, arena);				// parse in-process, push as args
+ *
+ * Numbers become glue_int, glue_long when out of int range, or glue_double when they have a fraction
+ * or exponent. Homogeneous arrays become typed arrays (bool/int/long/double/string), arrays of
+ * objects composite arrays, other arrays tuples; null becomes a glue_none value.
+ */
+
+/**
+ * \brief Index of the lowest set bit of a non-zero mask.
+ */
+inline int glue_ctz(unsigned mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+/**
+ * \brief Finds the first occurrence of either character - scanning 16 bytes at a time where SSE2 is available.
+ * \return The position found or end.
+ */
+inline const char* glue_json_find(const char* p, const char* end, char a, char b)
+{
+#ifdef GLUE_SSE2
+	const auto va = _mm_set1_epi8(a);
+	const auto vb = _mm_set1_epi8(b);
+	for (; end - p >= 16; p += 16)
+	{
+		const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		const auto mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)));
+		if (mask != 0)
+		{
+			return p + glue_ctz(static_cast<unsigned>(mask));
+		}
+	}
+#endif
+	while (p < end && *p != a && *p != b)
+	{
+		++p;
+	}
+	return p;
+}
+
+/**
+ * \brief Relaxed JSON parser - reusable, not thread safe.
+ */
+class glue_json_parser
+{
+public:
+	static constexpr int max_depth = 256;
+
+	/**
+	 * \brief Parses a JSON text into a Glue value allocated from the arena.
+	 * \param arena The arena receiving all arrays and strings of the value.
+	 * \param json The JSON text.
+	 * \param len The length of the text.
+	 * \param out Receives the value.
+	 * \return 0 if successful, -1 on syntax errors - see error() and error_offset().
+	 */
+	int parse(glue_arena& arena, const char* json, size_t len, glue_value& out)
+	{
+		arena_ = &arena;
+		begin_ = json;
+		p_ = json;
+		end_ = json + len;
+		error_ = nullptr;
+		error_offset_ = 0;
+		args_.clear();
+		values_.clear();
+
+		out = glue_value{};
+		if (!value(out, 0))
+		{
+			return -1;
+		}
+		skip_whitespace();
+		if (p_ != end_)
+		{
+			fail("unexpected trailing characters");
+			return -1;
+		}
+		return 0;
+	}
+
+	int parse(glue_arena& arena, const char* json, glue_value& out)
+	{
+		return parse(arena, json, strlen(json), out);
+	}
+
+	/**
+	 * \brief Parses a JSON object into an array of named Glue values - the form payloads are pushed in.
+	 * \return 0 if successful, -1 on syntax errors or if the text is not an object.
+	 */
+	int parse_args(glue_arena& arena, const char* json, size_t len, const glue_arg*& args, int& args_len)
+	{
+		glue_value v;
+		if (parse(arena, json, len, v) != 0)
+		{
+			return -1;
+		}
+		if (v.type != glue_type::glue_composite)
+		{
+			error_ = "not an object";
+			return -1;
+		}
+		args = v.composite;
+		args_len = v.len;
+		return 0;
+	}
+
+	const char* error() const
+	{
+		return error_;
+	}
+
+	size_t error_offset() const
+	{
+		return error_offset_;
+	}
+
+private:
+	bool fail(const char* message)
+	{
+		if (error_ == nullptr)
+		{
+			error_ = message;
+			error_offset_ = static_cast<size_t>(p_ - begin_);
+		}
+		return false;
+	}
+
+	void skip_whitespace()
+	{
+		while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t'))
+		{
+			++p_;
+		}
+	}
+
+	bool value(glue_value& out, int depth)
+	{
+		skip_whitespace();
+		if (p_ == end_)
+		{
+			return fail("unexpected end");
+		}
+
+		switch (*p_)
+		{
+		case '{':
+			return depth < max_depth ? object(out, depth + 1) : fail("too deep");
+		case '[':
+			return depth < max_depth ? array(out, depth + 1) : fail("too deep");
+		case '"':
+		case '\'':
+		{
+			const char* s;
+			if (!string(s))
+			{
+				return false;
+			}
+			out = glv_s(s);
+			return true;
+		}
+		case 't':
+			return literal("true", glv_b(true), out);
+		case 'f':
+			return literal("false", glv_b(false), out);
+		case 'n':
+			return literal("null", glue_value{}, out);
+		default:
+			return number(out);
+		}
+	}
+
+	bool literal(const char* text, glue_value v, glue_value& out)
+	{
+		const auto len = strlen(text);
+		if (static_cast<size_t>(end_ - p_) < len || memcmp(p_, text, len) != 0)
+		{
+			return fail("invalid literal");
+		}
+		p_ += len;
+		out = v;
+		return true;
+	}
+
+	bool object(glue_value& out, int depth)
+	{
+		++p_;
+		const auto start = args_.size();
+		for (;;)
+		{
+			skip_whitespace();
+			if (p_ == end_)
+			{
+				return fail("unterminated object");
+			}
+			if (*p_ == '}')
+			{
+				++p_;
+				break;
+			}
+
+			const char* name;
+			if (!key(name))
+			{
+				return false;
+			}
+			skip_whitespace();
+			if (p_ == end_ || *p_ != ':')
+			{
+				return fail("expected ':'");
+			}
+			++p_;
+
+			glue_value v;
+			if (!value(v, depth))
+			{
+				return false;
+			}
+			args_.push_back(glue_arg{ name, v });
+
+			skip_whitespace();
+			if (p_ < end_ && *p_ == ',')
+			{
+				++p_;
+			}
+			else if (p_ < end_ && *p_ != '}')
+			{
+				return fail("expected ',' or '}'");
+			}
+		}
+
+		const auto len = args_.size() - start;
+		out = glv_comp(len > 0 ? arena_->copy(args_.data() + start, len) : nullptr, static_cast<int>(len));
+		args_.resize(start);
+		return true;
+	}
+
+	bool array(glue_value& out, int depth)
+	{
+		++p_;
+		const auto start = values_.size();
+		for (;;)
+		{
+			skip_whitespace();
+			if (p_ == end_)
+			{
+				return fail("unterminated array");
+			}
+			if (*p_ == ']')
+			{
+				++p_;
+				break;
+			}
+
+			glue_value v;
+			if (!value(v, depth))
+			{
+				return false;
+			}
+			values_.push_back(v);
+
+			skip_whitespace();
+			if (p_ < end_ && *p_ == ',')
+			{
+				++p_;
+			}
+			else if (p_ < end_ && *p_ != ']')
+			{
+				return fail("expected ',' or ']'");
+			}
+		}
+
+		out = typed_array(values_.data() + start, values_.size() - start);
+		values_.resize(start);
+		return true;
+	}
+
+	/**
+	 * \brief Converts the items of an array into the narrowest Glue array holding them all.
+	 */
+	glue_value typed_array(const glue_value* items, size_t len)
+	{
+		if (len == 0)
+		{
+			return glv_tuple(nullptr, 0);
+		}
+
+		auto type = items[0].type;
+		for (size_t i = 0; i < len; ++i)
+		{
+			const auto t = items[i].type;
+			if (items[i].len >= 0 && t != glue_type::glue_composite)
+			{
+				type = glue_type::glue_tuple;
+				break;
+			}
+			if (t == type)
+			{
+				continue;
+			}
+
+			const auto numeric = [](glue_type n)
+			{
+				return n == glue_type::glue_int || n == glue_type::glue_long || n == glue_type::glue_double;
+			};
+			if (numeric(t) && numeric(type))
+			{
+				type = t == glue_type::glue_double || type == glue_type::glue_double ? glue_type::glue_double : glue_type::glue_long;
+				continue;
+			}
+			type = glue_type::glue_tuple;
+			break;
+		}
+
+		const auto n = static_cast<int>(len);
+		switch (type)
+		{
+		case glue_type::glue_bool:
+		{
+			const auto bb = arena_->alloc<bool>(len);
+			for (size_t i = 0; i < len; ++i)
+			{
+				bb[i] = items[i].b;
+			}
+			return glv_bb(bb, n);
+		}
+		case glue_type::glue_int:
+		{
+			const auto ii = arena_->alloc<int>(len);
+			for (size_t i = 0; i < len; ++i)
+			{
+				ii[i] = items[i].i;
+			}
+			return glv_ii(ii, n);
+		}
+		case glue_type::glue_long:
+		{
+			const auto ll = arena_->alloc<long long>(len);
+			for (size_t i = 0; i < len; ++i)
+			{
+				ll[i] = items[i].type == glue_type::glue_int ? items[i].i : items[i].l;
+			}
+			return glv_ll(ll, n);
+		}
+		case glue_type::glue_double:
+		{
+			const auto dd = arena_->alloc<double>(len);
+			for (size_t i = 0; i < len; ++i)
+			{
+				const auto& v = items[i];
+				dd[i] = v.type == glue_type::glue_double ? v.d : v.type == glue_type::glue_int ? v.i : static_cast<double>(v.l);
+			}
+			return glv_dd(dd, n);
+		}
+		case glue_type::glue_string:
+		{
+			const auto ss = arena_->alloc<const char*>(len);
+			for (size_t i = 0; i < len; ++i)
+			{
+				ss[i] = items[i].s;
+			}
+			return glv_ss(ss, n);
+		}
+		case glue_type::glue_composite:
+		{
+			const auto rows = arena_->alloc<glue_arg>(len);
+			for (size_t i = 0; i < len; ++i)
+			{
+				rows[i] = glarg_comp("", items[i].composite, items[i].len);
+			}
+			return glv_comps(rows, n);
+		}
+		default:
+			return glv_tuple(arena_->copy(items, len), n);
+		}
+	}
+
+	bool key(const char*& out)
+	{
+		if (*p_ == '"' || *p_ == '\'')
+		{
+			return string(out);
+		}
+
+		const auto start = p_;
+		while (p_ < end_ && (isalnum(static_cast<unsigned char>(*p_)) || *p_ == '_' || *p_ == '$' || *p_ == '-'))
+		{
+			++p_;
+		}
+		if (p_ == start)
+		{
+			return fail("expected a key");
+		}
+		out = copy(start, static_cast<size_t>(p_ - start));
+		return true;
+	}
+
+	const char* copy(const char* s, size_t len)
+	{
+		const auto p = arena_->alloc<char>(len + 1);
+		memcpy(p, s, len);
+		p[len] = 0;
+		return p;
+	}
+
+	bool string(const char*& out)
+	{
+		const auto quote = *p_++;
+		const auto start = p_;
+		p_ = glue_json_find(p_, end_, quote, '\\');
+		if (p_ == end_)
+		{
+			return fail("unterminated string");
+		}
+		if (*p_ == quote)
+		{
+			out = copy(start, static_cast<size_t>(p_ - start));
+			++p_;
+			return true;
+		}
+
+		// escaped string - unescape through the scratch buffer
+		scratch_.assign(start, p_);
+		while (p_ < end_ && *p_ != quote)
+		{
+			if (*p_ != '\\')
+			{
+				const auto next = glue_json_find(p_, end_, quote, '\\');
+				scratch_.append(p_, next);
+				p_ = next;
+				continue;
+			}
+
+			if (++p_ == end_)
+			{
+				break;
+			}
+			const auto c = *p_++;
+			switch (c)
+			{
+			case 'n':
+				scratch_.push_back('\n');
+				break;
+			case 't':
+				scratch_.push_back('\t');
+				break;
+			case 'r':
+				scratch_.push_back('\r');
+				break;
+			case 'b':
+				scratch_.push_back('\b');
+				break;
+			case 'f':
+				scratch_.push_back('\f');
+				break;
+			case 'u':
+				if (!unicode_escape())
+				{
+					return false;
+				}
+				break;
+			default:
+				scratch_.push_back(c);
+				break;
+			}
+		}
+		if (p_ == end_)
+		{
+			return fail("unterminated string");
+		}
+		++p_;
+		out = copy(scratch_.data(), scratch_.size());
+		return true;
+	}
+
+	bool hex4(uint32_t& code)
+	{
+		if (end_ - p_ < 4)
+		{
+			return fail("invalid unicode escape");
+		}
+		code = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			const auto c = *p_++;
+			code <<= 4;
+			if (c >= '0' && c <= '9')
+			{
+				code |= c - '0';
+			}
+			else if (c >= 'a' && c <= 'f')
+			{
+				code |= c - 'a' + 10;
+			}
+			else if (c >= 'A' && c <= 'F')
+			{
+				code |= c - 'A' + 10;
+			}
+			else
+			{
+				return fail("invalid unicode escape");
+			}
+		}
+		return true;
+	}
+
+	bool unicode_escape()
+	{
+		uint32_t code;
+		if (!hex4(code))
+		{
+			return false;
+		}
+		if (code >= 0xdc00 && code < 0xe000)
+		{
+			return fail("unpaired surrogate");
+		}
+		if (code >= 0xd800 && code < 0xdc00)
+		{
+			// a high surrogate is only valid followed by an escaped low surrogate
+			if (end_ - p_ < 6 || p_[0] != '\\' || p_[1] != 'u')
+			{
+				return fail("unpaired surrogate");
+			}
+			p_ += 2;
+			uint32_t low;
+			if (!hex4(low))
+			{
+				return false;
+			}
+			if (low < 0xdc00 || low >= 0xe000)
+			{
+				return fail("unpaired surrogate");
+			}
+			code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+		}
+
+		if (code < 0x80)
+		{
+			scratch_.push_back(static_cast<char>(code));
+		}
+		else if (code < 0x800)
+		{
+			scratch_.push_back(static_cast<char>(0xc0 | code >> 6));
+			scratch_.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+		}
+		else if (code < 0x10000)
+		{
+			scratch_.push_back(static_cast<char>(0xe0 | code >> 12));
+			scratch_.push_back(static_cast<char>(0x80 | (code >> 6 & 0x3f)));
+			scratch_.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+		}
+		else
+		{
+			scratch_.push_back(static_cast<char>(0xf0 | code >> 18));
+			scratch_.push_back(static_cast<char>(0x80 | (code >> 12 & 0x3f)));
+			scratch_.push_back(static_cast<char>(0x80 | (code >> 6 & 0x3f)));
+			scratch_.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+		}
+		return true;
+	}
+
+	bool number(glue_value& out)
+	{
+		const auto start = p_;
+		if (p_ < end_ && (*p_ == '-' || *p_ == '+'))
+		{
+			++p_;
+		}
+		const auto digits = p_;
+		bool integral = true;
+		while (p_ < end_)
+		{
+			const auto c = *p_;
+			if (c >= '0' && c <= '9')
+			{
+				++p_;
+			}
+			else if (c == '.' || c == 'e' || c == 'E' || ((c == '-' || c == '+') && (p_[-1] == 'e' || p_[-1] == 'E')))
+			{
+				integral = false;
+				++p_;
+			}
+			else
+			{
+				break;
+			}
+		}
+		if (p_ == digits)
+		{
+			return fail("unexpected character");
+		}
+
+		const auto negative = *start == '-';
+		if (integral && p_ - digits <= 18)
+		{
+			long long l = 0;
+			for (auto d = digits; d < p_; ++d)
+			{
+				l = l * 10 + (*d - '0');
+			}
+			l = negative ? -l : l;
+			out = l >= std::numeric_limits<int>::min() && l <= std::numeric_limits<int>::max() ? glv_i(static_cast<int>(l)) : glv_l(l);
+			return true;
+		}
+		if (integral)
+		{
+			long long l;
+			const auto result = std::from_chars(negative ? start : digits, p_, l);
+			if (result.ec == std::errc() && result.ptr == p_)
+			{
+				out = glv_l(l);
+				return true;
+			}
+		}
+
+		double d;
+		const auto result = std::from_chars(negative ? start : digits, p_, d);
+		if (result.ptr != p_)
+		{
+			return fail("invalid number");
+		}
+		out = glv_d(d);
+		return true;
+	}
+
+	glue_arena* arena_ = nullptr;
+	const char* begin_ = nullptr;
+	const char* p_ = nullptr;
+	const char* end_ = nullptr;
+	const char* error_ = nullptr;
+	size_t error_offset_ = 0;
+
+	std::vector<glue_arg> args_;
+	std::vector<glue_value> values_;
+	std::string scratch_;
+};
+
+/**
+ * \brief Parses a relaxed JSON text into a Glue value allocated from the arena.
+ * \return 0 if successful.
+ */
+inline int glue_parse_json(glue_arena& arena, const char* json, glue_value& out)
+{
+	glue_json_parser parser;
+	return parser.parse(arena, json, out);
+}
+
+/**
+ * \brief Parses a relaxed JSON object in-process and pushes it as args, resetting the arena afterwards.
+ * Texts which are not objects are handed over to GlueCLILib as they are.
+ * \param endpoint The reference to the endpoint returned by the corresponding register call.
+ * \param json The JSON text - e.g. "{x: 5, y: {a: 51, s: \"hello\"}}"
+ * \param arena The arena to parse into.
+ * \return 0 if the payload was pushed successfully.
+ */
+inline int glue_push_json_payload(const void* endpoint, const char* json, glue_arena& arena)
+{
+	thread_local glue_json_parser parser;
+	const glue_arg* args;
+	int len;
+	if (parser.parse_args(arena, json, strlen(json), args, len) != 0)
+	{
+		arena.reset();
+		return glue_push_json_payload(endpoint, json);
+	}
+	return glue_push_payload(endpoint, args, len, arena);
+}
+
+// writing JSON
+// Writers append to a caller owned std::string - clear() and reuse it, so that once it has grown
+// to the largest document written, writing performs no allocations.
+
+/**
+ * \brief Finds the first character which needs escaping in a JSON string - quote, backslash or control characters.
+ * \return The position found or end.
+ */
+inline const char* glue_json_find_escape(const char* p, const char* end)
+{
+#ifdef GLUE_SSE2
+	const auto quote = _mm_set1_epi8('"');
+	const auto backslash = _mm_set1_epi8('\\');
+	const auto control = _mm_set1_epi8(0x1f);
+	for (; end - p >= 16; p += 16)
+	{
+		const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		// unsigned c <= 0x1f exactly when min(c, 0x1f) == c
+		const auto escaped = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+			_mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+		const auto mask = _mm_movemask_epi8(escaped);
+		if (mask != 0)
+		{
+			return p + glue_ctz(static_cast<unsigned>(mask));
+		}
+	}
+#endif
+	while (p < end && *p != '"' && *p != '\\' && static_cast<unsigned char>(*p) >= 0x20)
+	{
+		++p;
+	}
+	return p;
+}
+
+inline void glue_write_json_string(const char* s, std::string& out)
+{
+	if (s == nullptr)
+	{
+		out.append("null");
+		return;
+	}
+
+	const auto end = s + strlen(s);
+	out.push_back('"');
+	for (;;)
+	{
+		const auto next = glue_json_find_escape(s, end);
+		out.append(s, next);
+		if (next == end)
+		{
+			break;
+		}
+
+		const auto c = static_cast<unsigned char>(*next);
+		switch (c)
+		{
+		case '"':
+			out.append("\\\"");
+			break;
+		case '\\':
+			out.append("\\\\");
+			break;
+		case '\n':
+			out.append("\\n");
+			break;
+		case '\r':
+			out.append("\\r");
+			break;
+		case '\t':
+			out.append("\\t");
+			break;
+		case '\b':
+			out.append("\\b");
+			break;
+		case '\f':
+			out.append("\\f");
+			break;
+		default:
+		{
+			const char hex[] = "0123456789abcdef";
+			const char escaped[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+			out.append(escaped, sizeof(escaped));
+			break;
+		}
+		}
+		s = next + 1;
+	}
+	out.push_back('"');
+}
+
+inline void glue_write_json_number(long long n, std::string& out)
+{
+	char buffer[24];
+	const auto result = std::to_chars(buffer, buffer + sizeof(buffer), n);
+	out.append(buffer, result.ptr);
+}
+
+/**
+ * \brief Writes the shortest text that parses back to the same double - NaN and infinities as null.
+ */
+inline void glue_write_json_number(double d, std::string& out)
+{
+	if (d != d || d == std::numeric_limits<double>::infinity() || d == -std::numeric_limits<double>::infinity())
+	{
+		out.append("null");
+		return;
+	}
+	char buffer[32];
+	const auto result = std::to_chars(buffer, buffer + sizeof(buffer), d);
+	out.append(buffer, result.ptr);
+
+	// keep integral doubles doubles when parsed back
+	if (std::find_if(buffer, result.ptr, [](char c) { return c == '.' || c == 'e'; }) == result.ptr)
+	{
+		out.append(".0");
+	}
+}
+
+inline void glue_write_json(const glue_arg* args, int len, std::string& out);
+
+/**
+ * \brief Appends a Glue value as JSON.
+ * Composites become objects; arrays, tuples and composite arrays become arrays; datetimes their epoch milliseconds
+ * and glue_none values null.
+ * \param v The value to write.
+ * \param out The buffer to append to.
+ */
+inline void glue_write_json(const glue_value& v, std::string& out)
+{
+	if (v.type == glue_type::glue_none)
+	{
+		out.append("null");
+		return;
+	}
+
+	if (v.len < 0)
+	{
+		switch (v.type)
+		{
+		case glue_type::glue_bool:
+			out.append(v.b ? "true" : "false");
+			return;
+		case glue_type::glue_int:
+			glue_write_json_number(static_cast<long long>(v.i), out);
+			return;
+		case glue_type::glue_long:
+		case glue_type::glue_datetime:
+			glue_write_json_number(v.l, out);
+			return;
+		case glue_type::glue_double:
+			glue_write_json_number(v.d, out);
+			return;
+		case glue_type::glue_string:
+			glue_write_json_string(v.s, out);
+			return;
+		default:
+			out.append("null");
+			return;
+		}
+	}
+
+	if (v.type == glue_type::glue_composite)
+	{
+		glue_write_json(v.composite, v.len, out);
+		return;
+	}
+
+	out.push_back('[');
+	for (int i = 0; i < v.len; ++i)
+	{
+		if (i > 0)
+		{
+			out.push_back(',');
+		}
+
+		switch (v.type)
+		{
+		case glue_type::glue_bool:
+			out.append(v.bb[i] ? "true" : "false");
+			break;
+		case glue_type::glue_int:
+			glue_write_json_number(static_cast<long long>(v.ii[i]), out);
+			break;
+		case glue_type::glue_long:
+		case glue_type::glue_datetime:
+			glue_write_json_number(v.ll[i], out);
+			break;
+		case glue_type::glue_double:
+			glue_write_json_number(v.dd[i], out);
+			break;
+		case glue_type::glue_string:
+			glue_write_json_string(v.ss[i], out);
+			break;
+		case glue_type::glue_tuple:
+			glue_write_json(v.tuple[i], out);
+			break;
+		case glue_type::glue_composite_array:
+			glue_write_json(v.composite[i].value, out);
+			break;
+		default:
+			out.append("null");
+			break;
+		}
+	}
+	out.push_back(']');
+}
+
+/**
+ * \brief Appends an array of named Glue values as a JSON object.
+ */
+inline void glue_write_json(const glue_arg* args, int len, std::string& out)
+{
+	out.push_back('{');
+	for (int i = 0; i < len; ++i)
+	{
+		if (i > 0)
+		{
+			out.push_back(',');
+		}
+		glue_write_json_string(args[i].name != nullptr ? args[i].name : "", out);
+		out.push_back(':');
+		glue_write_json(args[i].value, out);
+	}
+	out.push_back('}');
+}
+
+/**
+ * \brief Appends the args of a payload as a JSON object.
+ */
+inline void glue_write_json(const glue_payload* payload, std::string& out)
+{
+	glue_write_json(payload->args, payload->args_len, out);
+}
@@ -0,0 +1,503 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "GlueCLILib.h"
+#include "GlueArena.h"
+#include "GlueJson.h"
+
+/*
+ * Lazy readers over raw JSON text.
+ *
+ * glue_open_json_reader keeps the JSON text and builds only a structural index of it - the positions
+ * of brackets and string quotes, each linked to its match so unread subtrees and strings
+ * are skipped in one step. Fields are decoded when read; nothing is allocated for fields never read.
+ *
+ * A lazy reader is a glue_json_reader*, a handle of its own - read it via the glue_read_*_lazy
+ * functions; GlueCLILib's readers (const void*) are read via GlueCLILib's glue_read_* functions:
+ *
+ *	const auto reader = glue_open_json_reader(json, strlen(json));
+ *	const auto name = glue_read_s_lazy(reader, "data.contact.displayName");
+ *	glue_destroy_json_reader(reader);
+ *
+ * Unquoted keys are compared as written; quoted keys are compared without unescaping.
+ */
+
+/**
+ * \brief Entry of the structural index - a bracket outside strings or a string quote.
+ */
+struct glue_json_token
+{
+	uint32_t pos;
+	// for opening brackets and quotes the index of the matching token
+	uint32_t match;
+};
+
+/**
+ * \brief A located JSON value - the text range and, for objects/arrays/strings, its first token.
+ */
+struct glue_json_span
+{
+	size_t begin;
+	size_t end;
+	uint32_t token;
+};
+
+class glue_json_reader
+{
+public:
+	static constexpr uint32_t no_token = 0xffffffffu;
+
+	glue_json_reader(const char* json, size_t len, bool copy)
+	{
+		if (copy)
+		{
+			copy_.assign(json, len);
+			json = copy_.data();
+		}
+		text_ = json;
+		len_ = len;
+		valid_ = index();
+	}
+
+	/**
+	 * \brief True if the text is structurally valid - balanced brackets and terminated strings.
+	 */
+	bool valid() const
+	{
+		return valid_;
+	}
+
+	/**
+	 * \brief Locates the value at a dot-separated field path.
+	 * \return false if there is no such field.
+	 */
+	bool find(const char* field_path, glue_json_span& span) const
+	{
+		if (!valid_)
+		{
+			return false;
+		}
+
+		span = root();
+		const auto path_end = field_path != nullptr ? field_path + strlen(field_path) : nullptr;
+		for (auto segment = field_path; segment != nullptr && segment < path_end;)
+		{
+			auto dot = static_cast<const char*>(memchr(segment, '.', static_cast<size_t>(path_end - segment)));
+			if (dot == nullptr)
+			{
+				dot = path_end;
+			}
+			if (!member(span, segment, static_cast<size_t>(dot - segment), span))
+			{
+				return false;
+			}
+			segment = dot + 1;
+		}
+		return true;
+	}
+
+	glue_value read_glue_value(const char* field_path)
+	{
+		glue_json_span span;
+		glue_value v{};
+		if (find(field_path, span))
+		{
+			parser_.parse(arena_, text_ + span.begin, span.end - span.begin, v);
+		}
+		return v;
+	}
+
+	const char* read_json(const char* field_path)
+	{
+		glue_json_span span;
+		if (!find(field_path, span))
+		{
+			return nullptr;
+		}
+		return copy_text(span.begin, span.end - span.begin);
+	}
+
+	const char* read_s(const char* field_path)
+	{
+		glue_json_span span;
+		if (!find(field_path, span) || span.token == no_token || !is_quote(text_[span.begin]))
+		{
+			return nullptr;
+		}
+
+		const auto begin = span.begin + 1;
+		const auto len = span.end - 1 - begin;
+		if (memchr(text_ + begin, '\\', len) == nullptr)
+		{
+			return copy_text(begin, len);
+		}
+
+		glue_value v;
+		return parser_.parse(arena_, text_ + span.begin, span.end - span.begin, v) == 0 ? v.s : nullptr;
+	}
+
+	/**
+	 * \brief Reads a boolean - true, false or a number, which is true unless 0 (as glue_read_b).
+	 */
+	bool read_b(const char* field_path)
+	{
+		return read_number<bool>(field_path);
+	}
+
+	/**
+	 * \brief Reads a number - converted to T as glue_read_* convert the values of a parsed payload.
+	 * \return T{} for fields missing, not numbers or out of range.
+	 */
+	template <typename T>
+	T read_number(const char* field_path)
+	{
+		glue_json_span span;
+		if (!find(field_path, span) || span.token != no_token)
+		{
+			return T{};
+		}
+
+		auto begin = text_ + span.begin;
+		const auto end = text_ + span.end;
+		if (end - begin == 4 && memcmp(begin, "true", 4) == 0)
+		{
+			return static_cast<T>(true);
+		}
+		begin += begin < end && *begin == '+' ? 1 : 0;
+
+		// integers too large for a long long are parsed as doubles - as the parser would
+		long long l;
+		const auto integer = std::from_chars(begin, end, l);
+		if (integer.ec == std::errc() && integer.ptr == end)
+		{
+			return static_cast<T>(l);
+		}
+
+		double d;
+		const auto real = std::from_chars(begin, end, d);
+		return real.ec == std::errc() && real.ptr == end ? static_cast<T>(d) : T{};
+	}
+
+	const char* text() const
+	{
+		return text_;
+	}
+
+	size_t length() const
+	{
+		return len_;
+	}
+
+	size_t tokens() const
+	{
+		return tokens_.size();
+	}
+
+private:
+	static bool is_quote(char c)
+	{
+		return c == '"' || c == '\'';
+	}
+
+	static bool is_space(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
+
+	/**
+	 * \brief Builds the structural index - SSE2 finds the candidate characters 16 bytes at a time,
+	 * the string state is then tracked over the candidates only.
+	 */
+	bool index()
+	{
+		std::vector<uint32_t> open;
+		bool in_string = false;
+		char quote = 0;
+		size_t escaped = static_cast<size_t>(-1);
+
+		const auto visit = [&](size_t pos) -> bool
+		{
+			const auto c = text_[pos];
+			if (in_string)
+			{
+				if (pos == escaped)
+				{
+					return true;
+				}
+				if (c == '\\')
+				{
+					escaped = pos + 1;
+				}
+				else if (c == quote)
+				{
+					tokens_[open.back()].match = static_cast<uint32_t>(tokens_.size());
+					open.pop_back();
+					tokens_.push_back(glue_json_token{ static_cast<uint32_t>(pos), no_token });
+					in_string = false;
+				}
+				return true;
+			}
+
+			switch (c)
+			{
+			case '"':
+			case '\'':
+				in_string = true;
+				quote = c;
+				open.push_back(static_cast<uint32_t>(tokens_.size()));
+				break;
+			case '{':
+			case '[':
+				open.push_back(static_cast<uint32_t>(tokens_.size()));
+				break;
+			case '}':
+			case ']':
+				if (open.empty() || text_[tokens_[open.back()].pos] != (c == '}' ? '{' : '['))
+				{
+					return false;
+				}
+				tokens_[open.back()].match = static_cast<uint32_t>(tokens_.size());
+				open.pop_back();
+				break;
+			default:
+				return true;
+			}
+			tokens_.push_back(glue_json_token{ static_cast<uint32_t>(pos), no_token });
+			return true;
+		};
+
+		tokens_.clear();
+		size_t i = 0;
+#ifdef GLUE_SSE2
+		const auto open_brace = _mm_set1_epi8('{');
+		const auto close_brace = _mm_set1_epi8('}');
+		const auto open_bracket = _mm_set1_epi8('[');
+		const auto close_bracket = _mm_set1_epi8(']');
+		const auto double_quote = _mm_set1_epi8('"');
+		const auto single_quote = _mm_set1_epi8('\'');
+		const auto backslash = _mm_set1_epi8('\\');
+		for (; i + 16 <= len_; i += 16)
+		{
+			const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text_ + i));
+			const auto brackets = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, open_brace), _mm_cmpeq_epi8(chunk, close_brace)),
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, open_bracket), _mm_cmpeq_epi8(chunk, close_bracket)));
+			const auto strings = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, double_quote), _mm_cmpeq_epi8(chunk, single_quote)),
+				_mm_cmpeq_epi8(chunk, backslash));
+			for (auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(brackets, strings))); mask != 0; mask &= mask - 1)
+			{
+				if (!visit(i + glue_ctz(mask)))
+				{
+					return false;
+				}
+			}
+		}
+#endif
+		for (; i < len_; ++i)
+		{
+			const auto c = text_[i];
+			if (c == '{' || c == '}' || c == '[' || c == ']' || is_quote(c) || c == '\\')
+			{
+				if (!visit(i))
+				{
+					return false;
+				}
+			}
+		}
+		return !in_string && open.empty();
+	}
+
+	/**
+	 * \brief Span of the whole text, trimmed.
+	 */
+	glue_json_span root() const
+	{
+		size_t begin = 0;
+		size_t end = len_;
+		trim(begin, end);
+		return glue_json_span{ begin, end, !tokens_.empty() && tokens_[0].pos == begin ? 0 : no_token };
+	}
+
+	void trim(size_t& begin, size_t& end) const
+	{
+		while (begin < end && is_space(text_[begin]))
+		{
+			++begin;
+		}
+		while (end > begin && is_space(text_[end - 1]))
+		{
+			--end;
+		}
+	}
+
+	size_t skip_space(size_t pos) const
+	{
+		while (pos < len_ && is_space(text_[pos]))
+		{
+			++pos;
+		}
+		return pos;
+	}
+
+	/**
+	 * \brief Finds a member of an object by name.
+	 * Only brackets and quotes are indexed - keys, separators and scalars are read from the text between them,
+	 * while nested objects, arrays and strings are skipped via their matching token.
+	 */
+	bool member(const glue_json_span& object, const char* name, size_t len, glue_json_span& out) const
+	{
+		if (object.token == no_token || text_[object.begin] != '{')
+		{
+			return false;
+		}
+
+		const size_t close = tokens_[tokens_[object.token].match].pos;
+		// the first token at or after pos
+		auto t = object.token + 1;
+		auto pos = object.begin + 1;
+		for (;;)
+		{
+			pos = skip_space(pos);
+			if (pos >= close)
+			{
+				return false;
+			}
+			if (text_[pos] == ',')
+			{
+				++pos;
+				continue;
+			}
+
+			// the key - quoted, or the text up to the ':'
+			size_t key_begin;
+			size_t key_end;
+			if (is_quote(text_[pos]))
+			{
+				key_begin = pos + 1;
+				key_end = tokens_[tokens_[t].match].pos;
+				pos = key_end + 1;
+				t = tokens_[t].match + 1;
+			}
+			else
+			{
+				key_begin = pos;
+				while (pos < close && text_[pos] != ':' && !is_space(text_[pos]))
+				{
+					++pos;
+				}
+				key_end = pos;
+			}
+
+			pos = skip_space(pos);
+			if (pos >= close || text_[pos] != ':')
+			{
+				return false;
+			}
+			pos = skip_space(pos + 1);
+
+			// the value - a token skipped to its match, or a scalar up to the next separator
+			glue_json_span value;
+			const auto c = text_[pos];
+			if (c == '{' || c == '[' || is_quote(c))
+			{
+				const auto end = static_cast<size_t>(tokens_[tokens_[t].match].pos) + 1;
+				value = glue_json_span{ pos, end, t };
+				t = tokens_[t].match + 1;
+				pos = end;
+			}
+			else
+			{
+				auto begin = pos;
+				while (pos < close && text_[pos] != ',')
+				{
+					++pos;
+				}
+				auto end = pos;
+				trim(begin, end);
+				value = glue_json_span{ begin, end, no_token };
+			}
+
+			if (key_end - key_begin == len && memcmp(text_ + key_begin, name, len) == 0)
+			{
+				out = value;
+				return true;
+			}
+		}
+	}
+
+	const char* copy_text(size_t begin, size_t len)
+	{
+		const auto p = arena_.alloc<char>(len + 1);
+		memcpy(p, text_ + begin, len);
+		p[len] = 0;
+		return p;
+	}
+
+	std::string copy_;
+	const char* text_ = nullptr;
+	size_t len_ = 0;
+	bool valid_ = false;
+	std::vector<glue_json_token> tokens_;
+
+	// decoded fields - released with the reader
+	glue_arena arena_;
+	glue_json_parser parser_;
+};
+
+/**
+ * \brief Opens a lazy reader over JSON text.
+ * \param json The JSON text - relaxed JSON as accepted by glue_push_json_payload.
+ * \param len The length of the text - at most 4GB.
+ * \param copy Copy the text - pass false only if the text outlives the reader.
+ * \return The reader - release it via glue_destroy_json_reader. Not thread safe.
+ */
+inline glue_json_reader* glue_open_json_reader(const char* json, size_t len, bool copy = true)
+{
+	return new glue_json_reader(json, len, copy);
+}
+
+inline void glue_destroy_json_reader(glue_json_reader* reader)
+{
+	delete reader;
+}
+
+// reading from lazy readers - the results are valid for the lifetime of the reader
+
+inline glue_value glue_read_glue_value_lazy(glue_json_reader* reader, const char* field_path)
+{
+	return reader->read_glue_value(field_path);
+}
+
+inline const char* glue_read_json_lazy(glue_json_reader* reader, const char* field_path)
+{
+	return reader->read_json(field_path);
+}
+
+inline bool glue_read_b_lazy(glue_json_reader* reader, const char* field_path)
+{
+	return reader->read_b(field_path);
+}
+
+inline int glue_read_i_lazy(glue_json_reader* reader, const char* field_path)
+{
+	return reader->read_number<int>(field_path);
+}
+
+inline long long glue_read_l_lazy(glue_json_reader* reader, const char* field_path)
+{
+	return reader->read_number<long long>(field_path);
+}
+
+inline double glue_read_d_lazy(glue_json_reader* reader, const char* field_path)
+{
+	return reader->read_number<double>(field_path);
+}
+
+inline const char* glue_read_s_lazy(glue_json_reader* reader, const char* field_path)
+{
+	return reader->read_s(field_path);
+}
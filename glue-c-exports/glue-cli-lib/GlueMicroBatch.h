@@ -0,0 +1,363 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GlueCLILib.h"
+#include "GlueArena.h"
+#include "GlueJson.h"
+
+/*
+ * Micro-batching of stream pushes - opt-in per stream or branch.
+ *
+ * A glue_batching_publisher coalesces the pushes made within a short window into a single frame -
+ * one glue_push_payload carrying all of them - and subscribers unpack the frames back into the
+ * individual payloads:
+ *
+ *	// publisher - instead of glue_push_json_payload(stream, json)
+ *	glue_batching_publisher prices(stream);
+ *	prices.push_json(json);
+ *
+ *	// subscriber - instead of glue_subscribe_stream(...)
+ *	glue_batched_subscription subscription("prices", &on_price, cookie);
+ *
+ * A frame is sent once it holds max_messages pushes or its first push has waited for the window.
+ * The adaptive window follows the load: while pushes are sparse it is 0 and every push is sent
+ * right away, as is, so idle latency does not change; once pushes arrive faster than the window
+ * could collect, it grows up to max_delay, and it shrinks again whenever frames carry single pushes.
+ *
+ * Unpacked payloads are valid during the callback only and their reader is nullptr - read their args.
+ * Subscribers that do not unpack receive frames as a payload with a single composite array arg
+ * named glue_batch_field.
+ */
+
+/**
+ * \brief Name of the only arg of a frame - a composite array with the args of every push.
+ */
+constexpr const char* glue_batch_field = "__glue_batch";
+
+/**
+ * \brief Batching limits of a publisher.
+ */
+struct glue_batching_options
+{
+	// longest time a push waits for others to share its frame
+	std::chrono::microseconds max_delay{ 200 };
+	// pushes per frame - a full frame is sent right away
+	int max_messages = 64;
+	// adapt the window to the load - otherwise every push waits for up to max_delay
+	bool adaptive = true;
+};
+
+/**
+ * \brief Coalesces the pushes to a stream or a branch into frames - thread safe.
+ */
+class glue_batching_publisher
+{
+public:
+	/**
+	 * \param endpoint A stream registered via glue_register_streaming_endpoint or a branch opened via glue_open_streaming_branch.
+	 */
+	explicit glue_batching_publisher(const void* endpoint, const glue_batching_options& options = {})
+		: endpoint_(endpoint), options_(options), window_(options.adaptive ? std::chrono::microseconds(0) : options.max_delay)
+	{
+		thread_ = std::thread([this] { run(); });
+	}
+
+	glue_batching_publisher(const glue_batching_publisher&) = delete;
+	glue_batching_publisher& operator=(const glue_batching_publisher&) = delete;
+
+	/**
+	 * \brief Sends the pending frame and stops.
+	 */
+	~glue_batching_publisher()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		wake_.notify_one();
+		thread_.join();
+	}
+
+	/**
+	 * \brief Pushes args - copied, so they can be released once the call returns.
+	 * \return 0, or the result of glue_push_payload for pushes sent right away.
+	 */
+	int push(const glue_arg* args, int len)
+	{
+		return enqueue(
+			[&]
+			{
+				elements_.push_back(glue_arg{ nullptr, glv_comp(glue_arena_copy_args(arena_, args, len), args != nullptr ? len : 0) });
+				return 0;
+			},
+			[&] { return glue_push_payload(endpoint_, args, len); });
+	}
+
+	int push(const glue_payload* payload)
+	{
+		return push(payload->args, payload->args_len);
+	}
+
+	/**
+	 * \brief Pushes a JSON object (relaxed, as glue_push_json_payload).
+	 * \return 0, -1 if the JSON is not an object, or the result of glue_push_json_payload for pushes sent right away.
+	 */
+	int push_json(const char* json)
+	{
+		if (json == nullptr)
+		{
+			return -1;
+		}
+
+		return enqueue(
+			[&]
+			{
+				const glue_arg* args;
+				int len;
+				if (parser_.parse_args(arena_, json, strlen(json), args, len) != 0)
+				{
+					return -1;
+				}
+				elements_.push_back(glue_arg{ nullptr, glv_comp(const_cast<glue_arg*>(args), len) });
+				return 0;
+			},
+			[&] { return glue_push_json_payload(endpoint_, json); });
+	}
+
+	/**
+	 * \brief Sends the pending frame now.
+	 */
+	void flush()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		send();
+	}
+
+	long long pushes() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return pushes_;
+	}
+
+	/**
+	 * \brief Payloads sent - frames and pushes sent right away.
+	 */
+	long long sends() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return sends_;
+	}
+
+	std::chrono::microseconds window() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return window_;
+	}
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	template <typename Add, typename Send>
+	int enqueue(Add&& add, Send&& send_now)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		const auto now = clock::now();
+		adapt_to_push(now);
+		++pushes_;
+
+		if (elements_.empty() && window_.count() == 0)
+		{
+			// sent under the lock - frames sent meanwhile can not overtake it
+			++sends_;
+			return send_now();
+		}
+
+		if (add() != 0)
+		{
+			return -1;
+		}
+		if (elements_.size() == 1)
+		{
+			first_ = now;
+			wake_.notify_one();
+		}
+		if (static_cast<int>(elements_.size()) >= options_.max_messages)
+		{
+			send();
+		}
+		return 0;
+	}
+
+	/**
+	 * \brief Starts batching once pushes arrive faster than a quarter of max_delay - an average of the gaps between them.
+	 */
+	void adapt_to_push(clock::time_point now)
+	{
+		if (!options_.adaptive)
+		{
+			return;
+		}
+
+		const auto gap = std::chrono::duration_cast<std::chrono::microseconds>(now - last_push_);
+		last_push_ = now;
+		gap_ = gap >= options_.max_delay ? options_.max_delay : (gap_ * 7 + gap) / 8;
+		if (window_.count() == 0 && gap_ * 4 < options_.max_delay)
+		{
+			window_ = options_.max_delay / 4;
+		}
+	}
+
+	/**
+	 * \brief Grows the window while frames coalesce pushes, shrinks it for frames of a single push.
+	 */
+	void adapt_to_frame(size_t pushes)
+	{
+		if (!options_.adaptive)
+		{
+			return;
+		}
+
+		if (pushes > 1)
+		{
+			window_ = window_ * 2 < options_.max_delay ? window_ * 2 : options_.max_delay;
+		}
+		else
+		{
+			window_ /= 2;
+			if (window_ < options_.max_delay / 8)
+			{
+				window_ = std::chrono::microseconds(0);
+			}
+		}
+	}
+
+	/**
+	 * \brief Sends the pending frame - call with the mutex locked.
+	 */
+	void send()
+	{
+		if (elements_.empty())
+		{
+			return;
+		}
+
+		adapt_to_frame(elements_.size());
+		const auto frame = glarg_comps(glue_batch_field, elements_.data(), static_cast<int>(elements_.size()));
+		glue_push_payload(endpoint_, &frame, 1);
+		++sends_;
+		elements_.clear();
+		arena_.reset();
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!stopping_)
+		{
+			if (elements_.empty())
+			{
+				wake_.wait(lock);
+			}
+			else if (wake_.wait_until(lock, first_ + window_) == std::cv_status::timeout)
+			{
+				send();
+			}
+		}
+		send();
+	}
+
+	const void* endpoint_;
+	glue_batching_options options_;
+
+	// guarded by the mutex
+	mutable std::mutex mutex_;
+	std::condition_variable wake_;
+	bool stopping_ = false;
+	std::vector<glue_arg> elements_;
+	glue_arena arena_;
+	glue_json_parser parser_;
+	clock::time_point first_;
+	clock::time_point last_push_;
+	std::chrono::microseconds gap_{ 0 };
+	std::chrono::microseconds window_;
+	long long pushes_ = 0;
+	long long sends_ = 0;
+
+	std::thread thread_;
+};
+
+/**
+ * \brief True for frames of a glue_batching_publisher.
+ */
+inline bool glue_is_batch(const glue_payload* payload)
+{
+	return payload->args_len == 1 && payload->args[0].name != nullptr && strcmp(payload->args[0].name, glue_batch_field) == 0
+		&& payload->args[0].value.type == glue_type::glue_composite_array;
+}
+
+/**
+ * \brief Invokes a callback for each push of a frame - or once for payloads which are not frames.
+ */
+template <typename F>
+void glue_unbatch(const glue_payload* payload, F&& callback)
+{
+	if (!glue_is_batch(payload))
+	{
+		callback(payload);
+		return;
+	}
+
+	const auto& frame = payload->args[0].value;
+	for (int i = 0; i < frame.len; ++i)
+	{
+		const auto& push = frame.composite[i].value;
+		const glue_payload single{ nullptr, payload->origin, payload->status, push.composite, push.len > 0 ? push.len : 0 };
+		callback(&single);
+	}
+}
+
+/**
+ * \brief Subscription to a stream which unpacks frames - the callback gets every push separately.
+ * Destroy it (and so the subscription) before the callback's cookie.
+ */
+class glue_batched_subscription
+{
+public:
+	glue_batched_subscription(const char* stream, payload_function callback, COOKIE cookie, const glue_arg* args = nullptr, int len = 0)
+		: callback_(callback), cookie_(cookie)
+	{
+		subscription_ = glue_subscribe_stream(stream, &glue_batched_subscription::receive, args, len, this);
+	}
+
+	glue_batched_subscription(const glue_batched_subscription&) = delete;
+	glue_batched_subscription& operator=(const glue_batched_subscription&) = delete;
+
+	~glue_batched_subscription()
+	{
+		if (subscription_ != nullptr)
+		{
+			glue_destroy_resource(subscription_);
+		}
+	}
+
+	bool is_open() const
+	{
+		return subscription_ != nullptr;
+	}
+
+private:
+	static void receive(const char* origin, COOKIE cookie, const glue_payload* payload)
+	{
+		const auto self = static_cast<const glue_batched_subscription*>(cookie);
+		glue_unbatch(payload, [&](const glue_payload* single) { self->callback_(origin, self->cookie_, single); });
+	}
+
+	payload_function callback_;
+	COOKIE cookie_;
+	const void* subscription_ = nullptr;
+};
@@ -0,0 +1,419 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GlueCLILib.h"
+
+/*
+ * Precompiled field paths.
+ *
+ * glue_compile_path splits and hashes a dot-separated field path once; the glue_read_*_p
+ * functions then resolve the compiled path in Glue values and payloads without any string parsing:
+ *
+ *	static const auto display_name = glue_compile_path("data.contact.displayName");
+ *	const auto name = glue_read_s_p(payload, display_name);
+ *
+ * Wide composites are looked up linearly by name unless a glue_index_cache is passed - it lazily
+ * builds a hash index for composites that are wide or read more than once.
+ *
+ * The overloads for GlueCLILib's readers are a convenience only - GlueCLILib still parses the path.
+ */
+
+/**
+ * \brief A single segment of a compiled field path.
+ */
+struct glue_path_segment
+{
+	const char* name;
+	size_t len;
+	uint32_t hash;
+};
+
+/**
+ * \brief Compiled field path - treat as opaque, obtained by glue_compile_path.
+ */
+struct glue_path
+{
+	std::string text;
+	std::vector<glue_path_segment> segments;
+};
+
+/**
+ * \brief FNV-1a hash of a name of known length.
+ */
+inline uint32_t glue_hash_segment(const char* name, size_t len)
+{
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < len; ++i)
+	{
+		h = (h ^ static_cast<unsigned char>(name[i])) * 16777619u;
+	}
+	return h;
+}
+
+/**
+ * \brief Compiles a dot-separated field path - e.g. 'data.contact.displayName'.
+ * \param field_path The field path; nullptr or "" compile to the root path.
+ * \return Handle to the compiled path. Release it via glue_delete_path.
+ */
+inline const glue_path* glue_compile_path(const char* field_path)
+{
+	const auto path = new glue_path();
+	path->text = field_path != nullptr ? field_path : "";
+
+	const auto text = path->text.c_str();
+	const auto end = text + path->text.size();
+	for (auto segment = text; segment < end;)
+	{
+		auto dot = static_cast<const char*>(memchr(segment, '.', static_cast<size_t>(end - segment)));
+		if (dot == nullptr)
+		{
+			dot = end;
+		}
+
+		const auto len = static_cast<size_t>(dot - segment);
+		path->segments.push_back(glue_path_segment{ segment, len, glue_hash_segment(segment, len) });
+		segment = dot + 1;
+	}
+	return path;
+}
+
+/**
+ * \brief Releases a path compiled via glue_compile_path.
+ */
+inline void glue_delete_path(const glue_path* path)
+{
+	delete path;
+}
+
+/**
+ * \brief Finds a named Glue value in a composite by a compiled path segment.
+ */
+inline const glue_value* glue_find_arg(const glue_arg* args, int len, const glue_path_segment& segment)
+{
+	for (int i = 0; i < len; ++i)
+	{
+		const auto name = args[i].name;
+		if (name != nullptr && name[0] == segment.name[0] && strncmp(name, segment.name, segment.len) == 0 && name[segment.len] == 0)
+		{
+			return &args[i].value;
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * \brief Open addressing side index of a composite - maps name hashes to arg indexes.
+ */
+class glue_composite_index
+{
+public:
+	void build(const glue_arg* args, int len)
+	{
+		args_ = args;
+		len_ = len;
+		fingerprint(args, len, fingerprint_);
+
+		size_t capacity = 4;
+		while (capacity < static_cast<size_t>(len) * 2)
+		{
+			capacity *= 2;
+		}
+		slots_.assign(capacity, slot{ 0, -1 });
+
+		const auto mask = capacity - 1;
+		for (int i = 0; i < len; ++i)
+		{
+			const auto name = args[i].name;
+			if (name == nullptr)
+			{
+				continue;
+			}
+
+			// linear probing keeps the first of duplicate names first in the chain - as a linear scan would find it
+			const auto hash = glue_hash_segment(name, strlen(name));
+			auto s = hash & mask;
+			while (slots_[s].index >= 0)
+			{
+				s = (s + 1) & mask;
+			}
+			slots_[s] = slot{ hash, i };
+		}
+	}
+
+	/**
+	 * \brief Gets the index of the arg named as the segment or -1.
+	 */
+	int find(const glue_path_segment& segment) const
+	{
+		const auto mask = slots_.size() - 1;
+		for (auto s = segment.hash & mask; slots_[s].index >= 0; s = (s + 1) & mask)
+		{
+			if (slots_[s].hash != segment.hash)
+			{
+				continue;
+			}
+
+			// the composite may have been replaced since - a name gone is a mismatch
+			const auto name = args_[slots_[s].index].name;
+			if (name != nullptr && strncmp(name, segment.name, segment.len) == 0 && name[segment.len] == 0)
+			{
+				return slots_[s].index;
+			}
+		}
+		return -1;
+	}
+
+	/**
+	 * \brief Tells whether the index was built for the composite - same args array, same width and the
+	 * same name pointers at the first, middle and last fields.
+	 */
+	bool matches(const glue_arg* args, int len) const
+	{
+		if (args != args_ || len != len_)
+		{
+			return false;
+		}
+
+		const char* names[fingerprint_size];
+		fingerprint(args, len, names);
+		return std::equal(names, names + fingerprint_size, fingerprint_);
+	}
+
+private:
+	struct slot
+	{
+		uint32_t hash;
+		int index;
+	};
+
+	static constexpr int fingerprint_size = 3;
+
+	static void fingerprint(const glue_arg* args, int len, const char* names[])
+	{
+		names[0] = len > 0 ? args[0].name : nullptr;
+		names[1] = len > 0 ? args[len / 2].name : nullptr;
+		names[2] = len > 0 ? args[len - 1].name : nullptr;
+	}
+
+	const glue_arg* args_ = nullptr;
+	int len_ = 0;
+	const char* fingerprint_[fingerprint_size] = {};
+	std::vector<slot> slots_;
+};
+
+/**
+ * \brief Lazily built side indexes of composites, keyed by their args array.
+ * Composites narrower than narrow_width are always scanned. Wider composites get an index once
+ * they are read for the second time, or straight away when at least wide_width fields wide.
+ * A different composite reusing the address is told apart by its width and a fingerprint of its
+ * name pointers, and its index rebuilt. Lookups verify the names they find, so a replacement the
+ * fingerprint misses costs a linear scan, never a wrong value - still, clear() the cache when the
+ * indexed values are released to keep it small.
+ * Not thread safe - use one cache per reading thread.
+ */
+class glue_index_cache
+{
+public:
+	static constexpr int narrow_width = 8;
+	static constexpr int wide_width = 32;
+
+	explicit glue_index_cache(size_t max_entries = 4096) : max_entries_(max_entries)
+	{
+	}
+
+	/**
+	 * \brief Finds a named Glue value in a composite by a compiled path segment.
+	 */
+	const glue_value* find(const glue_arg* args, int len, const glue_path_segment& segment)
+	{
+		if (len < narrow_width)
+		{
+			return glue_find_arg(args, len, segment);
+		}
+
+		if (entries_.size() >= max_entries_ && entries_.find(args) == entries_.end())
+		{
+			entries_.clear();
+		}
+
+		auto& e = entries_[args];
+		if (!e.indexed || !e.index.matches(args, len))
+		{
+			if (++e.reads < 2 && len < wide_width)
+			{
+				return glue_find_arg(args, len, segment);
+			}
+			e.index.build(args, len);
+			e.indexed = true;
+		}
+
+		const auto i = e.index.find(segment);
+		if (i >= 0)
+		{
+			return &args[i].value;
+		}
+
+		// missing from the index - verify the composite has not been replaced at the same address
+		const auto v = glue_find_arg(args, len, segment);
+		if (v != nullptr)
+		{
+			e.index.build(args, len);
+		}
+		return v;
+	}
+
+	void clear()
+	{
+		entries_.clear();
+	}
+
+	size_t size() const
+	{
+		return entries_.size();
+	}
+
+private:
+	struct entry
+	{
+		int reads = 0;
+		bool indexed = false;
+		glue_composite_index index;
+	};
+
+	size_t max_entries_;
+	std::unordered_map<const glue_arg*, entry> entries_;
+};
+
+/**
+ * \brief Finds a named Glue value in a composite - through the cache's index if a cache is given.
+ */
+inline const glue_value* glue_find_arg(const glue_arg* args, int len, const glue_path_segment& segment, glue_index_cache* cache)
+{
+	return cache != nullptr ? cache->find(args, len, segment) : glue_find_arg(args, len, segment);
+}
+
+/**
+ * \brief Resolves a compiled path in an array of named Glue values.
+ * \return The value at the path or nullptr if there is no such field. The root path has no single value and yields nullptr.
+ */
+inline const glue_value* glue_find_p(const glue_arg* args, int len, const glue_path* path, glue_index_cache* cache = nullptr)
+{
+	const glue_value* found = nullptr;
+	for (const auto& segment : path->segments)
+	{
+		if (found != nullptr)
+		{
+			if (found->type != glue_type::glue_composite || found->len < 0)
+			{
+				return nullptr;
+			}
+			args = found->composite;
+			len = found->len;
+		}
+
+		found = glue_find_arg(args, len, segment, cache);
+		if (found == nullptr)
+		{
+			return nullptr;
+		}
+	}
+	return found;
+}
+
+/**
+ * \brief Resolves a compiled path in a composite Glue value.
+ * \return The value at the path, the value itself for the root path or nullptr.
+ */
+inline const glue_value* glue_find_p(const glue_value& root, const glue_path* path, glue_index_cache* cache = nullptr)
+{
+	if (path->segments.empty())
+	{
+		return &root;
+	}
+	if (root.type != glue_type::glue_composite || root.len < 0)
+	{
+		return nullptr;
+	}
+	return glue_find_p(root.composite, root.len, path, cache);
+}
+
+// reading by compiled path from Glue values and payloads - no string parsing involved
+
+inline glue_value glue_read_glue_value_p(const glue_value& root, const glue_path* path, glue_index_cache* cache = nullptr)
+{
+	const auto v = glue_find_p(root, path, cache);
+	return v != nullptr ? *v : glue_value{};
+}
+
+inline glue_value glue_read_glue_value_p(const glue_payload* payload, const glue_path* path, glue_index_cache* cache = nullptr)
+{
+	if (path->segments.empty())
+	{
+		return glv_comp(const_cast<glue_arg*>(payload->args), payload->args_len);
+	}
+	const auto v = glue_find_p(payload->args, payload->args_len, path, cache);
+	return v != nullptr ? *v : glue_value{};
+}
+
+#define PATH_READ_BUILD(T, N, V, GT) \
+ inline T N(const glue_value& root, const glue_path* path, glue_index_cache* cache = nullptr) \
+ {\
+	const auto v = glue_find_p(root, path, cache);\
+	return v != nullptr && v->type == glue_type::GT && v->len < 0 ? v->V : static_cast<T>(0);\
+ }\
+ inline T N(const glue_payload* payload, const glue_path* path, glue_index_cache* cache = nullptr) \
+ {\
+	const auto v = glue_find_p(payload->args, payload->args_len, path, cache);\
+	return v != nullptr && v->type == glue_type::GT && v->len < 0 ? v->V : static_cast<T>(0);\
+ }
+
+PATH_READ_BUILD(bool, glue_read_b_p, b, glue_bool);
+PATH_READ_BUILD(int, glue_read_i_p, i, glue_int);
+PATH_READ_BUILD(long long, glue_read_l_p, l, glue_long);
+PATH_READ_BUILD(double, glue_read_d_p, d, glue_double);
+PATH_READ_BUILD(const char*, glue_read_s_p, s, glue_string);
+
+// reading by compiled path from readers - a convenience only
+// The readers are resolved by GlueCLILib itself, which parses the path text on every read as for
+// glue_read_*; these only let a compiled path be used for readers too. Nothing is saved over
+// passing the path string.
+
+inline glue_value glue_read_glue_value_p(const void* reader, const glue_path* path)
+{
+	return glue_read_glue_value(reader, path->text.c_str());
+}
+
+inline const char* glue_read_json_p(const void* reader, const glue_path* path)
+{
+	return glue_read_json(reader, path->text.c_str());
+}
+
+inline bool glue_read_b_p(const void* reader, const glue_path* path)
+{
+	return glue_read_b(reader, path->text.c_str());
+}
+
+inline int glue_read_i_p(const void* reader, const glue_path* path)
+{
+	return glue_read_i(reader, path->text.c_str());
+}
+
+inline long long glue_read_l_p(const void* reader, const glue_path* path)
+{
+	return glue_read_l(reader, path->text.c_str());
+}
+
+inline double glue_read_d_p(const void* reader, const glue_path* path)
+{
+	return glue_read_d(reader, path->text.c_str());
+}
+
+inline const char* glue_read_s_p(const void* reader, const glue_path* path)
+{
+	return glue_read_s(reader, path->text.c_str());
+}
@@ -0,0 +1,251 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "GlueCLILib.h"
+
+/*
+ * Pipelined invocations - thousands of glue_invoke calls outstanding at once.
+ *
+ * A glue_pipelined_invoker gives every invocation an id, passes the id to glue_invoke as the cookie
+ * and matches the results back to their callbacks through a lock-free, open-addressed correlation
+ * table. Invoking and completing never take a lock, and results complete in whatever order they
+ * arrive - a slow request does not hold up the ones behind it:
+ *
+ *	glue_pipelined_invoker invoker(10000);			// at most 10000 invocations in flight
+ *	if (invoker.invoke("Pricing", args, len, &on_price, request) < 0)
+ *	{
+ *		// 10000 are in flight already - or glue_invoke failed
+ *	}
+ *
+ * Callbacks are invoked on the Glue thread, as for glue_invoke. Destroy an invoker only once it is
+ * idle - every result delivered.
+ */
+
+class glue_pipelined_invoker;
+
+/**
+ * \brief The process-wide correlation table - request ids to the callbacks of their results.
+ *
+ * Slots are claimed by a CAS of their id from 0 and released by a CAS back to 0. The low bits of an id
+ * are the index of its slot and the high bits a sequence number, so taking an id - or finding it gone -
+ * looks at a single slot, and released slots need neither tombstones nor moving other entries.
+ * Adding probes for a free slot from a home slot hashed from the sequence number: sequential home
+ * slots would pile up into long runs behind any requests outstanding for long.
+ */
+class glue_correlation_table
+{
+public:
+	struct entry
+	{
+		payload_function callback;
+		COOKIE cookie;
+		glue_pipelined_invoker* owner;
+	};
+
+	static constexpr int capacity_bits = 16;
+	// at most half the slots are in use at any time - keeping the probes short
+	static constexpr size_t capacity = size_t(1) << capacity_bits;
+
+	static glue_correlation_table& instance()
+	{
+		static glue_correlation_table table;
+		return table;
+	}
+
+	/**
+	 * \brief Adds an entry.
+	 * \return Its id - or 0 if the table is full.
+	 */
+	uintptr_t add(const entry& e)
+	{
+		if (used_.fetch_add(1, std::memory_order_relaxed) >= capacity / 2)
+		{
+			used_.fetch_sub(1, std::memory_order_relaxed);
+			return 0;
+		}
+
+		uintptr_t sequence;
+		do
+		{
+			sequence = next_sequence_.fetch_add(1, std::memory_order_relaxed);
+		} while ((sequence << capacity_bits) == 0);
+
+		for (auto i = home(sequence);; ++i)
+		{
+			const auto index = i & (capacity - 1);
+			const auto id = (sequence << capacity_bits) | index;
+			auto& slot = slots_[index];
+			uintptr_t empty = 0;
+			if (slot.id.load(std::memory_order_relaxed) == 0 && slot.id.compare_exchange_strong(empty, id, std::memory_order_acquire))
+			{
+				// read by take() only, for a result of this id - which can not arrive before add returns it
+				slot.value = e;
+				return id;
+			}
+		}
+	}
+
+	/**
+	 * \brief Removes the entry of an id.
+	 * \return False if there is none (its result was already taken).
+	 */
+	bool take(uintptr_t id, entry& e)
+	{
+		if (id == 0)
+		{
+			return false;
+		}
+
+		auto& slot = slots_[id & (capacity - 1)];
+		if (slot.id.load(std::memory_order_acquire) != id)
+		{
+			return false;
+		}
+
+		// a result taken twice at once - only one of them wins the slot, the value copied by the other is discarded
+		const auto value = slot.value;
+		auto expected = id;
+		if (!slot.id.compare_exchange_strong(expected, 0, std::memory_order_acq_rel))
+		{
+			return false;
+		}
+		e = value;
+		used_.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+private:
+	struct slot
+	{
+		std::atomic<uintptr_t> id{ 0 };
+		entry value{};
+	};
+
+	glue_correlation_table() : slots_(new slot[capacity])
+	{
+	}
+
+	/**
+	 * \brief Fibonacci hashing - the top bits of the sequence number times 2^64 / phi.
+	 */
+	static size_t home(uintptr_t sequence)
+	{
+		return static_cast<size_t>((static_cast<uint64_t>(sequence) * 0x9E3779B97F4A7C15ull) >> (64 - capacity_bits));
+	}
+
+	std::unique_ptr<slot[]> slots_;
+	std::atomic<size_t> used_{ 0 };
+	std::atomic<uintptr_t> next_sequence_{ 1 };
+};
+
+/**
+ * \brief Invokes endpoints with a bounded number of invocations in flight - thread safe.
+ */
+class glue_pipelined_invoker
+{
+public:
+	explicit glue_pipelined_invoker(int max_in_flight = 1024) : max_in_flight_(max_in_flight)
+	{
+	}
+
+	glue_pipelined_invoker(const glue_pipelined_invoker&) = delete;
+	glue_pipelined_invoker& operator=(const glue_pipelined_invoker&) = delete;
+
+	/**
+	 * \brief Invokes an endpoint - as glue_invoke, the callback gets the result along with its cookie.
+	 * \return The id of the invocation, or -1 if max_in_flight invocations are in flight, the correlation table is full or glue_invoke failed.
+	 */
+	long long invoke(const char* endpoint_name, const glue_arg* args, int len, payload_function callback = nullptr, COOKIE cookie = nullptr)
+	{
+		if (in_flight_.fetch_add(1, std::memory_order_acq_rel) >= max_in_flight_)
+		{
+			in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+			return -1;
+		}
+		pending_.fetch_add(1, std::memory_order_relaxed);
+
+		auto& table = glue_correlation_table::instance();
+		const auto id = table.add(glue_correlation_table::entry{ callback, cookie, this });
+		if (id == 0)
+		{
+			release();
+			return -1;
+		}
+
+		invoked_.fetch_add(1, std::memory_order_relaxed);
+		if (glue_invoke(endpoint_name, args, len, &glue_pipelined_invoker::complete, reinterpret_cast<COOKIE>(id)) != 0)
+		{
+			glue_correlation_table::entry e;
+			if (table.take(id, e))
+			{
+				invoked_.fetch_sub(1, std::memory_order_relaxed);
+				release();
+			}
+			return -1;
+		}
+		return static_cast<long long>(id);
+	}
+
+	int in_flight() const
+	{
+		return in_flight_.load(std::memory_order_acquire);
+	}
+
+	int max_in_flight() const
+	{
+		return max_in_flight_;
+	}
+
+	long long invoked() const
+	{
+		return invoked_.load(std::memory_order_relaxed);
+	}
+
+	long long completed() const
+	{
+		return completed_.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * \brief True once the results of all invocations made have been delivered - their callbacks returned.
+	 */
+	bool idle() const
+	{
+		return pending_.load(std::memory_order_acquire) == 0;
+	}
+
+private:
+	static void complete(const char* origin, COOKIE cookie, const glue_payload* payload)
+	{
+		glue_correlation_table::entry e;
+		if (!glue_correlation_table::instance().take(reinterpret_cast<uintptr_t>(cookie), e))
+		{
+			return;
+		}
+
+		// room for the next invocation - callbacks often make it
+		e.owner->in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+		if (e.callback != nullptr)
+		{
+			e.callback(origin, e.cookie, payload);
+		}
+		e.owner->completed_.fetch_add(1, std::memory_order_relaxed);
+		// the last use of the invoker
+		e.owner->pending_.fetch_sub(1, std::memory_order_release);
+	}
+
+	void release()
+	{
+		in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+		pending_.fetch_sub(1, std::memory_order_release);
+	}
+
+	const int max_in_flight_;
+	std::atomic<int> in_flight_{ 0 };
+	// in flight or in their callbacks
+	std::atomic<int> pending_{ 0 };
+	std::atomic<long long> invoked_{ 0 };
+	std::atomic<long long> completed_{ 0 };
+};
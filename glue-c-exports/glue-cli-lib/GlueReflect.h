@@ -0,0 +1,752 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "GlueCLILib.h"
+#include "GlueArena.h"
+
+/*
+ * Compile-time mapping between C++ structs and Glue values.
+ *
+ * Describe the fields of a struct once, at namespace scope:
+ *
+ *	struct contact { std::string name; int age; std::vector<double> scores; };
+ *	GLUE_FIELDS(contact, name, age, scores);
+ *
+ * and then build its payload with glue_encode(arena, value) - the resulting glue_arg array has
+ * a statically known length and its names are compile-time constants.
+ * glue_decode<contact>(payload) fills the struct back in a single pass over the payload's args.
+ *
+ * Type mapping:
+ *	bool, int (and narrower integers), long long (and 64 bit integers), double (and float),
+ *	const char* and std::string, std::chrono::system_clock::time_point (glue_datetime, ms since epoch),
+ *	reflected structs (glue_composite), std::vector of scalars/strings/time points (arrays),
+ *	std::vector of reflected structs (glue_composite_array) and std::tuple (glue_tuple).
+ */
+
+/**
+ * \brief Describes a single reflected field - its Glue name and the pointer to the member.
+ */
+template <typename T, typename M>
+struct glue_field
+{
+	using member_type = M;
+
+	const char* name;
+	M T::* member;
+};
+
+/**
+ * \brief Specialized by GLUE_FIELDS for every reflected struct.
+ * Exposes 'fields' - a constexpr tuple of glue_field descriptors, and 'count'.
+ */
+template <typename T>
+struct glue_fields;
+
+template <typename T, typename = void>
+struct glue_is_reflected : std::false_type
+{
+};
+
+template <typename T>
+struct glue_is_reflected<T, std::void_t<decltype(glue_fields<T>::count)>> : std::true_type
+{
+};
+
+// field list expansion - the extra GLUE_EXPAND passes are needed by the MSVC traditional preprocessor
+
+#define GLUE_EXPAND(x) x
+#define GLUE_FIELD_DESC(T, f) glue_field<T, decltype(T::f)>{ #f, &T::f }
+
+#define GLUE_FE_1(M, T, a) M(T, a)
+#define GLUE_FE_2(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_1(M, T, __VA_ARGS__))
+#define GLUE_FE_3(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_2(M, T, __VA_ARGS__))
+#define GLUE_FE_4(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_3(M, T, __VA_ARGS__))
+#define GLUE_FE_5(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_4(M, T, __VA_ARGS__))
+#define GLUE_FE_6(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_5(M, T, __VA_ARGS__))
+#define GLUE_FE_7(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_6(M, T, __VA_ARGS__))
+#define GLUE_FE_8(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_7(M, T, __VA_ARGS__))
+#define GLUE_FE_9(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_8(M, T, __VA_ARGS__))
+#define GLUE_FE_10(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_9(M, T, __VA_ARGS__))
+#define GLUE_FE_11(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_10(M, T, __VA_ARGS__))
+#define GLUE_FE_12(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_11(M, T, __VA_ARGS__))
+#define GLUE_FE_13(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_12(M, T, __VA_ARGS__))
+#define GLUE_FE_14(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_13(M, T, __VA_ARGS__))
+#define GLUE_FE_15(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_14(M, T, __VA_ARGS__))
+#define GLUE_FE_16(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_15(M, T, __VA_ARGS__))
+#define GLUE_FE_17(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_16(M, T, __VA_ARGS__))
+#define GLUE_FE_18(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_17(M, T, __VA_ARGS__))
+#define GLUE_FE_19(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_18(M, T, __VA_ARGS__))
+#define GLUE_FE_20(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_19(M, T, __VA_ARGS__))
+#define GLUE_FE_21(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_20(M, T, __VA_ARGS__))
+#define GLUE_FE_22(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_21(M, T, __VA_ARGS__))
+#define GLUE_FE_23(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_22(M, T, __VA_ARGS__))
+#define GLUE_FE_24(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_23(M, T, __VA_ARGS__))
+#define GLUE_FE_25(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_24(M, T, __VA_ARGS__))
+#define GLUE_FE_26(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_25(M, T, __VA_ARGS__))
+#define GLUE_FE_27(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_26(M, T, __VA_ARGS__))
+#define GLUE_FE_28(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_27(M, T, __VA_ARGS__))
+#define GLUE_FE_29(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_28(M, T, __VA_ARGS__))
+#define GLUE_FE_30(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_29(M, T, __VA_ARGS__))
+#define GLUE_FE_31(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_30(M, T, __VA_ARGS__))
+#define GLUE_FE_32(M, T, a, ...) M(T, a), GLUE_EXPAND(GLUE_FE_31(M, T, __VA_ARGS__))
+
+#define GLUE_FE_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, \
+	_17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ...) N
+
+#define GLUE_FOR_EACH(M, T, ...) GLUE_EXPAND(GLUE_FE_PICK(__VA_ARGS__, \
+	GLUE_FE_32, GLUE_FE_31, GLUE_FE_30, GLUE_FE_29, GLUE_FE_28, GLUE_FE_27, GLUE_FE_26, GLUE_FE_25, \
+	GLUE_FE_24, GLUE_FE_23, GLUE_FE_22, GLUE_FE_21, GLUE_FE_20, GLUE_FE_19, GLUE_FE_18, GLUE_FE_17, \
+	GLUE_FE_16, GLUE_FE_15, GLUE_FE_14, GLUE_FE_13, GLUE_FE_12, GLUE_FE_11, GLUE_FE_10, GLUE_FE_9, \
+	GLUE_FE_8, GLUE_FE_7, GLUE_FE_6, GLUE_FE_5, GLUE_FE_4, GLUE_FE_3, GLUE_FE_2, GLUE_FE_1)(M, T, __VA_ARGS__))
+
+/**
+ * \brief Reflects up to 32 fields of a struct - use at global namespace scope.
+ * The Glue names of the fields are the member names.
+ */
+#define GLUE_FIELDS(T, ...) \
+ template <> \
+ struct glue_fields<T> \
+ {\
+	static constexpr auto fields = std::make_tuple(GLUE_FOR_EACH(GLUE_FIELD_DESC, T, __VA_ARGS__));\
+	static constexpr size_t count = std::tuple_size<decltype(fields)>::value;\
+ }
+
+// compile-time type mapping
+
+template <typename T>
+struct glue_is_vector : std::false_type
+{
+};
+
+template <typename T, typename A>
+struct glue_is_vector<std::vector<T, A>> : std::true_type
+{
+};
+
+template <typename T>
+struct glue_is_tuple : std::false_type
+{
+};
+
+template <typename... T>
+struct glue_is_tuple<std::tuple<T...>> : std::true_type
+{
+};
+
+using glue_time_point = std::chrono::system_clock::time_point;
+
+template <typename T>
+constexpr bool glue_is_string_v = std::is_same<T, std::string>::value || std::is_same<T, const char*>::value;
+
+template <typename T>
+constexpr bool glue_is_int_v = std::is_integral<T>::value && !std::is_same<T, bool>::value && sizeof(T) <= sizeof(int);
+
+template <typename T>
+constexpr bool glue_is_long_v = std::is_integral<T>::value && !std::is_same<T, bool>::value && sizeof(T) > sizeof(int);
+
+/**
+ * \brief The glue_type a C++ type maps to - for std::vector this is the element's glue_type
+ * (or glue_composite_array for vectors of reflected structs), matching how the C API tags arrays.
+ */
+template <typename T>
+constexpr glue_type glue_type_of()
+{
+	if constexpr (std::is_same<T, bool>::value)
+	{
+		return glue_type::glue_bool;
+	}
+	else if constexpr (glue_is_int_v<T>)
+	{
+		return glue_type::glue_int;
+	}
+	else if constexpr (glue_is_long_v<T>)
+	{
+		return glue_type::glue_long;
+	}
+	else if constexpr (std::is_floating_point<T>::value)
+	{
+		return glue_type::glue_double;
+	}
+	else if constexpr (glue_is_string_v<T>)
+	{
+		return glue_type::glue_string;
+	}
+	else if constexpr (std::is_same<T, glue_time_point>::value)
+	{
+		return glue_type::glue_datetime;
+	}
+	else if constexpr (glue_is_tuple<T>::value)
+	{
+		return glue_type::glue_tuple;
+	}
+	else if constexpr (glue_is_reflected<T>::value)
+	{
+		return glue_type::glue_composite;
+	}
+	else if constexpr (glue_is_vector<T>::value)
+	{
+		using E = typename T::value_type;
+		static_assert(!glue_is_vector<E>::value && !glue_is_tuple<E>::value, "nested arrays are not supported by Glue values");
+		return glue_is_reflected<E>::value ? glue_type::glue_composite_array : glue_type_of<E>();
+	}
+	else
+	{
+		static_assert(sizeof(T) == 0, "type has no glue_type mapping - reflect it with GLUE_FIELDS");
+		return glue_type::glue_none;
+	}
+}
+
+inline long long glue_to_epoch_ms(const glue_time_point& t)
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+}
+
+inline glue_time_point glue_from_epoch_ms(long long ms)
+{
+	return glue_time_point(std::chrono::duration_cast<glue_time_point::duration>(std::chrono::milliseconds(ms)));
+}
+
+inline const char* glue_c_str(const std::string& s)
+{
+	return s.c_str();
+}
+
+inline const char* glue_c_str(const char* s)
+{
+	return s;
+}
+
+template <typename T>
+glue_value glue_encode_value(glue_arena& arena, const T& v);
+
+template <typename T>
+void glue_encode_fields(glue_arena& arena, const T& obj, glue_arg* args);
+
+template <typename T, size_t... I>
+glue_value glue_encode_tuple(glue_arena& arena, const T& t, std::index_sequence<I...>)
+{
+	constexpr auto len = sizeof...(I);
+	const auto values = arena.alloc<glue_value>(len);
+	((values[I] = glue_encode_value(arena, std::get<I>(t))), ...);
+	return glv_tuple(values, static_cast<int>(len));
+}
+
+inline glue_value glue_value_of_array(int* items, int len)
+{
+	return glv_ii(items, len);
+}
+
+inline glue_value glue_value_of_array(long long* items, int len)
+{
+	return glv_ll(items, len);
+}
+
+inline glue_value glue_value_of_array(double* items, int len)
+{
+	return glv_dd(items, len);
+}
+
+/**
+ * \brief True for element types stored exactly as the Glue arrays store them (ii/ll/dd).
+ */
+template <typename E>
+constexpr bool glue_is_shared_layout_v = std::is_same<E, int>::value || std::is_same<E, long long>::value || std::is_same<E, double>::value;
+
+template <typename E, typename A>
+glue_value glue_encode_vector(glue_arena& arena, const std::vector<E, A>& v)
+{
+	const auto len = static_cast<int>(v.size());
+	constexpr auto type = glue_type_of<E>();
+
+	if constexpr (glue_is_reflected<E>::value)
+	{
+		const auto rows = arena.alloc<glue_arg>(v.size());
+		for (size_t i = 0; i < v.size(); ++i)
+		{
+			const auto row = arena.alloc<glue_arg>(glue_fields<E>::count);
+			glue_encode_fields(arena, v[i], row);
+			rows[i] = glarg_comp("", row, static_cast<int>(glue_fields<E>::count));
+		}
+		return glv_comps(rows, len);
+	}
+	else if constexpr (type == glue_type::glue_string)
+	{
+		const auto items = arena.alloc<const char*>(v.size());
+		for (size_t i = 0; i < v.size(); ++i)
+		{
+			items[i] = glue_c_str(v[i]);
+		}
+		return glv_ss(items, len);
+	}
+	else if constexpr (glue_is_shared_layout_v<E>)
+	{
+		// reference the vector's storage directly
+		return glue_value_of_array(const_cast<E*>(v.data()), len);
+	}
+	else
+	{
+		// element layout differs from the Glue array layout (std::vector<bool>, narrower numbers, time points) - convert into the arena
+		using G = std::conditional_t<type == glue_type::glue_bool, bool,
+			std::conditional_t<type == glue_type::glue_int, int,
+			std::conditional_t<type == glue_type::glue_double, double, long long>>>;
+		const auto items = arena.alloc<G>(v.size());
+		for (size_t i = 0; i < v.size(); ++i)
+		{
+			if constexpr (std::is_same<E, glue_time_point>::value)
+			{
+				items[i] = glue_to_epoch_ms(v[i]);
+			}
+			else
+			{
+				items[i] = static_cast<G>(v[i]);
+			}
+		}
+
+		glue_value val{};
+		if constexpr (type == glue_type::glue_bool)
+		{
+			val.bb = items;
+		}
+		else if constexpr (type == glue_type::glue_int)
+		{
+			val.ii = items;
+		}
+		else if constexpr (type == glue_type::glue_double)
+		{
+			val.dd = items;
+		}
+		else
+		{
+			val.ll = items;
+		}
+		val.type = type;
+		val.len = len;
+		return val;
+	}
+}
+
+/**
+ * \brief Encodes a single C++ value as a Glue value.
+ * Strings and same-layout numeric vectors reference the source's storage, so the source must
+ * outlive the push; everything else that needs storage is allocated from the arena.
+ */
+template <typename T>
+glue_value glue_encode_value(glue_arena& arena, const T& v)
+{
+	constexpr auto type = glue_type_of<T>();
+
+	if constexpr (glue_is_vector<T>::value)
+	{
+		return glue_encode_vector(arena, v);
+	}
+	else if constexpr (type == glue_type::glue_bool)
+	{
+		return glv_b(v);
+	}
+	else if constexpr (type == glue_type::glue_int)
+	{
+		return glv_i(static_cast<int>(v));
+	}
+	else if constexpr (type == glue_type::glue_long)
+	{
+		return glv_l(static_cast<long long>(v));
+	}
+	else if constexpr (type == glue_type::glue_double)
+	{
+		return glv_d(static_cast<double>(v));
+	}
+	else if constexpr (type == glue_type::glue_string)
+	{
+		return glv_s(glue_c_str(v));
+	}
+	else if constexpr (type == glue_type::glue_datetime)
+	{
+		return glv_dt(glue_to_epoch_ms(v));
+	}
+	else if constexpr (type == glue_type::glue_tuple)
+	{
+		return glue_encode_tuple(arena, v, std::make_index_sequence<std::tuple_size<T>::value>());
+	}
+	else
+	{
+		const auto args = arena.alloc<glue_arg>(glue_fields<T>::count);
+		glue_encode_fields(arena, v, args);
+		return glv_comp(args, static_cast<int>(glue_fields<T>::count));
+	}
+}
+
+template <typename T, size_t... I>
+void glue_encode_fields(glue_arena& arena, const T& obj, glue_arg* args, std::index_sequence<I...>)
+{
+	constexpr auto& fields = glue_fields<T>::fields;
+	((args[I] = glue_arg{ std::get<I>(fields).name, glue_encode_value(arena, obj.*(std::get<I>(fields).member)) }), ...);
+}
+
+template <typename T>
+void glue_encode_fields(glue_arena& arena, const T& obj, glue_arg* args)
+{
+	glue_encode_fields(arena, obj, args, std::make_index_sequence<glue_fields<T>::count>());
+}
+
+/**
+ * \brief Encodes a reflected struct as a payload - one glue_arg per reflected field.
+ * \param arena Storage for nested composites/tuples and converted arrays.
+ * \param obj The struct to be encoded - must outlive the use of the result.
+ * \return glue_arg array with a length known at compile time - pass to glue_push_payload.
+ */
+template <typename T>
+std::array<glue_arg, glue_fields<T>::count> glue_encode(glue_arena& arena, const T& obj)
+{
+	std::array<glue_arg, glue_fields<T>::count> args;
+	glue_encode_fields(arena, obj, args.data());
+	return args;
+}
+
+/**
+ * \brief Encodes a reflected struct and pushes it to an endpoint, resetting the arena afterwards.
+ * \return 0 if the args were pushed successfully.
+ */
+template <typename T, typename = std::enable_if_t<glue_is_reflected<T>::value>>
+int glue_push_payload(const void* endpoint, const T& obj, glue_arena& arena)
+{
+	const auto args = glue_encode(arena, obj);
+	return glue_push_payload(endpoint, args.data(), static_cast<int>(args.size()), arena);
+}
+
+// decoding
+
+/**
+ * \brief FNV-1a hash of a field name mixed with a seed - usable at compile time and at runtime.
+ */
+constexpr uint32_t glue_hash_name(const char* name, uint32_t seed)
+{
+	uint32_t h = 2166136261u ^ seed;
+	for (; *name != 0; ++name)
+	{
+		h = (h ^ static_cast<unsigned char>(*name)) * 16777619u;
+	}
+	return h ^ (h >> 15);
+}
+
+/**
+ * \brief glue_hash_name of a name that is not null terminated - e.g. a key inside a JSON text.
+ */
+constexpr uint32_t glue_hash_name(const char* name, size_t len, uint32_t seed)
+{
+	uint32_t h = 2166136261u ^ seed;
+	for (size_t i = 0; i < len; ++i)
+	{
+		h = (h ^ static_cast<unsigned char>(name[i])) * 16777619u;
+	}
+	return h ^ (h >> 15);
+}
+
+constexpr bool glue_names_equal(const char* a, const char* b)
+{
+	for (; *a != 0 && *a == *b; ++a, ++b)
+	{
+	}
+	return *a == *b;
+}
+
+/**
+ * \brief Smallest power of 2 with at least twice as many slots as names.
+ */
+constexpr size_t glue_hash_table_size(size_t names)
+{
+	size_t size = 2;
+	while (size < names * 2)
+	{
+		size *= 2;
+	}
+	return size;
+}
+
+/**
+ * \brief Collision-free hash table from field names to field indexes, computed at compile time.
+ */
+template <size_t N>
+struct glue_perfect_hash
+{
+	static constexpr size_t size = glue_hash_table_size(N);
+
+	uint32_t seed = 0;
+	// slot -> field index + 1, 0 for empty slots
+	std::array<unsigned char, size> slots{};
+
+	/**
+	 * \brief Gets the index of the field with that name or -1.
+	 */
+	int find(const char* name, const std::array<const char*, N>& names) const
+	{
+		const auto slot = slots[glue_hash_name(name, seed) & (size - 1)];
+		return slot != 0 && strcmp(names[slot - 1], name) == 0 ? slot - 1 : -1;
+	}
+
+	int find(const char* name, size_t len, const std::array<const char*, N>& names) const
+	{
+		const auto slot = slots[glue_hash_name(name, len, seed) & (size - 1)];
+		return slot != 0 && strncmp(names[slot - 1], name, len) == 0 && names[slot - 1][len] == 0 ? slot - 1 : -1;
+	}
+};
+
+/**
+ * \brief Seeds the hash until all names land in distinct slots.
+ */
+template <size_t N>
+constexpr glue_perfect_hash<N> glue_make_perfect_hash(const std::array<const char*, N>& names)
+{
+	static_assert(N < 255, "too many reflected fields");
+
+	for (uint32_t seed = 0; seed < 100000; ++seed)
+	{
+		glue_perfect_hash<N> table{};
+		table.seed = seed;
+		bool collision = false;
+		for (size_t i = 0; i < N && !collision; ++i)
+		{
+			for (size_t j = 0; j < i; ++j)
+			{
+				if (glue_names_equal(names[i], names[j]))
+				{
+					// duplicate names can never be separated
+					return glue_perfect_hash<N>{ 0xffffffffu, {} };
+				}
+			}
+
+			auto& slot = table.slots[glue_hash_name(names[i], seed) & (glue_perfect_hash<N>::size - 1)];
+			collision = slot != 0;
+			slot = static_cast<unsigned char>(i + 1);
+		}
+		if (!collision)
+		{
+			return table;
+		}
+	}
+	return glue_perfect_hash<N>{ 0xffffffffu, {} };
+}
+
+template <typename T, size_t... I>
+constexpr std::array<const char*, sizeof...(I)> glue_field_names(std::index_sequence<I...>)
+{
+	return { std::get<I>(glue_fields<T>::fields).name... };
+}
+
+template <typename T>
+bool glue_decode_value(const glue_value& v, T& out);
+
+template <typename T>
+int glue_decode_args(const glue_arg* args, int len, T& out);
+
+/**
+ * \brief Compile-time decoding tables of a reflected struct.
+ */
+template <typename T>
+struct glue_decoder
+{
+	static constexpr size_t count = glue_fields<T>::count;
+	static constexpr std::array<const char*, count> names = glue_field_names<T>(std::make_index_sequence<count>());
+	static constexpr glue_perfect_hash<count> hash = glue_make_perfect_hash<count>(names);
+
+	static_assert(hash.seed != 0xffffffffu, "reflected field names must be unique");
+
+	using field_decoder = bool (*)(const glue_value&, T&);
+
+	template <size_t I>
+	static bool decode_field(const glue_value& v, T& out)
+	{
+		return glue_decode_value(v, out.*(std::get<I>(glue_fields<T>::fields).member));
+	}
+
+	template <size_t... I>
+	static constexpr std::array<field_decoder, count> make_decoders(std::index_sequence<I...>)
+	{
+		return { &decode_field<I>... };
+	}
+
+	static constexpr std::array<field_decoder, count> decoders = make_decoders(std::make_index_sequence<count>());
+};
+
+template <typename T>
+bool glue_decode_number(const glue_value& v, T& out)
+{
+	if (v.len >= 0)
+	{
+		return false;
+	}
+
+	switch (v.type)
+	{
+	case glue_type::glue_bool: out = static_cast<T>(v.b); return true;
+	case glue_type::glue_int: out = static_cast<T>(v.i); return true;
+	case glue_type::glue_long:
+	case glue_type::glue_datetime: out = static_cast<T>(v.l); return true;
+	case glue_type::glue_double: out = static_cast<T>(v.d); return true;
+	default: return false;
+	}
+}
+
+template <typename T, size_t... I>
+bool glue_decode_tuple(const glue_value& v, T& out, std::index_sequence<I...>)
+{
+	if (v.type != glue_type::glue_tuple || v.len < 0)
+	{
+		return false;
+	}
+	((static_cast<int>(I) < v.len && glue_decode_value(v.tuple[I], std::get<I>(out))), ...);
+	return true;
+}
+
+template <typename E, typename A>
+bool glue_decode_vector(const glue_value& v, std::vector<E, A>& out)
+{
+	constexpr auto type = glue_type_of<std::vector<E, A>>();
+	if (v.len < 0 || (v.type != type && !(type == glue_type::glue_composite_array && v.type == glue_type::glue_composite)))
+	{
+		return false;
+	}
+
+	out.resize(v.len);
+	for (int i = 0; i < v.len; ++i)
+	{
+		if constexpr (type == glue_type::glue_composite_array)
+		{
+			glue_decode_value(v.composite[i].value, out[i]);
+		}
+		else
+		{
+			glue_value item{};
+			item.type = v.type;
+			item.len = -1;
+			switch (v.type)
+			{
+			case glue_type::glue_bool: item.b = v.bb[i]; break;
+			case glue_type::glue_int: item.i = v.ii[i]; break;
+			case glue_type::glue_long:
+			case glue_type::glue_datetime: item.l = v.ll[i]; break;
+			case glue_type::glue_double: item.d = v.dd[i]; break;
+			case glue_type::glue_string: item.s = v.ss[i]; break;
+			default:;
+			}
+
+			// decoded through a temporary - std::vector<bool> has no addressable items
+			E decoded{};
+			if (glue_decode_value(item, decoded))
+			{
+				out[i] = std::move(decoded);
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * \brief Decodes a single Glue value into a C++ value.
+ * Numbers are converted between the numeric Glue types; a value of a mismatching type leaves out untouched.
+ * const char* results point into the decoded payload.
+ * \return true if the value was decoded.
+ */
+template <typename T>
+bool glue_decode_value(const glue_value& v, T& out)
+{
+	constexpr auto type = glue_type_of<T>();
+
+	if constexpr (glue_is_vector<T>::value)
+	{
+		return glue_decode_vector(v, out);
+	}
+	else if constexpr (type == glue_type::glue_string)
+	{
+		if (v.type != glue_type::glue_string || v.len >= 0 || v.s == nullptr)
+		{
+			return false;
+		}
+		out = v.s;
+		return true;
+	}
+	else if constexpr (type == glue_type::glue_datetime)
+	{
+		long long ms = 0;
+		if (!glue_decode_number(v, ms))
+		{
+			return false;
+		}
+		out = glue_from_epoch_ms(ms);
+		return true;
+	}
+	else if constexpr (type == glue_type::glue_tuple)
+	{
+		return glue_decode_tuple(v, out, std::make_index_sequence<std::tuple_size<T>::value>());
+	}
+	else if constexpr (type == glue_type::glue_composite)
+	{
+		if (v.type != glue_type::glue_composite || v.len < 0)
+		{
+			return false;
+		}
+		glue_decode_args(v.composite, v.len, out);
+		return true;
+	}
+	else
+	{
+		return glue_decode_number(v, out);
+	}
+}
+
+/**
+ * \brief Fills a reflected struct from an array of named Glue values in a single pass.
+ * Every arg is matched to its field through the compile-time perfect hash of the field names;
+ * unknown args are skipped and fields without a matching arg keep their value.
+ * \return The number of decoded fields.
+ */
+template <typename T>
+int glue_decode_args(const glue_arg* args, int len, T& out)
+{
+	using decoder = glue_decoder<T>;
+
+	int decoded = 0;
+	for (int i = 0; i < len; ++i)
+	{
+		const auto name = args[i].name;
+		if (name == nullptr)
+		{
+			continue;
+		}
+
+		const auto field = decoder::hash.find(name, decoder::names);
+		if (field >= 0 && decoder::decoders[field](args[i].value, out))
+		{
+			++decoded;
+		}
+	}
+	return decoded;
+}
+
+/**
+ * \brief Decodes the args of a payload into a reflected struct.
+ * \param payload The payload as received in Glue callbacks.
+ * \param out The struct to be filled.
+ * \return The number of decoded top level fields.
+ */
+template <typename T>
+int glue_decode(const glue_payload& payload, T& out)
+{
+	return glue_decode_args(payload.args, payload.args_len, out);
+}
+
+template <typename T>
+T glue_decode(const glue_payload& payload)
+{
+	T out{};
+	glue_decode(payload, out);
+	return out;
+}
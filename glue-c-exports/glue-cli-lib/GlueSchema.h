@@ -0,0 +1,758 @@
+#pragma once
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLUE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "GlueCLILib.h"
+#include "GlueArena.h"
+#include "GlueJson.h"
+#include "GlueReflect.h"
+
+/*
+ * Schema-bound endpoints - payloads of a fixed shape decoded straight into a reflected struct.
+ *
+ * glue_decode_json fills a struct reflected via GLUE_FIELDS from JSON text without building a
+ * glue_value tree: keys are matched through the struct's compile-time perfect hash, values are
+ * converted in place and unknown fields are skipped by scanning for brackets and quotes only.
+ *
+ *	quote q{};
+ *	glue_decode_json(arena, json, len, q);
+ *
+ * glue_register_schema_endpoint registers an endpoint whose callback receives the decoded struct:
+ *
+ *	glue_register_schema_endpoint<quote>("price", [](const char* endpoint_name, COOKIE cookie,
+ *		const quote& q, const glue_payload* payload, const void* endpoint) { ... });
+ *
+ * Schema-bound endpoints decode the payload's args via glue_decode_args - glue_decode_json is for
+ * callers holding the JSON text itself.
+ * The conversions are those of glue_decode - a value of a mismatching type leaves its field untouched.
+ */
+
+/**
+ * \brief Finds the first bracket or string quote - scanning 16 bytes at a time where SSE2 is available.
+ * \return The position found or end.
+ */
+inline const char* glue_json_find_structural(const char* p, const char* end)
+{
+#ifdef GLUE_SSE2
+	const auto open_brace = _mm_set1_epi8('{');
+	const auto close_brace = _mm_set1_epi8('}');
+	const auto open_bracket = _mm_set1_epi8('[');
+	const auto close_bracket = _mm_set1_epi8(']');
+	const auto double_quote = _mm_set1_epi8('"');
+	const auto single_quote = _mm_set1_epi8('\'');
+	for (; end - p >= 16; p += 16)
+	{
+		const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		const auto brackets = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, open_brace), _mm_cmpeq_epi8(chunk, close_brace)),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, open_bracket), _mm_cmpeq_epi8(chunk, close_bracket)));
+		const auto quotes = _mm_or_si128(_mm_cmpeq_epi8(chunk, double_quote), _mm_cmpeq_epi8(chunk, single_quote));
+		const auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(brackets, quotes)));
+		if (mask != 0)
+		{
+			return p + glue_ctz(mask);
+		}
+	}
+#endif
+	while (p < end && *p != '{' && *p != '}' && *p != '[' && *p != ']' && *p != '"' && *p != '\'')
+	{
+		++p;
+	}
+	return p;
+}
+
+/**
+ * \brief Character classes of the schema decoder - key characters of unquoted keys and characters ending numbers and literals.
+ */
+constexpr unsigned char glue_json_key_char = 1;
+constexpr unsigned char glue_json_scalar_end = 2;
+
+constexpr std::array<unsigned char, 256> glue_json_char_classes()
+{
+	std::array<unsigned char, 256> classes{};
+	for (int c = 0; c < 256; ++c)
+	{
+		if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$' || c == '-')
+		{
+			classes[c] |= glue_json_key_char;
+		}
+		if (c == ',' || c == '}' || c == ']' || c == ' ' || c == '\n' || c == '\r' || c == '\t')
+		{
+			classes[c] |= glue_json_scalar_end;
+		}
+	}
+	return classes;
+}
+
+class glue_schema_decoder;
+
+/**
+ * \brief Compile-time JSON decoding table of a reflected struct - one decoder per field, indexed like glue_decoder's names.
+ */
+template <typename T>
+struct glue_schema_fields
+{
+	static constexpr size_t count = glue_fields<T>::count;
+
+	using field_decoder = bool (*)(glue_schema_decoder&, T&, int);
+
+	template <size_t I>
+	static bool decode_field(glue_schema_decoder& decoder, T& out, int depth);
+
+	template <size_t... I>
+	static constexpr std::array<field_decoder, count> make_decoders(std::index_sequence<I...>)
+	{
+		return { &decode_field<I>... };
+	}
+
+	static constexpr std::array<field_decoder, count> decoders = make_decoders(std::make_index_sequence<count>());
+};
+
+/**
+ * \brief Decodes JSON text into reflected structs - accepts the relaxed dialect of glue_json_parser.
+ * Reuse it - it keeps the scratch state of the parser used for escaped strings.
+ */
+class glue_schema_decoder
+{
+public:
+	static constexpr int max_depth = 256;
+	static constexpr std::array<unsigned char, 256> char_classes = glue_json_char_classes();
+
+	/**
+	 * \brief Decodes a JSON object into a reflected struct.
+	 * \param arena Storage for const char* fields and unescaped strings.
+	 * \param json The JSON text.
+	 * \param len The length of the text.
+	 * \param out The struct to be filled - fields without a matching key keep their value.
+	 * \return The number of decoded top level fields, -1 on syntax errors - see error() and error_offset().
+	 */
+	template <typename T>
+	int decode(glue_arena& arena, const char* json, size_t len, T& out)
+	{
+		static_assert(glue_is_reflected<T>::value, "reflect the struct with GLUE_FIELDS");
+
+		arena_ = &arena;
+		begin_ = json;
+		p_ = json;
+		end_ = json + len;
+		error_ = nullptr;
+		error_offset_ = 0;
+
+		int decoded = 0;
+		skip_whitespace();
+		if (p_ == end_ || *p_ != '{')
+		{
+			fail("not an object");
+			return -1;
+		}
+		if (!object(out, 1, decoded))
+		{
+			return -1;
+		}
+		skip_whitespace();
+		if (p_ != end_)
+		{
+			fail("unexpected trailing characters");
+			return -1;
+		}
+		return decoded;
+	}
+
+	const char* error() const
+	{
+		return error_;
+	}
+
+	size_t error_offset() const
+	{
+		return error_offset_;
+	}
+
+private:
+	template <typename T>
+	friend struct glue_schema_fields;
+
+	static bool is_quote(char c)
+	{
+		return c == '"' || c == '\'';
+	}
+
+	bool fail(const char* message)
+	{
+		if (error_ == nullptr)
+		{
+			error_ = message;
+			error_offset_ = static_cast<size_t>(p_ - begin_);
+		}
+		return false;
+	}
+
+	void skip_whitespace()
+	{
+		while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t'))
+		{
+			++p_;
+		}
+	}
+
+	/**
+	 * \brief Decodes the value at the cursor into out, or skips it if its JSON type does not fit.
+	 * matched_ tells whether out was assigned.
+	 * \return false on syntax errors.
+	 */
+	template <typename T>
+	bool value(T& out, int depth)
+	{
+		constexpr auto type = glue_type_of<T>();
+		matched_ = false;
+		if (p_ == end_)
+		{
+			return fail("unexpected end");
+		}
+
+		const auto c = *p_;
+		if constexpr (glue_is_vector<T>::value)
+		{
+			if (c == '[')
+			{
+				return depth < max_depth ? array(out, depth + 1) : fail("too deep");
+			}
+		}
+		else if constexpr (type == glue_type::glue_string)
+		{
+			if (is_quote(c))
+			{
+				return string(out);
+			}
+		}
+		else if constexpr (type == glue_type::glue_datetime)
+		{
+			long long ms;
+			if (c != '[' && c != '{' && !is_quote(c) && c != 't' && c != 'f' && c != 'n')
+			{
+				if (!number(ms))
+				{
+					return false;
+				}
+				out = glue_from_epoch_ms(ms);
+				return true;
+			}
+		}
+		else if constexpr (type == glue_type::glue_tuple)
+		{
+			if (c == '[')
+			{
+				return depth < max_depth ? tuple(out, depth + 1, std::make_index_sequence<std::tuple_size<T>::value>()) : fail("too deep");
+			}
+		}
+		else if constexpr (type == glue_type::glue_composite)
+		{
+			if (c == '{')
+			{
+				int decoded = 0;
+				return depth < max_depth ? object(out, depth + 1, decoded) : fail("too deep");
+			}
+		}
+		else
+		{
+			// bool and numbers convert into each other, as in glue_decode_number
+			if (c == 't' || c == 'f')
+			{
+				const auto is_true = c == 't';
+				if (!literal(is_true ? "true" : "false"))
+				{
+					return false;
+				}
+				out = static_cast<T>(is_true);
+				matched_ = true;
+				return true;
+			}
+			if (c != '[' && c != '{' && !is_quote(c) && c != 'n')
+			{
+				return number(out);
+			}
+		}
+		return skip_value();
+	}
+
+	template <typename T>
+	bool object(T& out, int depth, int& decoded)
+	{
+		using decoder = glue_decoder<T>;
+
+		++p_;
+		for (;;)
+		{
+			skip_whitespace();
+			if (p_ == end_)
+			{
+				return fail("unterminated object");
+			}
+			if (*p_ == '}')
+			{
+				++p_;
+				break;
+			}
+
+			const char* name;
+			size_t len;
+			if (!key(name, len))
+			{
+				return false;
+			}
+			skip_whitespace();
+			if (p_ == end_ || *p_ != ':')
+			{
+				return fail("expected ':'");
+			}
+			++p_;
+			skip_whitespace();
+
+			const auto field = decoder::hash.find(name, len, decoder::names);
+			if (field < 0)
+			{
+				if (!skip_value())
+				{
+					return false;
+				}
+			}
+			else
+			{
+				if (!glue_schema_fields<T>::decoders[field](*this, out, depth))
+				{
+					return false;
+				}
+				decoded += matched_ ? 1 : 0;
+			}
+
+			skip_whitespace();
+			if (p_ < end_ && *p_ == ',')
+			{
+				++p_;
+			}
+			else if (p_ < end_ && *p_ != '}')
+			{
+				return fail("expected ',' or '}'");
+			}
+		}
+		matched_ = true;
+		return true;
+	}
+
+	template <typename E, typename A>
+	bool array(std::vector<E, A>& out, int depth)
+	{
+		++p_;
+		size_t len = 0;
+		for (;;)
+		{
+			skip_whitespace();
+			if (p_ == end_)
+			{
+				return fail("unterminated array");
+			}
+			if (*p_ == ']')
+			{
+				++p_;
+				break;
+			}
+
+			// items are decoded in place, so a vector decoded into again keeps its storage
+			if (len == out.size())
+			{
+				out.emplace_back();
+			}
+			if constexpr (std::is_same<E, bool>::value)
+			{
+				// std::vector<bool> has no addressable items
+				bool item = out[len];
+				if (!value(item, depth))
+				{
+					return false;
+				}
+				out[len] = item;
+			}
+			else if (!value(out[len], depth))
+			{
+				return false;
+			}
+			++len;
+
+			skip_whitespace();
+			if (p_ < end_ && *p_ == ',')
+			{
+				++p_;
+			}
+			else if (p_ < end_ && *p_ != ']')
+			{
+				return fail("expected ',' or ']'");
+			}
+		}
+		out.resize(len);
+		matched_ = true;
+		return true;
+	}
+
+	template <typename T, size_t... I>
+	bool tuple(T& out, int depth, std::index_sequence<I...>)
+	{
+		++p_;
+		size_t index = 0;
+		for (;;)
+		{
+			skip_whitespace();
+			if (p_ == end_)
+			{
+				return fail("unterminated array");
+			}
+			if (*p_ == ']')
+			{
+				++p_;
+				break;
+			}
+
+			bool ok = true;
+			const auto known = ((index == I && (ok = value(std::get<I>(out), depth), true)) || ...);
+			if (!known)
+			{
+				// items beyond the tuple's size
+				ok = skip_value();
+			}
+			if (!ok)
+			{
+				return false;
+			}
+			++index;
+
+			skip_whitespace();
+			if (p_ < end_ && *p_ == ',')
+			{
+				++p_;
+			}
+			else if (p_ < end_ && *p_ != ']')
+			{
+				return fail("expected ',' or ']'");
+			}
+		}
+		matched_ = true;
+		return true;
+	}
+
+	bool literal(const char* text)
+	{
+		const auto len = strlen(text);
+		if (static_cast<size_t>(end_ - p_) < len || memcmp(p_, text, len) != 0)
+		{
+			return fail("invalid literal");
+		}
+		p_ += len;
+		return true;
+	}
+
+	template <typename T>
+	bool number(T& out)
+	{
+		const auto start = p_;
+		bool integral = true;
+		while (p_ < end_)
+		{
+			const auto c = *p_;
+			if ((c >= '0' && c <= '9') || c == '-' || c == '+')
+			{
+				++p_;
+			}
+			else if (c == '.' || c == 'e' || c == 'E')
+			{
+				integral = false;
+				++p_;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		const auto begin = start < p_ && *start == '+' ? start + 1 : start;
+		if (integral)
+		{
+			long long l;
+			const auto result = std::from_chars(begin, p_, l);
+			if (begin < p_ && result.ec == std::errc() && result.ptr == p_)
+			{
+				out = static_cast<T>(l);
+				matched_ = true;
+				return true;
+			}
+		}
+
+		double d;
+		const auto result = std::from_chars(begin, p_, d);
+		if (begin == p_ || result.ptr != p_)
+		{
+			return fail("invalid number");
+		}
+		out = static_cast<T>(d);
+		matched_ = true;
+		return true;
+	}
+
+	/**
+	 * \brief Reads a quoted string - unescaped via glue_json_parser when it has escapes.
+	 */
+	bool string(const char*& out)
+	{
+		const auto start = p_;
+		if (!skip_string())
+		{
+			return false;
+		}
+
+		const auto len = static_cast<size_t>(p_ - start) - 2;
+		if (memchr(start + 1, '\\', len) == nullptr)
+		{
+			const auto s = arena_->alloc<char>(len + 1);
+			memcpy(s, start + 1, len);
+			s[len] = 0;
+			out = s;
+		}
+		else
+		{
+			glue_value v;
+			if (parser_.parse(*arena_, start, static_cast<size_t>(p_ - start), v) != 0)
+			{
+				p_ = start;
+				return fail("invalid string");
+			}
+			out = v.s;
+		}
+		matched_ = true;
+		return true;
+	}
+
+	bool string(std::string& out)
+	{
+		const auto start = p_;
+		if (!skip_string())
+		{
+			return false;
+		}
+
+		const auto len = static_cast<size_t>(p_ - start) - 2;
+		if (memchr(start + 1, '\\', len) == nullptr)
+		{
+			out.assign(start + 1, len);
+		}
+		else
+		{
+			glue_value v;
+			if (parser_.parse(*arena_, start, static_cast<size_t>(p_ - start), v) != 0)
+			{
+				p_ = start;
+				return fail("invalid string");
+			}
+			out = v.s;
+		}
+		matched_ = true;
+		return true;
+	}
+
+	/**
+	 * \brief Reads a key - quoted keys are taken as written, without unescaping.
+	 */
+	bool key(const char*& name, size_t& len)
+	{
+		if (p_ < end_ && is_quote(*p_))
+		{
+			const auto start = p_;
+			if (!skip_string())
+			{
+				return false;
+			}
+			name = start + 1;
+			len = static_cast<size_t>(p_ - start) - 2;
+			return true;
+		}
+
+		const auto start = p_;
+		while (p_ < end_ && (char_classes[static_cast<unsigned char>(*p_)] & glue_json_key_char) != 0)
+		{
+			++p_;
+		}
+		if (p_ == start)
+		{
+			return fail("expected a key");
+		}
+		name = start;
+		len = static_cast<size_t>(p_ - start);
+		return true;
+	}
+
+	bool skip_string()
+	{
+		const auto quote = *p_++;
+		for (;;)
+		{
+			p_ = glue_json_find(p_, end_, quote, '\\');
+			if (end_ - p_ < 2 && (p_ == end_ || *p_ != quote))
+			{
+				p_ = end_;
+				return fail("unterminated string");
+			}
+			if (*p_ == quote)
+			{
+				++p_;
+				return true;
+			}
+			// the escaped character
+			p_ += 2;
+		}
+	}
+
+	/**
+	 * \brief Skips a value of an unknown field - objects and arrays by counting brackets,
+	 * so the text inside them is only checked for balanced nesting and terminated strings.
+	 */
+	bool skip_value()
+	{
+		const auto c = *p_;
+		if (is_quote(c))
+		{
+			return skip_string();
+		}
+
+		if (c == '{' || c == '[')
+		{
+			int depth = 0;
+			for (;;)
+			{
+				p_ = glue_json_find_structural(p_, end_);
+				if (p_ == end_)
+				{
+					return fail(depth > 0 ? "unterminated object or array" : "unexpected end");
+				}
+				switch (*p_)
+				{
+				case '{':
+				case '[':
+					++depth;
+					++p_;
+					break;
+				case '}':
+				case ']':
+					++p_;
+					if (--depth == 0)
+					{
+						return true;
+					}
+					break;
+				default:
+					if (!skip_string())
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		// a number or literal - up to the next separator
+		const auto start = p_;
+		while (p_ < end_ && (char_classes[static_cast<unsigned char>(*p_)] & glue_json_scalar_end) == 0)
+		{
+			++p_;
+		}
+		return p_ > start || fail("unexpected character");
+	}
+
+	glue_arena* arena_ = nullptr;
+	const char* begin_ = nullptr;
+	const char* p_ = nullptr;
+	const char* end_ = nullptr;
+	const char* error_ = nullptr;
+	size_t error_offset_ = 0;
+	bool matched_ = false;
+
+	glue_json_parser parser_;
+};
+
+template <typename T>
+template <size_t I>
+bool glue_schema_fields<T>::decode_field(glue_schema_decoder& decoder, T& out, int depth)
+{
+	return decoder.value(out.*(std::get<I>(glue_fields<T>::fields).member), depth);
+}
+
+/**
+ * \brief Decodes a JSON object into a reflected struct.
+ * \param arena Storage for const char* fields and unescaped strings - keep it until the struct's strings are used.
+ * \return The number of decoded top level fields or -1 on syntax errors.
+ */
+template <typename T>
+int glue_decode_json(glue_arena& arena, const char* json, size_t len, T& out)
+{
+	thread_local glue_schema_decoder decoder;
+	return decoder.decode(arena, json, len, out);
+}
+
+template <typename T>
+int glue_decode_json(glue_arena& arena, const char* json, T& out)
+{
+	return glue_decode_json(arena, json, strlen(json), out);
+}
+
+/**
+ * \brief Callback of a schema-bound endpoint - invocation_callback_function with the decoded args.
+ * The args and their strings are valid during the callback only.
+ */
+template <typename T>
+using glue_schema_callback_function = void (*)(const char* endpoint_name, COOKIE cookie, const T& args, const glue_payload* payload, const void* endpoint);
+
+/**
+ * \brief Registration of a schema-bound endpoint - passed to GlueCLILib as the endpoint's cookie.
+ */
+template <typename T>
+struct glue_schema_endpoint
+{
+	glue_schema_callback_function<T> callback;
+	COOKIE cookie;
+
+	static void invoke(const char* endpoint_name, COOKIE cookie, const glue_payload* payload, const void* endpoint)
+	{
+		const auto self = static_cast<const glue_schema_endpoint*>(cookie);
+
+		T args{};
+		glue_decode_args(payload->args, payload->args_len, args);
+		self->callback(endpoint_name, self->cookie, args, payload, endpoint);
+	}
+};
+
+/**
+ * \brief Registers an endpoint whose args are decoded into a reflected struct before the callback is invoked.
+ * \param endpoint_name The name of the endpoint.
+ * \param callback Invoked with the decoded args of every invocation.
+ * \param cookie Passed to the callback.
+ * \return 0 if the endpoint was registered. The registration lives as long as the endpoint - for the rest of the process.
+ */
+template <typename T>
+int glue_register_schema_endpoint(const char* endpoint_name, glue_schema_callback_function<T> callback, COOKIE cookie = nullptr)
+{
+	static_assert(glue_is_reflected<T>::value, "reflect the struct with GLUE_FIELDS");
+
+	const auto registration = new glue_schema_endpoint<T>{ callback, cookie };
+	const auto result = glue_register_endpoint(endpoint_name, &glue_schema_endpoint<T>::invoke, registration);
+	if (result != 0)
+	{
+		delete registration;
+	}
+	return result;
+}
@@ -0,0 +1,693 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "GlueCLILib.h"
+#include "GlueArena.h"
+#include "GlueFlat.h"
+#include "GlueJson.h"
+
+/*
+ * Same-host stream transport - stream branches over shared memory rings.
+ *
+ * Publishers and subscribers of a stream branch on the same machine can bypass Glue: every branch
+ * maps a named shared memory segment with one ring per subscriber. A push encodes the payload once
+ * (the unbound flat encoding of GlueFlat.h) and copies it into the ring of every subscriber; each
+ * subscriber binds the block in place and hands it to its callback as a zero-copy view.
+ *
+ *	// publishing process
+ *	glue_shm_publisher publisher("native_stream", "apples");
+ *	publisher.push_json("{fruits: {type: 'apples', items: ['red', 'white']}}");
+ *
+ *	// subscribing process
+ *	glue_shm_subscriber subscriber("native_stream", "apples", &on_payload, cookie);
+ *
+ * Rings are bounded and multi-producer/multi-consumer (any number of publishers of a branch, in any
+ * processes): a push to a full ring is dropped for that subscriber and counted - a slow subscriber
+ * never blocks the publisher or the other subscribers. Subscribers receive the payloads pushed after
+ * they subscribed; rings of subscribers whose process exited are reclaimed by new subscribers.
+ *
+ * Callbacks run on the subscriber's polling thread, payloads and their args are valid during the
+ * callback only and payload->reader is nullptr - read the args (e.g. via GluePath.h or GlueReflect.h).
+ * A publisher object is not thread safe - open one per publishing thread.
+ */
+
+constexpr uint32_t glue_shm_magic = 0x4d534c47; // 'GLSM'
+constexpr uint32_t glue_shm_version = 1;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+	"shared memory rings require address-free atomics");
+
+/**
+ * \brief Geometry of a branch segment - applied by the process creating the segment, later ones use the existing one.
+ */
+struct glue_shm_options
+{
+	// subscribers of the branch at the same time
+	uint32_t subscribers = 4;
+	// payloads buffered per subscriber - rounded up to a power of 2
+	uint32_t slots = 512;
+	// largest flat payload in bytes
+	uint32_t payload_size = 8192;
+};
+
+/**
+ * \brief Header at the start of every branch segment.
+ */
+struct alignas(64) glue_shm_header
+{
+	std::atomic<uint32_t> magic;
+	uint32_t version;
+	uint32_t subscribers;
+	uint32_t slots;
+	// size of a slot in bytes - its glue_shm_slot header and the flat payload, a multiple of 64
+	uint32_t slot_size;
+};
+
+/**
+ * \brief Ring of a subscriber - a bounded queue with a sequence per slot.
+ */
+struct alignas(64) glue_shm_ring
+{
+	// process id of the subscriber or 0 for a free ring
+	std::atomic<uint32_t> owner;
+	// pushes dropped while the ring was full
+	std::atomic<uint64_t> dropped;
+	// next position to push - claimed by publishers
+	alignas(64) std::atomic<uint64_t> tail;
+	// next position to pop - claimed by the subscriber
+	alignas(64) std::atomic<uint64_t> head;
+};
+
+/**
+ * \brief Header of a slot, followed by the payload's flat block.
+ * The sequence is the slot's position while free, the position + 1 once pushed.
+ */
+struct glue_shm_slot
+{
+	std::atomic<uint64_t> sequence;
+	uint32_t size;
+	uint32_t reserved;
+};
+
+/**
+ * \brief Offsets of the parts of a branch segment.
+ */
+struct glue_shm_layout
+{
+	uint32_t subscribers;
+	uint32_t slots;
+	uint32_t slot_size;
+
+	explicit glue_shm_layout(const glue_shm_options& options)
+	{
+		subscribers = options.subscribers > 0 ? options.subscribers : 1;
+		slots = 1;
+		while (slots < options.slots)
+		{
+			slots <<= 1;
+		}
+		slot_size = static_cast<uint32_t>((sizeof(glue_shm_slot) + options.payload_size + 63) & ~size_t{ 63 });
+	}
+
+	explicit glue_shm_layout(const glue_shm_header& header) : subscribers(header.subscribers), slots(header.slots), slot_size(header.slot_size)
+	{
+	}
+
+	size_t ring(uint32_t i) const
+	{
+		return sizeof(glue_shm_header) + i * sizeof(glue_shm_ring);
+	}
+
+	size_t slot(uint32_t ring, uint64_t position) const
+	{
+		return this->ring(subscribers) + (static_cast<size_t>(ring) * slots + static_cast<size_t>(position & (slots - 1))) * slot_size;
+	}
+
+	size_t size() const
+	{
+		return slot(subscribers, 0);
+	}
+
+	uint32_t payload_size() const
+	{
+		return slot_size - static_cast<uint32_t>(sizeof(glue_shm_slot));
+	}
+};
+
+inline uint32_t glue_shm_process_id()
+{
+#ifdef _WIN32
+	return GetCurrentProcessId();
+#else
+	return static_cast<uint32_t>(getpid());
+#endif
+}
+
+inline bool glue_shm_process_alive(uint32_t pid)
+{
+#ifdef _WIN32
+	const auto process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+	if (process == nullptr)
+	{
+		return GetLastError() == ERROR_ACCESS_DENIED;
+	}
+	const auto alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+	CloseHandle(process);
+	return alive;
+#else
+	return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+/**
+ * \brief Name of the segment of a stream branch - readable and collision free.
+ */
+inline std::string glue_shm_name(const char* stream, const char* branch)
+{
+	std::string key = stream != nullptr ? stream : "";
+	key.append(1, '/').append(branch != nullptr ? branch : "");
+
+	// FNV-1a of the exact names - the readable part below is lossy
+	uint64_t hash = 14695981039346656037ull;
+	for (const auto c : key)
+	{
+		hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+	}
+
+#ifdef _WIN32
+	std::string name = "Local\\glue_shm_";
+#else
+	std::string name = "/glue_shm_";
+#endif
+	for (size_t i = 0; i < key.size() && i < 64; ++i)
+	{
+		const auto c = key[i];
+		name.append(1, (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ? c : '_');
+	}
+
+	char suffix[18];
+	snprintf(suffix, sizeof(suffix), "_%016llx", static_cast<unsigned long long>(hash));
+	return name.append(suffix);
+}
+
+/**
+ * \brief A named shared memory mapping.
+ */
+class glue_shm_segment
+{
+public:
+	glue_shm_segment() = default;
+	glue_shm_segment(const glue_shm_segment&) = delete;
+	glue_shm_segment& operator=(const glue_shm_segment&) = delete;
+
+	~glue_shm_segment()
+	{
+		close();
+	}
+
+	/**
+	 * \brief Opens a segment or creates it with size bytes - created segments are zero filled.
+	 */
+	bool open(const std::string& name, size_t size, bool& created)
+	{
+		close();
+#ifdef _WIN32
+		mapping_ = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), name.c_str());
+		if (mapping_ == nullptr)
+		{
+			return false;
+		}
+		created = GetLastError() != ERROR_ALREADY_EXISTS;
+
+		data_ = static_cast<char*>(MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+		MEMORY_BASIC_INFORMATION info;
+		if (data_ == nullptr || VirtualQuery(data_, &info, sizeof(info)) == 0)
+		{
+			close();
+			return false;
+		}
+		size_ = info.RegionSize;
+		return true;
+#else
+		auto fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		created = fd >= 0;
+		if (created)
+		{
+			if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+			{
+				::close(fd);
+				shm_unlink(name.c_str());
+				return false;
+			}
+		}
+		else
+		{
+			fd = errno == EEXIST ? shm_open(name.c_str(), O_RDWR, 0600) : -1;
+			if (fd < 0)
+			{
+				return false;
+			}
+
+			// the creating process sizes the segment right after creating it
+			struct stat st;
+			for (int i = 0; fstat(fd, &st) == 0 && st.st_size == 0 && i < 1000; ++i)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			size = static_cast<size_t>(st.st_size);
+		}
+
+		const auto data = size > 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+		::close(fd);
+		if (data == MAP_FAILED)
+		{
+			return false;
+		}
+		data_ = static_cast<char*>(data);
+		size_ = size;
+		return true;
+#endif
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (data_ != nullptr)
+		{
+			UnmapViewOfFile(data_);
+		}
+		if (mapping_ != nullptr)
+		{
+			CloseHandle(mapping_);
+			mapping_ = nullptr;
+		}
+#else
+		if (data_ != nullptr)
+		{
+			munmap(data_, size_);
+		}
+#endif
+		data_ = nullptr;
+		size_ = 0;
+	}
+
+	char* data() const
+	{
+		return data_;
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+private:
+	char* data_ = nullptr;
+	size_t size_ = 0;
+#ifdef _WIN32
+	HANDLE mapping_ = nullptr;
+#endif
+};
+
+/**
+ * \brief Opens the segment of a stream branch - creating and laying it out if it does not exist yet.
+ * \return The segment's header or nullptr if the segment can not be mapped or has an incompatible layout.
+ */
+inline glue_shm_header* glue_shm_open(glue_shm_segment& segment, const char* stream, const char* branch, const glue_shm_options& options)
+{
+	const glue_shm_layout layout(options);
+	bool created;
+	if (!segment.open(glue_shm_name(stream, branch), layout.size(), created))
+	{
+		return nullptr;
+	}
+
+	const auto data = segment.data();
+	if (created)
+	{
+		const auto header = new (data) glue_shm_header();
+		header->version = glue_shm_version;
+		header->subscribers = layout.subscribers;
+		header->slots = layout.slots;
+		header->slot_size = layout.slot_size;
+		for (uint32_t r = 0; r < layout.subscribers; ++r)
+		{
+			new (data + layout.ring(r)) glue_shm_ring();
+			for (uint32_t s = 0; s < layout.slots; ++s)
+			{
+				new (data + layout.slot(r, s)) glue_shm_slot{ { s }, 0, 0 };
+			}
+		}
+		header->magic.store(glue_shm_magic, std::memory_order_release);
+		return header;
+	}
+
+	const auto header = reinterpret_cast<glue_shm_header*>(data);
+	for (int i = 0; header->magic.load(std::memory_order_acquire) != glue_shm_magic && i < 1000; ++i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if (header->magic.load(std::memory_order_acquire) != glue_shm_magic || header->version != glue_shm_version
+		|| glue_shm_layout(*header).size() > segment.size())
+	{
+		segment.close();
+		return nullptr;
+	}
+	return header;
+}
+
+/**
+ * \brief Removes the segment of a stream branch - mapped segments stay valid, later opens create a new one.
+ * Segments outlive their processes on POSIX systems until removed; on Windows until the last one unmaps them.
+ */
+inline void glue_shm_remove(const char* stream, const char* branch)
+{
+#ifndef _WIN32
+	shm_unlink(glue_shm_name(stream, branch).c_str());
+#else
+	(void)stream;
+	(void)branch;
+#endif
+}
+
+/**
+ * \brief Publishes to a stream branch over shared memory.
+ */
+class glue_shm_publisher
+{
+public:
+	/**
+	 * \param stream The stream's name.
+	 * \param branch The branch - nullptr or "" for the main branch.
+	 */
+	explicit glue_shm_publisher(const char* stream, const char* branch = nullptr, const glue_shm_options& options = {})
+	{
+		header_ = glue_shm_open(segment_, stream, branch, options);
+		if (header_ != nullptr)
+		{
+			buffer_.reset(new char[glue_shm_layout(*header_).payload_size()]);
+		}
+	}
+
+	bool is_open() const
+	{
+		return header_ != nullptr;
+	}
+
+	/**
+	 * \brief Copies args to every subscriber of the branch.
+	 * \return The number of subscribers the payload was queued for - full rings drop it -
+	 * or -1 if the publisher is not open or the payload exceeds the payload size.
+	 */
+	int push(const glue_arg* args, int len)
+	{
+		if (header_ == nullptr)
+		{
+			return -1;
+		}
+
+		const glue_shm_layout layout(*header_);
+		const auto data = segment_.data();
+		const char* flat = nullptr;
+		int pushed = 0;
+		for (uint32_t r = 0; r < layout.subscribers; ++r)
+		{
+			auto& ring = *reinterpret_cast<glue_shm_ring*>(data + layout.ring(r));
+			if (ring.owner.load(std::memory_order_acquire) == 0)
+			{
+				continue;
+			}
+
+			// encoded once, on the first subscriber
+			if (flat == nullptr)
+			{
+				const auto capacity = layout.payload_size();
+				flat = glue_flatten_unbound(nullptr, args, args != nullptr ? len : 0,
+					[this, capacity](size_t size) { return size <= capacity ? buffer_.get() : nullptr; });
+				if (flat == nullptr)
+				{
+					return -1;
+				}
+			}
+
+			if (push(layout, r, ring, flat))
+			{
+				++pushed;
+			}
+			else
+			{
+				ring.dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		return pushed;
+	}
+
+	int push(const glue_payload* payload)
+	{
+		return push(payload->args, payload->args_len);
+	}
+
+	/**
+	 * \brief Parses a JSON object (relaxed, as glue_push_json_payload) and pushes its fields as args.
+	 */
+	int push_json(const char* json)
+	{
+		if (json == nullptr)
+		{
+			return -1;
+		}
+
+		const glue_arg* args;
+		int len;
+		const auto result = parser_.parse_args(arena_, json, strlen(json), args, len) == 0 ? push(args, len) : -1;
+		arena_.reset();
+		return result;
+	}
+
+private:
+	bool push(const glue_shm_layout& layout, uint32_t r, glue_shm_ring& ring, const char* flat)
+	{
+		const auto data = segment_.data();
+		auto position = ring.tail.load(std::memory_order_relaxed);
+		glue_shm_slot* slot;
+		for (;;)
+		{
+			slot = reinterpret_cast<glue_shm_slot*>(data + layout.slot(r, position));
+			const auto sequence = slot->sequence.load(std::memory_order_acquire);
+			const auto difference = static_cast<int64_t>(sequence - position);
+			if (difference == 0)
+			{
+				if (ring.tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (difference < 0)
+			{
+				// full - the subscriber has not released this slot since the previous lap
+				return false;
+			}
+			else
+			{
+				position = ring.tail.load(std::memory_order_relaxed);
+			}
+		}
+
+		const auto size = glue_flat_size(flat);
+		memcpy(reinterpret_cast<char*>(slot + 1), flat, size);
+		slot->size = static_cast<uint32_t>(size);
+		slot->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	glue_shm_segment segment_;
+	glue_shm_header* header_ = nullptr;
+	std::unique_ptr<char[]> buffer_;
+	glue_json_parser parser_;
+	glue_arena arena_;
+};
+
+/**
+ * \brief Subscribes to a stream branch over shared memory - takes a ring of the branch and polls it on its own thread.
+ */
+class glue_shm_subscriber
+{
+public:
+	/**
+	 * \param stream The stream's name - passed to the callback as its origin.
+	 * \param branch The branch - nullptr or "" for the main branch.
+	 * \param callback Invoked on the subscriber's thread for every payload.
+	 */
+	glue_shm_subscriber(const char* stream, const char* branch, payload_function callback, COOKIE cookie, const glue_shm_options& options = {})
+		: stream_(stream != nullptr ? stream : ""), callback_(callback), cookie_(cookie)
+	{
+		const auto header = glue_shm_open(segment_, stream, branch, options);
+		if (header == nullptr || callback == nullptr)
+		{
+			return;
+		}
+
+		layout_ = glue_shm_layout(*header);
+		ring_ = acquire(glue_shm_process_id());
+		if (ring_ == nullptr)
+		{
+			return;
+		}
+
+		// payloads queued before the subscription belong to a previous subscriber of the ring
+		start_ = ring_->tail.load(std::memory_order_acquire);
+		thread_ = std::thread([this] { run(); });
+	}
+
+	glue_shm_subscriber(const glue_shm_subscriber&) = delete;
+	glue_shm_subscriber& operator=(const glue_shm_subscriber&) = delete;
+
+	~glue_shm_subscriber()
+	{
+		stopping_ = true;
+		if (thread_.joinable())
+		{
+			thread_.join();
+		}
+		if (ring_ != nullptr)
+		{
+			ring_->owner.store(0, std::memory_order_release);
+		}
+	}
+
+	bool is_open() const
+	{
+		return ring_ != nullptr;
+	}
+
+	/**
+	 * \brief Payloads dropped for this subscriber while its ring was full.
+	 */
+	uint64_t dropped() const
+	{
+		return ring_ != nullptr ? ring_->dropped.load(std::memory_order_relaxed) : 0;
+	}
+
+private:
+	glue_shm_ring* acquire(uint32_t pid)
+	{
+		const auto data = segment_.data();
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			for (uint32_t r = 0; r < layout_.subscribers; ++r)
+			{
+				const auto ring = reinterpret_cast<glue_shm_ring*>(data + layout_.ring(r));
+				auto owner = ring->owner.load(std::memory_order_acquire);
+
+				// a free ring first, then one of an exited subscriber
+				if ((pass == 0 && owner == 0) || (pass == 1 && owner != 0 && !glue_shm_process_alive(owner)))
+				{
+					if (ring->owner.compare_exchange_strong(owner, pid, std::memory_order_acq_rel))
+					{
+						ring_index_ = r;
+						return ring;
+					}
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	/**
+	 * \brief Delivers up to max queued payloads.
+	 * \return The number of slots consumed.
+	 */
+	int poll(int max)
+	{
+		const auto data = segment_.data();
+		int n = 0;
+		for (; n < max; ++n)
+		{
+			auto position = ring_->head.load(std::memory_order_relaxed);
+			glue_shm_slot* slot;
+			for (;;)
+			{
+				slot = reinterpret_cast<glue_shm_slot*>(data + layout_.slot(ring_index_, position));
+				const auto sequence = slot->sequence.load(std::memory_order_acquire);
+				const auto difference = static_cast<int64_t>(sequence - (position + 1));
+				if (difference == 0)
+				{
+					if (ring_->head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (difference < 0)
+				{
+					return n;
+				}
+				else
+				{
+					position = ring_->head.load(std::memory_order_relaxed);
+				}
+			}
+
+			// the slot is ours until released - bound in place and read without a copy
+			const auto flat = reinterpret_cast<char*>(slot + 1);
+			if (position >= start_ && glue_flat_bind(flat))
+			{
+				int len;
+				const auto args = glue_flat_args(flat, len);
+				const glue_payload payload{ nullptr, nullptr, 0, args, len };
+				callback_(stream_.c_str(), cookie_, &payload);
+			}
+			slot->sequence.store(position + layout_.slots, std::memory_order_release);
+		}
+		return n;
+	}
+
+	void run()
+	{
+		// busy polls right after a payload for the lowest latency, then backs off to sleeping
+		int idle = 0;
+		while (!stopping_)
+		{
+			if (poll(64) > 0)
+			{
+				idle = 0;
+			}
+			else if (++idle > 2000)
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+			else if (idle > 1000)
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	std::string stream_;
+	payload_function callback_;
+	COOKIE cookie_;
+	glue_shm_segment segment_;
+	glue_shm_layout layout_{ glue_shm_options{} };
+	glue_shm_ring* ring_ = nullptr;
+	uint32_t ring_index_ = 0;
+	uint64_t start_ = 0;
+	std::atomic<bool> stopping_{ false };
+	std::thread thread_;
+};
@@ -0,0 +1,197 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "GlueCLILib.h"
+#include "GlueFlat.h"
+#include "GlueHash.h"
+
+/*
+ * Single-flight invocations - identical invocations in flight at the same time share one glue_invoke.
+ *
+ * When many windows ask for the same data at once, each glue_invoke goes to the endpoint. Through a
+ * glue_single_flight, an invocation made while an identical one - same endpoint name, deep equal
+ * args - is in flight goes nowhere: it attaches to the one in flight, and its callback gets that
+ * one's result:
+ *
+ *	glue_single_flight flights;
+ *	flights.invoke("RefData.Instrument", args, len, &on_instrument, window);	// as glue_invoke
+ *	...
+ *	const auto collapsed = flights.collapsed();
+ *
+ * Every callback is called with its own cookie, in the order the invocations were made, on the Glue
+ * thread. Invocations made once the result arrived start a new flight - results are not cached (see
+ * GlueInvokeCache.h). Should the invocation which started a flight fail, the invocations attached
+ * to it are made on their own; the callback of one which fails again is called with a failure
+ * (status 1). Destroy a glue_single_flight only once the results of its invocations have been
+ * delivered. The header is C++14.
+ */
+
+/**
+ * \brief Collapses identical invocations in flight - thread safe.
+ */
+class glue_single_flight
+{
+public:
+	glue_single_flight() = default;
+	glue_single_flight(const glue_single_flight&) = delete;
+	glue_single_flight& operator=(const glue_single_flight&) = delete;
+
+	/**
+	 * \brief Invokes a single (best) method by name - as glue_invoke, unless an identical invocation is in flight.
+	 * \param epoch Part of the identity of an invocation - invocations of different epochs never share a flight
+	 * (e.g. a cache's generation, so invocations made after an invalidation do not get results from before it).
+	 * \return 0 if successful.
+	 */
+	int invoke(const char* endpoint_name, const glue_arg* args, int len, payload_function callback = nullptr, COOKIE cookie = nullptr, long long epoch = 0)
+	{
+		if (endpoint_name == nullptr)
+		{
+			return -1;
+		}
+
+		const auto hash = glue_hash_combine(glue_hash_combine(glue_string_hash(endpoint_name), glue_args_hash(args, len)), static_cast<uint64_t>(epoch));
+		std::shared_ptr<flight> started;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			const auto range = flights_.equal_range(hash);
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				auto& f = *it->second;
+				int flight_len;
+				const auto flight_args = glue_flat_args(f.args, flight_len);
+				if (f.epoch == epoch && f.endpoint_name == endpoint_name && glue_args_equal(flight_args, flight_len, args, len))
+				{
+					f.waiters.emplace_back(callback, cookie);
+					++collapsed_;
+					return 0;
+				}
+			}
+
+			started = std::make_shared<flight>(this, endpoint_name, hash, epoch, glue_flatten(args, len));
+			started->waiters.emplace_back(callback, cookie);
+			flights_.emplace(hash, started);
+			++flights_started_;
+		}
+
+		// the cookie holds a reference until the result arrives
+		const auto cookie_ref = new std::shared_ptr<flight>(started);
+		const auto invoked = glue_invoke(endpoint_name, args, len, &glue_single_flight::complete, cookie_ref);
+		if (invoked != 0)
+		{
+			delete cookie_ref;
+			// invocations attached meanwhile are made on their own - the callbacks of those failing as well get a failure
+			for (const auto& waiter : land(*started, true))
+			{
+				if (glue_invoke(endpoint_name, args, len, waiter.first, waiter.second) != 0 && waiter.first != nullptr)
+				{
+					const auto message = glarg_s("message", "invocation failed");
+					// no target responded - no origin
+					const glue_payload payload{ nullptr, "", 1, &message, 1 };
+					waiter.first(endpoint_name, waiter.second, &payload);
+				}
+			}
+		}
+		return invoked;
+	}
+
+	/**
+	 * \brief Invocations which went to glue_invoke - one per flight.
+	 */
+	long long flights() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return flights_started_;
+	}
+
+	/**
+	 * \brief Invocations attached to an identical one in flight instead of going to glue_invoke.
+	 */
+	long long collapsed() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return collapsed_;
+	}
+
+	size_t in_flight() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return flights_.size();
+	}
+
+private:
+	using waiter = std::pair<payload_function, COOKIE>;
+
+	struct flight
+	{
+		flight(glue_single_flight* owner, std::string endpoint_name, uint64_t hash, long long epoch, void* args)
+			: owner(owner), endpoint_name(std::move(endpoint_name)), hash(hash), epoch(epoch), args(args)
+		{
+		}
+
+		~flight()
+		{
+			glue_delete_flat(args);
+		}
+
+		glue_single_flight* owner;
+		std::string endpoint_name;
+		uint64_t hash;
+		long long epoch;
+		void* args;
+		// guarded by the owner's mutex - the first is the invocation which started the flight
+		std::vector<waiter> waiters;
+	};
+
+	static void complete(const char* origin, COOKIE cookie, const glue_payload* payload)
+	{
+		const std::unique_ptr<std::shared_ptr<flight>> ref(static_cast<std::shared_ptr<flight>*>(const_cast<void*>(cookie)));
+		auto& f = **ref;
+		for (const auto& waiter : f.owner->land(f, false))
+		{
+			if (waiter.first != nullptr)
+			{
+				waiter.first(origin, waiter.second, payload);
+			}
+		}
+	}
+
+	/**
+	 * \brief Ends a flight - later invocations start a new one.
+	 * \param followers_only Leave out the invocation which started the flight.
+	 * \return The invocations to deliver the result to.
+	 */
+	std::vector<waiter> land(flight& f, bool followers_only)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		const auto range = flights_.equal_range(f.hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->second.get() == &f)
+			{
+				flights_.erase(it);
+				break;
+			}
+		}
+
+		auto waiters = std::move(f.waiters);
+		if (followers_only)
+		{
+			waiters.erase(waiters.begin());
+			collapsed_ -= static_cast<long long>(waiters.size());
+			--flights_started_;
+		}
+		return waiters;
+	}
+
+	// guarded by the mutex
+	mutable std::mutex mutex_;
+	std::unordered_multimap<uint64_t, std::shared_ptr<flight>> flights_;
+	long long flights_started_ = 0;
+	long long collapsed_ = 0;
+};
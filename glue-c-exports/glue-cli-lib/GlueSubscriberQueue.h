@@ -0,0 +1,337 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "GlueCLILib.h"
+#include "GlueFlat.h"
+
+/*
+ * Bounded delivery queues for stream subscribers.
+ *
+ * A glue_queued_subscription takes the payloads of a stream off the Glue thread into a queue of its
+ * own and hands them to the subscriber's callback on a thread of its own, so a slow subscriber holds
+ * up neither the Glue thread nor the other subscriptions. The queue is bounded - once it is full, its
+ * policy decides what gives:
+ *
+ *	glue_queue_options options;
+ *	options.capacity = 4096;
+ *	options.policy = glue_overflow_policy::conflate;
+ *	options.key_field = "symbol";								// the latest quote per symbol
+ *	glue_queued_subscription quotes("quotes", &on_quote, cookie, options);
+ *	...
+ *	const auto metrics = quotes.metrics();						// drops, high-water mark...
+ *
+ * Payloads are deep copied into a single block each; delivered payloads are valid during the callback
+ * only and their reader is nullptr - read their args. Payloads still queued when the subscription is
+ * destroyed are discarded.
+ */
+
+/**
+ * \brief What a full queue does with another payload.
+ */
+enum class glue_overflow_policy
+{
+	// the Glue thread waits for room - nothing is lost, but every other delivery to the process waits as well
+	block,
+	// the oldest queued payload makes room
+	drop_oldest,
+	// the payload is dropped
+	drop_newest,
+	// the payload replaces the queued one with the same key - queued as drop_oldest when there is none
+	conflate,
+};
+
+struct glue_queue_options
+{
+	int capacity = 1024;
+	glue_overflow_policy policy = glue_overflow_policy::drop_oldest;
+	// conflate - the top-level arg keying the payloads (string, int or long); payloads without it are never replaced
+	std::string key_field;
+};
+
+/**
+ * \brief Counters of a queue, cumulative since the subscription was made.
+ */
+struct glue_queue_metrics
+{
+	long long received;
+	long long delivered;
+	// payloads lost to a full queue - the oldest or the newest
+	long long dropped;
+	// payloads replaced by a later one of the same key
+	long long conflated;
+	// payloads which waited for room
+	long long blocked;
+	int depth;
+	int high_water_mark;
+};
+
+/**
+ * \brief Subscription to a stream delivering through a bounded queue - thread safe.
+ * Destroy it (and so the subscription) before the callback's cookie.
+ */
+class glue_queued_subscription
+{
+public:
+	using subscribe_function = const void* (__cdecl*)(const char*, payload_function, const glue_arg*, int, COOKIE);
+
+	/**
+	 * \param subscribe glue_subscribe_stream or glue_subscribe_single_stream.
+	 */
+	glue_queued_subscription(const char* stream, payload_function callback, COOKIE cookie, const glue_queue_options& options = {},
+		const glue_arg* args = nullptr, int len = 0, subscribe_function subscribe = &glue_subscribe_stream)
+		: callback_(callback), cookie_(cookie), options_(options)
+	{
+		if (options_.capacity < 1)
+		{
+			options_.capacity = 1;
+		}
+		thread_ = std::thread([this] { run(); });
+		subscription_ = subscribe(stream, &glue_queued_subscription::receive, args, len, this);
+	}
+
+	glue_queued_subscription(const glue_queued_subscription&) = delete;
+	glue_queued_subscription& operator=(const glue_queued_subscription&) = delete;
+
+	~glue_queued_subscription()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		// releases a Glue thread waiting for room
+		room_.notify_all();
+		ready_.notify_one();
+		if (subscription_ != nullptr)
+		{
+			glue_destroy_resource(subscription_);
+		}
+		thread_.join();
+
+		for (const auto& queued : queue_)
+		{
+			glue_delete_flat(queued.block);
+		}
+	}
+
+	bool is_open() const
+	{
+		return subscription_ != nullptr;
+	}
+
+	glue_queue_metrics metrics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto metrics = metrics_;
+		metrics.depth = static_cast<int>(queue_.size());
+		return metrics;
+	}
+
+private:
+	struct queued_payload
+	{
+		void* block;
+		std::string origin;
+		int status;
+		// position in the sequence of all queued payloads
+		long long seq;
+		bool keyed;
+		std::string key;
+	};
+
+	static void receive(const char* origin, COOKIE cookie, const glue_payload* payload)
+	{
+		static_cast<glue_queued_subscription*>(const_cast<void*>(cookie))->enqueue(origin, payload);
+	}
+
+	/**
+	 * \brief The key of a payload for conflation - false if it has none.
+	 */
+	bool key_of(const glue_payload* payload, std::string& key) const
+	{
+		for (int i = 0; i < payload->args_len; ++i)
+		{
+			const auto& arg = payload->args[i];
+			if (arg.name == nullptr || options_.key_field != arg.name)
+			{
+				continue;
+			}
+
+			switch (arg.value.type)
+			{
+			case glue_type::glue_string:
+				key = arg.value.len < 0 && arg.value.s != nullptr ? arg.value.s : "";
+				return arg.value.len < 0;
+			case glue_type::glue_int:
+				key = std::to_string(arg.value.i);
+				return arg.value.len < 0;
+			case glue_type::glue_long:
+				key = std::to_string(arg.value.l);
+				return arg.value.len < 0;
+			default:
+				return false;
+			}
+		}
+		return false;
+	}
+
+	void enqueue(const char* origin, const glue_payload* payload)
+	{
+		std::string key;
+		const auto keyed = options_.policy == glue_overflow_policy::conflate && !options_.key_field.empty() && key_of(payload, key);
+		const auto block = glue_flatten(payload->args, payload->args_len);
+
+		void* released = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			++metrics_.received;
+			if (stopping_)
+			{
+				released = block;
+			}
+			else if (keyed && replace(key, block, origin, payload->status, released))
+			{
+				++metrics_.conflated;
+			}
+			else
+			{
+				if (static_cast<int>(queue_.size()) >= options_.capacity)
+				{
+					switch (options_.policy)
+					{
+					case glue_overflow_policy::block:
+						++metrics_.blocked;
+						room_.wait(lock, [this] { return stopping_ || static_cast<int>(queue_.size()) < options_.capacity; });
+						break;
+					case glue_overflow_policy::drop_newest:
+						++metrics_.dropped;
+						released = block;
+						break;
+					case glue_overflow_policy::drop_oldest:
+					case glue_overflow_policy::conflate:
+						++metrics_.dropped;
+						released = pop_front().block;
+						break;
+					}
+				}
+
+				if (stopping_)
+				{
+					released = block;
+				}
+				else if (released != block)
+				{
+					const auto seq = ++next_seq_;
+					if (keyed)
+					{
+						keys_[key] = seq;
+					}
+					queue_.push_back(queued_payload{ block, origin != nullptr ? origin : "", payload->status, seq, keyed, std::move(key) });
+					if (static_cast<int>(queue_.size()) > metrics_.high_water_mark)
+					{
+						metrics_.high_water_mark = static_cast<int>(queue_.size());
+					}
+					ready_.notify_one();
+				}
+			}
+		}
+		glue_delete_flat(released);
+	}
+
+	/**
+	 * \brief Replaces the queued payload of a key in place - call with the mutex locked.
+	 */
+	bool replace(const std::string& key, void* block, const char* origin, int status, void*& released)
+	{
+		const auto it = keys_.find(key);
+		if (it == keys_.end())
+		{
+			return false;
+		}
+
+		// queued payloads are numbered consecutively from the front
+		auto& queued = queue_[static_cast<size_t>(it->second - front_seq())];
+		released = queued.block;
+		queued.block = block;
+		queued.origin = origin != nullptr ? origin : "";
+		queued.status = status;
+		return true;
+	}
+
+	/**
+	 * \brief The seq of the first payload of the queue - call with the mutex locked.
+	 */
+	long long front_seq() const
+	{
+		return next_seq_ - static_cast<long long>(queue_.size()) + 1;
+	}
+
+	/**
+	 * \brief Removes the first payload of the queue - call with the mutex locked.
+	 */
+	queued_payload pop_front()
+	{
+		auto front = std::move(queue_.front());
+		queue_.pop_front();
+		if (front.keyed)
+		{
+			const auto it = keys_.find(front.key);
+			if (it != keys_.end() && it->second == front.seq)
+			{
+				keys_.erase(it);
+			}
+		}
+		return front;
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true)
+		{
+			ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+			if (stopping_)
+			{
+				return;
+			}
+
+			const auto queued = pop_front();
+			room_.notify_one();
+			lock.unlock();
+
+			int len;
+			const auto args = glue_flat_args(queued.block, len);
+			const glue_payload payload{ nullptr, queued.origin.c_str(), queued.status, args, len };
+			callback_(queued.origin.c_str(), cookie_, &payload);
+			glue_delete_flat(queued.block);
+
+			lock.lock();
+			++metrics_.delivered;
+		}
+	}
+
+	payload_function callback_;
+	COOKIE cookie_;
+	glue_queue_options options_;
+
+	// guarded by the mutex
+	mutable std::mutex mutex_;
+	std::condition_variable ready_;
+	std::condition_variable room_;
+	bool stopping_ = false;
+	std::deque<queued_payload> queue_;
+	// conflate - the seq of the queued payload of each key
+	std::unordered_map<std::string, long long> keys_;
+	long long next_seq_ = 0;
+	glue_queue_metrics metrics_{};
+
+	const void* subscription_ = nullptr;
+	std::thread thread_;
+};
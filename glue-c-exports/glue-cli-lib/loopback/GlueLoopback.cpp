@@ -0,0 +1,416 @@
+/*
+ * Loopback backend - the bus, its dispatcher, readers, resources and the process level exports.
+ */
+#include <string>
+
+#include "GlueLoopback.h"
+#include "../GlueJson.h"
+
+// dispatcher
+
+glue_loopback_dispatcher::glue_loopback_dispatcher() : thread_([this] { run(); })
+{
+}
+
+glue_loopback_dispatcher::~glue_loopback_dispatcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	wake_.notify_one();
+
+	// exiting from within a callback - the dispatcher can not wait for itself
+	if (on_dispatcher_thread())
+	{
+		thread_.detach();
+	}
+	else
+	{
+		thread_.join();
+	}
+}
+
+void glue_loopback_dispatcher::post(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		tasks_.push_back(std::move(task));
+	}
+	wake_.notify_one();
+}
+
+void glue_loopback_dispatcher::run()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (;;)
+	{
+		wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+		if (stopping_)
+		{
+			// callbacks still pending at exit are dropped - their targets may be gone already
+			return;
+		}
+
+		auto task = std::move(tasks_.front());
+		tasks_.pop_front();
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+}
+
+// bus
+
+glue_loopback& glue_loopback::instance()
+{
+	static glue_loopback bus;
+	return bus;
+}
+
+std::shared_ptr<const void> glue_loopback_encode(const glue_arg* args, int len)
+{
+	if (args == nullptr || len <= 0)
+	{
+		return nullptr;
+	}
+	return std::shared_ptr<const void>(glue_flatten(args, len), &glue_delete_flat);
+}
+
+std::shared_ptr<const void> glue_loopback_encode(const glue_value& value)
+{
+	return std::shared_ptr<const void>(glue_flatten(value), &glue_delete_flat);
+}
+
+const glue_value* glue_loopback_find(const glue_value& root, const char* field_path)
+{
+	const glue_value* v = &root;
+	for (auto segment = field_path; segment != nullptr && *segment != 0;)
+	{
+		if (v->type != glue_type::glue_composite || v->len < 0)
+		{
+			return nullptr;
+		}
+
+		const auto dot = strchr(segment, '.');
+		const auto len = dot != nullptr ? static_cast<size_t>(dot - segment) : strlen(segment);
+		const glue_value* found = nullptr;
+		for (int i = 0; i < v->len; ++i)
+		{
+			const auto name = v->composite[i].name;
+			if (name != nullptr && strncmp(name, segment, len) == 0 && name[len] == 0)
+			{
+				found = &v->composite[i].value;
+				break;
+			}
+		}
+		if (found == nullptr)
+		{
+			return nullptr;
+		}
+		v = found;
+		segment = dot != nullptr ? dot + 1 : nullptr;
+	}
+	return v;
+}
+
+// endpoint status
+
+struct glue_loopback_status_subscription : glue_loopback_resource
+{
+	glue_endpoint_status_callback_function callback;
+	COOKIE cookie;
+
+	void close() override
+	{
+		auto& bus = glue_loopback::instance();
+		std::lock_guard<std::mutex> lock(bus.mutex);
+		auto& subscriptions = bus.status_subscriptions;
+		for (auto it = subscriptions.begin(); it != subscriptions.end(); ++it)
+		{
+			if (it->get() == this)
+			{
+				subscriptions.erase(it);
+				break;
+			}
+		}
+	}
+};
+
+void glue_loopback::post_status(const std::string& endpoint_name, bool state)
+{
+	for (const auto& subscription : status_subscriptions)
+	{
+		post([subscription, endpoint_name, state, origin = app_name]
+			{
+				if (!subscription->closed)
+				{
+					subscription->callback(endpoint_name.c_str(), origin.c_str(), state, subscription->cookie);
+				}
+			});
+	}
+}
+
+const void* __cdecl glue_subscribe_endpoints_status(glue_endpoint_status_callback_function callback, COOKIE cookie)
+{
+	if (callback == nullptr)
+	{
+		return nullptr;
+	}
+
+	auto& bus = glue_loopback::instance();
+	const auto subscription = std::make_shared<glue_loopback_status_subscription>();
+	subscription->callback = callback;
+	subscription->cookie = cookie;
+
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	bus.status_subscriptions.push_back(subscription);
+
+	// the endpoints registered so far
+	for (const auto& method : bus.methods)
+	{
+		bus.post([subscription, name = method.name, origin = bus.app_name]
+			{
+				if (!subscription->closed)
+				{
+					subscription->callback(name.c_str(), origin.c_str(), true, subscription->cookie);
+				}
+			});
+	}
+	return bus.add(subscription);
+}
+
+// init
+
+int __cdecl glue_init(const char* app_name, glue_init_callback_function callback, COOKIE cookie)
+{
+	if (app_name == nullptr)
+	{
+		return -1;
+	}
+
+	auto& bus = glue_loopback::instance();
+	{
+		std::lock_guard<std::mutex> lock(bus.mutex);
+		bus.app_name = app_name;
+	}
+
+	if (callback != nullptr)
+	{
+		bus.post([callback, cookie]
+			{
+				callback(glue_state::connecting, "loopback", nullptr, cookie);
+				callback(glue_state::connected, "loopback", nullptr, cookie);
+				callback(glue_state::initialized, "loopback", nullptr, cookie);
+			});
+	}
+	return 0;
+}
+
+int __cdecl glue_set_save_state(invocation_callback_function, COOKIE)
+{
+	// nothing asks a loopback instance to save its state
+	return 0;
+}
+
+// windows and apps - registered, but without a Glue Desktop there are no window or app commands
+
+struct glue_loopback_window : glue_loopback_resource
+{
+};
+
+const void* __cdecl glue_register_window(HWND, glue_window_callback_function, const char*, COOKIE, bool)
+{
+	auto& bus = glue_loopback::instance();
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	return bus.add(std::make_shared<glue_loopback_window>());
+}
+
+const void* __cdecl glue_register_main_window(HWND, app_callback_function, glue_window_callback_function, const char*, COOKIE)
+{
+	auto& bus = glue_loopback::instance();
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	return bus.add(std::make_shared<glue_loopback_window>());
+}
+
+bool __cdecl glue_is_launched_by_gd()
+{
+	return false;
+}
+
+const void* __cdecl glue_get_starting_context_reader()
+{
+	// there is no starting context - an empty one
+	static glue_loopback_reader starting_context(nullptr, glv_comp(nullptr, 0));
+	return static_cast<const void*>(&starting_context);
+}
+
+const void* __cdecl glue_app_register_factory(const char*, app_callback_function, const char*, COOKIE)
+{
+	auto& bus = glue_loopback::instance();
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	return bus.add(std::make_shared<glue_loopback_window>());
+}
+
+int __cdecl glue_app_announce_instance(const void*, HWND, app_callback_function, glue_window_callback_function, COOKIE)
+{
+	return 0;
+}
+
+int __cdecl glue_gc()
+{
+	return 0;
+}
+
+// releasing - everything the loopback hands out is owned by a reader or a resource
+
+void glue_delete_value(const glue_value*)
+{
+}
+
+void glue_delete_args(const glue_arg*, int)
+{
+}
+
+void delete_glue_payloads(const glue_payload*, int)
+{
+}
+
+int __cdecl glue_destroy_resource(const void* resource)
+{
+	auto& bus = glue_loopback::instance();
+	std::shared_ptr<glue_loopback_resource> found;
+	{
+		std::lock_guard<std::mutex> lock(bus.mutex);
+		const auto it = bus.resources.find(resource);
+		if (it == bus.resources.end())
+		{
+			return -1;
+		}
+		found = std::move(it->second);
+		bus.resources.erase(it);
+	}
+
+	found->closed = true;
+	found->close();
+	return 0;
+}
+
+// pushing
+
+int __cdecl glue_push_payload(const void* endpoint, const glue_arg* args, int len)
+{
+	auto& bus = glue_loopback::instance();
+	std::shared_ptr<glue_loopback_resource> target;
+	{
+		std::lock_guard<std::mutex> lock(bus.mutex);
+		target = bus.find(endpoint);
+	}
+	return target != nullptr ? target->push(args, len) : -1;
+}
+
+int __cdecl glue_push_json_payload(const void* endpoint, const char* json)
+{
+	if (json == nullptr)
+	{
+		return -1;
+	}
+
+	thread_local glue_json_parser parser;
+	thread_local glue_arena arena;
+	const glue_arg* args;
+	int len;
+	const auto result = parser.parse_args(arena, json, strlen(json), args, len) == 0 ? glue_push_payload(endpoint, args, len) : -1;
+	arena.reset();
+	return result;
+}
+
+int __cdecl glue_push_failure(const void* endpoint, const char* message)
+{
+	auto& bus = glue_loopback::instance();
+	std::shared_ptr<glue_loopback_resource> target;
+	{
+		std::lock_guard<std::mutex> lock(bus.mutex);
+		target = bus.find(endpoint);
+	}
+	return target != nullptr ? target->fail(message != nullptr ? message : "") : -1;
+}
+
+// reading
+
+namespace
+{
+	const glue_value* glue_loopback_read(const void* reader, const char* field_path)
+	{
+		return reader != nullptr ? static_cast<const glue_loopback_reader*>(reader)->find(field_path) : nullptr;
+	}
+
+	/**
+	 * \brief Reads a number - converting between the numeric Glue types.
+	 */
+	template <typename T>
+	T glue_loopback_read_number(const void* reader, const char* field_path)
+	{
+		const auto v = glue_loopback_read(reader, field_path);
+		if (v == nullptr || v->len >= 0)
+		{
+			return T{};
+		}
+
+		switch (v->type)
+		{
+		case glue_type::glue_bool: return static_cast<T>(v->b);
+		case glue_type::glue_int: return static_cast<T>(v->i);
+		case glue_type::glue_long:
+		case glue_type::glue_datetime: return static_cast<T>(v->l);
+		case glue_type::glue_double: return static_cast<T>(v->d);
+		default: return T{};
+		}
+	}
+}
+
+const char* __cdecl glue_read_json(const void* reader, const char* field_path)
+{
+	const auto v = glue_loopback_read(reader, field_path);
+	if (v == nullptr)
+	{
+		return nullptr;
+	}
+
+	thread_local std::string json;
+	json.clear();
+	glue_write_json(*v, json);
+	return const_cast<glue_loopback_reader*>(static_cast<const glue_loopback_reader*>(reader))->keep(json);
+}
+
+glue_value __cdecl glue_read_glue_value(const void* reader, const char* field_path)
+{
+	const auto v = glue_loopback_read(reader, field_path);
+	return v != nullptr ? *v : glue_value{};
+}
+
+bool __cdecl glue_read_b(const void* reader, const char* field_path)
+{
+	return glue_loopback_read_number<bool>(reader, field_path);
+}
+
+int __cdecl glue_read_i(const void* reader, const char* field_path)
+{
+	return glue_loopback_read_number<int>(reader, field_path);
+}
+
+long long __cdecl glue_read_l(const void* reader, const char* field_path)
+{
+	return glue_loopback_read_number<long long>(reader, field_path);
+}
+
+double __cdecl glue_read_d(const void* reader, const char* field_path)
+{
+	return glue_loopback_read_number<double>(reader, field_path);
+}
+
+const char* __cdecl glue_read_s(const void* reader, const char* field_path)
+{
+	const auto v = glue_loopback_read(reader, field_path);
+	return v != nullptr && v->type == glue_type::glue_string && v->len < 0 ? v->s : nullptr;
+}
@@ -0,0 +1,256 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../GlueCLILib.h"
+#include "../GlueArena.h"
+#include "../GlueFlat.h"
+
+/*
+ * In-process loopback backend of the GlueCLILib C API.
+ *
+ * Implements every export of GlueCLILib.h within the process - endpoints, invocations, streams and
+ * contexts registered by the process are served to the process itself - so programs written against
+ * the C API build and run on platforms without GlueCLILib.dll, e.g. for profiling on Linux.
+ *
+ * Threading follows GlueCLILib: all callbacks are invoked on a single Glue thread, in the order their
+ * events happened, while the API may be called from any thread, including from within callbacks.
+ * Payloads are deep copied into flat blocks (GlueFlat.h) when pushed, so the pushed args may be
+ * released as soon as the push returns; delivered payloads and their readers are valid during the
+ * callback only. Readers of contexts hold a snapshot of the context until destroyed.
+ *
+ * Invocation results have status 0, failures status 1 with the failure text as their 'message' arg.
+ * Values read from readers are owned by the readers - glue_delete_value and the other delete functions
+ * have nothing to release for the loopback.
+ */
+
+/**
+ * \brief An immutable payload - the args in a flat block (nullptr for no args) and their origin.
+ */
+struct glue_loopback_message
+{
+	std::shared_ptr<const void> block;
+	std::string origin;
+	int status = 0;
+
+	const glue_arg* args(int& len) const
+	{
+		len = 0;
+		return block != nullptr ? glue_flat_args(block.get(), len) : nullptr;
+	}
+};
+
+/**
+ * \brief Deep copies args into a flat block shared by all deliveries of a payload.
+ */
+std::shared_ptr<const void> glue_loopback_encode(const glue_arg* args, int len);
+
+/**
+ * \brief Deep copies a value into a flat block.
+ */
+std::shared_ptr<const void> glue_loopback_encode(const glue_value& value);
+
+/**
+ * \brief Resolves a dot-separated field path in a value - nullptr for missing fields, the value itself for "" or nullptr.
+ */
+const glue_value* glue_loopback_find(const glue_value& root, const char* field_path);
+
+/**
+ * \brief Base of everything handed out as a const void* reference - destroyed via glue_destroy_resource.
+ */
+class glue_loopback_resource
+{
+public:
+	virtual ~glue_loopback_resource() = default;
+
+	/**
+	 * \brief Handles glue_push_payload/glue_push_json_payload to the resource.
+	 */
+	virtual int push(const glue_arg*, int)
+	{
+		return -1;
+	}
+
+	/**
+	 * \brief Handles glue_push_failure to the resource.
+	 */
+	virtual int fail(const char*)
+	{
+		return -1;
+	}
+
+	/**
+	 * \brief Unlinks the resource from the bus - called once, with the bus unlocked.
+	 */
+	virtual void close()
+	{
+	}
+
+	std::atomic<bool> closed{ false };
+};
+
+/**
+ * \brief Reader over a payload or a context snapshot - also the storage of the results of glue_read_ calls.
+ * Readers of payloads live on the dispatcher's stack, readers of contexts are resources.
+ */
+class glue_loopback_reader : public glue_loopback_resource
+{
+public:
+	glue_loopback_reader(std::shared_ptr<const void> block, glue_value root) : block_(std::move(block)), root_(root)
+	{
+	}
+
+	const glue_value& root() const
+	{
+		return root_;
+	}
+
+	const glue_value* find(const char* field_path) const
+	{
+		return glue_loopback_find(root_, field_path);
+	}
+
+	/**
+	 * \brief Copies a string into storage living as long as the reader.
+	 */
+	const char* keep(const std::string& s)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return arena_.copy_string(s.c_str());
+	}
+
+private:
+	std::shared_ptr<const void> block_;
+	glue_value root_;
+	std::mutex mutex_;
+	glue_arena arena_;
+};
+
+/**
+ * \brief Runs the callbacks of the bus, one at a time and in order, on its own thread.
+ */
+class glue_loopback_dispatcher
+{
+public:
+	glue_loopback_dispatcher();
+	~glue_loopback_dispatcher();
+
+	void post(std::function<void()> task);
+
+	bool on_dispatcher_thread() const
+	{
+		return std::this_thread::get_id() == thread_.get_id();
+	}
+
+private:
+	void run();
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::deque<std::function<void()>> tasks_;
+	bool stopping_ = false;
+	std::thread thread_;
+};
+
+class glue_loopback_stream;
+class glue_loopback_stream_subscription;
+struct glue_loopback_context;
+struct glue_loopback_status_subscription;
+
+/**
+ * \brief A registered invocation target - a method or a streaming endpoint with an invocation callback.
+ */
+struct glue_loopback_method
+{
+	std::string name;
+	invocation_callback_function callback;
+	COOKIE cookie;
+	// the stream the method was registered with or nullptr
+	glue_loopback_stream* stream;
+};
+
+/**
+ * \brief The process-wide state of the loopback - guarded by its mutex; callbacks are posted to the dispatcher.
+ */
+class glue_loopback
+{
+public:
+	static glue_loopback& instance();
+
+	std::mutex mutex;
+	std::string app_name = "loopback";
+
+	std::unordered_map<const void*, std::shared_ptr<glue_loopback_resource>> resources;
+	std::vector<glue_loopback_method> methods;
+	std::vector<std::shared_ptr<glue_loopback_stream>> streams;
+	std::vector<std::shared_ptr<glue_loopback_stream_subscription>> stream_subscriptions;
+	std::vector<std::shared_ptr<glue_loopback_status_subscription>> status_subscriptions;
+	std::unordered_map<std::string, std::shared_ptr<glue_loopback_context>> contexts;
+
+	/**
+	 * \brief Registers a resource and returns its reference - call with the mutex locked.
+	 */
+	template <typename T>
+	const void* add(std::shared_ptr<T> resource)
+	{
+		const void* reference = resource.get();
+		resources.emplace(reference, std::move(resource));
+		return reference;
+	}
+
+	/**
+	 * \brief Finds a live resource by reference - call with the mutex locked.
+	 */
+	std::shared_ptr<glue_loopback_resource> find(const void* reference)
+	{
+		const auto it = resources.find(reference);
+		return it != resources.end() ? it->second : nullptr;
+	}
+
+	template <typename T>
+	std::shared_ptr<T> find(const void* reference)
+	{
+		return std::dynamic_pointer_cast<T>(find(reference));
+	}
+
+	template <typename F>
+	void post(F&& task)
+	{
+		dispatcher_.post(std::forward<F>(task));
+	}
+
+	/**
+	 * \brief Posts an endpoint status change to all status subscribers - call with the mutex locked.
+	 */
+	void post_status(const std::string& endpoint_name, bool state);
+
+	/**
+	 * \brief Offers a stream subscription to the matching streams - call with the mutex locked.
+	 */
+	void attach(const std::shared_ptr<glue_loopback_stream_subscription>& subscription);
+
+private:
+	glue_loopback_dispatcher dispatcher_;
+};
+
+/**
+ * \brief Invokes a payload callback with a payload and its reader - on the dispatcher thread.
+ */
+template <typename F>
+void glue_loopback_deliver(const glue_loopback_message& message, F&& callback)
+{
+	int len;
+	const auto args = message.args(len);
+	glue_loopback_reader reader(message.block, glv_comp(const_cast<glue_arg*>(args), len));
+	const glue_payload payload{ static_cast<const void*>(&reader), message.origin.c_str(), message.status, args, len };
+	callback(&payload);
+}
@@ -0,0 +1,258 @@
+/*
+ * Loopback backend - contexts (channels).
+ *
+ * A context is an immutable snapshot - a flat block of its root composite. Writes build the new root
+ * from the old one - only the written path is copied, the tree shares every other subtree of the old
+ * snapshot - and flatten it into the next snapshot; readers and pending callbacks keep the snapshot
+ * they were given alive. Snapshots share nothing with each other: flattening copies the whole root,
+ * so every write costs O(size of the context), under the bus mutex.
+ */
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "GlueLoopback.h"
+
+class glue_loopback_context_subscription : public glue_loopback_resource
+{
+public:
+	std::string context;
+	std::string field_path;
+	context_function callback;
+	COOKIE cookie;
+
+	void close() override;
+};
+
+struct glue_loopback_context
+{
+	std::shared_ptr<const void> snapshot;
+	std::vector<std::shared_ptr<glue_loopback_context_subscription>> subscriptions;
+
+	glue_value root() const
+	{
+		return snapshot != nullptr ? glue_flat_value(snapshot.get()) : glv_comp(nullptr, 0);
+	}
+};
+
+void glue_loopback_context_subscription::close()
+{
+	auto& bus = glue_loopback::instance();
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	const auto it = bus.contexts.find(context);
+	if (it != bus.contexts.end())
+	{
+		auto& subscriptions = it->second->subscriptions;
+		subscriptions.erase(std::remove_if(subscriptions.begin(), subscriptions.end(),
+			[this](const std::shared_ptr<glue_loopback_context_subscription>& s) { return s.get() == this; }), subscriptions.end());
+	}
+}
+
+namespace
+{
+	/**
+	 * \brief Gets a context by name, creating an empty one - call with the bus locked.
+	 */
+	glue_loopback_context& glue_loopback_get_context(glue_loopback& bus, const std::string& name)
+	{
+		auto& context = bus.contexts[name];
+		if (context == nullptr)
+		{
+			context = std::make_shared<glue_loopback_context>();
+		}
+		return *context;
+	}
+
+	/**
+	 * \brief True if a write at one path changes the value at the other - one is a prefix of the other.
+	 */
+	bool glue_loopback_paths_overlap(const std::string& a, const std::string& b)
+	{
+		const auto len = std::min(a.size(), b.size());
+		return a.compare(0, len, b, 0, len) == 0 && (a.size() == b.size() || len == 0 || (a.size() > len ? a[len] : b[len]) == '.');
+	}
+
+	/**
+	 * \brief Copies the path from the root to the written field, replacing the field - glue_none values remove it.
+	 */
+	glue_value glue_loopback_replace(glue_arena& arena, const glue_value& root, const char* field_path, const glue_value& value)
+	{
+		if (field_path == nullptr || *field_path == 0)
+		{
+			return value;
+		}
+
+		const auto dot = strchr(field_path, '.');
+		const auto len = dot != nullptr ? static_cast<size_t>(dot - field_path) : strlen(field_path);
+		const auto rest = dot != nullptr ? dot + 1 : "";
+		const auto remove = value.type == glue_type::glue_none && *rest == 0;
+
+		const auto composite = root.type == glue_type::glue_composite && root.len > 0;
+		const auto count = composite ? root.len : 0;
+		const auto args = arena.alloc<glue_arg>(static_cast<size_t>(count) + 1);
+		int written = 0;
+		bool found = false;
+		for (int i = 0; i < count; ++i)
+		{
+			const auto& arg = root.composite[i];
+			if (found || arg.name == nullptr || strncmp(arg.name, field_path, len) != 0 || arg.name[len] != 0)
+			{
+				args[written++] = arg;
+				continue;
+			}
+
+			found = true;
+			if (!remove)
+			{
+				args[written++] = glue_arg{ arg.name, glue_loopback_replace(arena, arg.value, rest, value) };
+			}
+		}
+
+		if (!found && !remove)
+		{
+			const auto name = arena.alloc<char>(len + 1);
+			memcpy(name, field_path, len);
+			name[len] = 0;
+			args[written++] = glue_arg{ name, glue_loopback_replace(arena, glue_value{}, rest, value) };
+		}
+		return glv_comp(args, written);
+	}
+
+	/**
+	 * \brief Posts a context callback with the value at a path of a snapshot.
+	 */
+	void glue_loopback_post_value(glue_loopback& bus, const std::string& context, const std::string& field_path, std::shared_ptr<const void> snapshot,
+		context_function callback, COOKIE cookie, std::shared_ptr<glue_loopback_context_subscription> subscription)
+	{
+		bus.post([context, field_path, snapshot = std::move(snapshot), callback, cookie, subscription = std::move(subscription)]
+			{
+				if (subscription != nullptr && subscription->closed)
+				{
+					return;
+				}
+				const auto root = snapshot != nullptr ? glue_flat_value(snapshot.get()) : glv_comp(nullptr, 0);
+				callback(context.c_str(), field_path.c_str(), glue_loopback_find(root, field_path.c_str()), cookie);
+			});
+	}
+
+	/**
+	 * \brief Writes a value at a field path of a context and notifies the subscribers of the fields it changes.
+	 */
+	int glue_loopback_write(const std::string& name, const char* field_path, const glue_value& value)
+	{
+		thread_local glue_arena arena;
+		auto& bus = glue_loopback::instance();
+		std::lock_guard<std::mutex> lock(bus.mutex);
+		auto& context = glue_loopback_get_context(bus, name);
+
+		auto root = glue_loopback_replace(arena, context.root(), field_path, value);
+		if (root.type != glue_type::glue_composite || root.len < 0)
+		{
+			// contexts are objects - writing a scalar to the root clears them
+			root = glv_comp(nullptr, 0);
+		}
+		context.snapshot = glue_loopback_encode(root);
+		arena.reset();
+
+		const std::string path = field_path != nullptr ? field_path : "";
+		for (const auto& subscription : context.subscriptions)
+		{
+			if (glue_loopback_paths_overlap(subscription->field_path, path))
+			{
+				glue_loopback_post_value(bus, name, subscription->field_path, context.snapshot, subscription->callback, subscription->cookie, subscription);
+			}
+		}
+		return 0;
+	}
+}
+
+/**
+ * \brief Writes pushed args to a field of a context.
+ */
+class glue_loopback_context_writer : public glue_loopback_resource
+{
+public:
+	glue_loopback_context_writer(std::string context, std::string field_path) : context_(std::move(context)), field_path_(std::move(field_path))
+	{
+	}
+
+	int push(const glue_arg* args, int len) override
+	{
+		return glue_loopback_write(context_, field_path_.c_str(), glv_comp(const_cast<glue_arg*>(args), args != nullptr ? len : 0));
+	}
+
+private:
+	std::string context_;
+	std::string field_path_;
+};
+
+int __cdecl glue_write_context(const char* context, const char* field_path, glue_value value)
+{
+	if (context == nullptr)
+	{
+		return -1;
+	}
+	return glue_loopback_write(context, field_path, value);
+}
+
+const void* __cdecl glue_get_context_writer(const char* context, const char* field_path)
+{
+	if (context == nullptr)
+	{
+		return nullptr;
+	}
+
+	auto& bus = glue_loopback::instance();
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	return bus.add(std::make_shared<glue_loopback_context_writer>(context, field_path != nullptr ? field_path : ""));
+}
+
+const void* __cdecl glue_read_context_sync(const char* context)
+{
+	if (context == nullptr)
+	{
+		return nullptr;
+	}
+
+	auto& bus = glue_loopback::instance();
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	const auto& found = glue_loopback_get_context(bus, context);
+	return bus.add(std::make_shared<glue_loopback_reader>(found.snapshot, found.root()));
+}
+
+int __cdecl glue_read_context(const char* context, const char* field_path, context_function callback, COOKIE cookie)
+{
+	if (context == nullptr || callback == nullptr)
+	{
+		return -1;
+	}
+
+	auto& bus = glue_loopback::instance();
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	const auto& found = glue_loopback_get_context(bus, context);
+	glue_loopback_post_value(bus, context, field_path != nullptr ? field_path : "", found.snapshot, callback, cookie, nullptr);
+	return 0;
+}
+
+const void* __cdecl glue_subscribe_context(const char* context, const char* field_path, context_function callback, COOKIE cookie)
+{
+	if (context == nullptr || callback == nullptr)
+	{
+		return nullptr;
+	}
+
+	auto& bus = glue_loopback::instance();
+	const auto subscription = std::make_shared<glue_loopback_context_subscription>();
+	subscription->context = context;
+	subscription->field_path = field_path != nullptr ? field_path : "";
+	subscription->callback = callback;
+	subscription->cookie = cookie;
+
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	auto& found = glue_loopback_get_context(bus, context);
+	found.subscriptions.push_back(subscription);
+
+	// the current value first
+	glue_loopback_post_value(bus, subscription->context, subscription->field_path, found.snapshot, callback, cookie, subscription);
+	return bus.add(subscription);
+}
@@ -0,0 +1,697 @@
+/*
+ * Loopback backend - methods, invocations and streams.
+ */
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "GlueLoopback.h"
+#include "GlueLoopbackInvoke.h"
+#include "GlueLoopbackStats.h"
+#include "../GlueHash.h"
+
+namespace
+{
+	glue_loopback_message glue_loopback_failure(const char* message, std::string origin)
+	{
+		const auto arg = glarg_s("message", message);
+		return glue_loopback_message{ glue_loopback_encode(&arg, 1), std::move(origin), 1 };
+	}
+}
+
+/**
+ * \brief A pending invocation of a single target - the endpoint reference its result is pushed to.
+ */
+class glue_loopback_invocation : public glue_loopback_resource
+{
+public:
+	explicit glue_loopback_invocation(std::function<void(glue_loopback_message)> complete) : complete_(std::move(complete))
+	{
+	}
+
+	int push(const glue_arg* args, int len) override
+	{
+		return finish(glue_loopback_message{ glue_loopback_encode(args, len), origin(), 0 });
+	}
+
+	int fail(const char* message) override
+	{
+		return finish(glue_loopback_failure(message, origin()));
+	}
+
+private:
+	static std::string origin()
+	{
+		auto& bus = glue_loopback::instance();
+		std::lock_guard<std::mutex> lock(bus.mutex);
+		return bus.app_name;
+	}
+
+	/**
+	 * \brief Completes the invocation - an invocation has a single result, later pushes fail.
+	 */
+	int finish(glue_loopback_message result)
+	{
+		if (done_.exchange(true))
+		{
+			return -1;
+		}
+
+		auto& bus = glue_loopback::instance();
+		{
+			std::lock_guard<std::mutex> lock(bus.mutex);
+			bus.resources.erase(this);
+		}
+		complete_(std::move(result));
+		return 0;
+	}
+
+	std::function<void(glue_loopback_message)> complete_;
+	std::atomic<bool> done_{ false };
+};
+
+/**
+ * \brief Starts an invocation of a method - call with the bus locked.
+ * \param complete Called with the result once pushed - from the pushing thread.
+ */
+static void glue_loopback_start_invocation(glue_loopback& bus, const glue_loopback_method& method, const glue_loopback_message& request, std::function<void(glue_loopback_message)> complete)
+{
+	const auto reference = bus.add(std::make_shared<glue_loopback_invocation>(std::move(complete)));
+	bus.post([method, request, reference]
+		{
+			glue_loopback_deliver(request, [&](const glue_payload* payload)
+				{
+					method.callback(method.name.c_str(), method.cookie, payload, reference);
+				});
+		});
+}
+
+int __cdecl glue_register_endpoint(const char* endpoint_name, invocation_callback_function callback, COOKIE cookie)
+{
+	if (endpoint_name == nullptr || callback == nullptr)
+	{
+		return -1;
+	}
+
+	auto& bus = glue_loopback::instance();
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	for (const auto& method : bus.methods)
+	{
+		if (method.name == endpoint_name)
+		{
+			return -1;
+		}
+	}
+
+	bus.methods.push_back(glue_loopback_method{ endpoint_name, callback, cookie, nullptr });
+	bus.post_status(endpoint_name, true);
+	return 0;
+}
+
+/**
+ * \brief The methods of a name - call with the bus locked.
+ */
+static std::vector<glue_loopback_method> glue_loopback_targets(const glue_loopback& bus, const std::string& name)
+{
+	std::vector<glue_loopback_method> targets;
+	std::copy_if(bus.methods.begin(), bus.methods.end(), std::back_inserter(targets), [&](const glue_loopback_method& m) { return m.name == name; });
+	return targets;
+}
+
+/**
+ * \brief Completion of an invocation delivering its result to a payload callback - on the dispatcher thread.
+ */
+static std::function<void(glue_loopback_message)> glue_loopback_deliver_result(glue_loopback& bus, std::string name, payload_function callback, COOKIE cookie)
+{
+	return [&bus, name, callback, cookie](glue_loopback_message result)
+	{
+		if (callback == nullptr)
+		{
+			return;
+		}
+		bus.post([name, callback, cookie, result]
+			{
+				glue_loopback_deliver(result, [&](const glue_payload* payload)
+					{
+						callback(name.c_str(), cookie, payload);
+					});
+			});
+	};
+}
+
+int __cdecl glue_invoke(const char* endpoint_name, const glue_arg* args, int len, payload_function callback, COOKIE cookie)
+{
+	if (endpoint_name == nullptr)
+	{
+		return -1;
+	}
+
+	auto& bus = glue_loopback::instance();
+	std::string name = endpoint_name;
+	const auto deliver = glue_loopback_deliver_result(bus, name, callback, cookie);
+
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	const auto method = std::find_if(bus.methods.begin(), bus.methods.end(), [&](const glue_loopback_method& m) { return m.name == name; });
+	if (method == bus.methods.end())
+	{
+		deliver(glue_loopback_failure("no such method", bus.app_name));
+		return 0;
+	}
+
+	const glue_loopback_message request{ glue_loopback_encode(args, len), bus.app_name, 0 };
+	glue_loopback_start_invocation(bus, *method, request, deliver);
+	return 0;
+}
+
+/**
+ * \brief The results of a glue_invoke_all - delivered together once every target has responded.
+ */
+struct glue_loopback_gather : std::enable_shared_from_this<glue_loopback_gather>
+{
+	std::string name;
+	multiple_payloads_function callback;
+	COOKIE cookie;
+
+	std::mutex mutex;
+	std::vector<glue_loopback_message> results;
+	size_t pending = 0;
+
+	void complete(size_t index, glue_loopback_message result)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			results[index] = std::move(result);
+			if (--pending > 0)
+			{
+				return;
+			}
+		}
+		deliver();
+	}
+
+	void deliver()
+	{
+		if (callback == nullptr)
+		{
+			return;
+		}
+
+		glue_loopback::instance().post([this, keep = shared_from_this()]
+			{
+				std::deque<glue_loopback_reader> readers;
+				std::vector<glue_payload> payloads;
+				for (const auto& result : results)
+				{
+					int len;
+					const auto args = result.args(len);
+					readers.emplace_back(result.block, glv_comp(const_cast<glue_arg*>(args), len));
+					payloads.push_back(glue_payload{ static_cast<const void*>(&readers.back()), result.origin.c_str(), result.status, args, len });
+				}
+				callback(name.c_str(), cookie, payloads.data(), static_cast<int>(payloads.size()));
+			});
+	}
+};
+
+int __cdecl glue_invoke_all(const char* endpoint_name, const glue_arg* args, int len, multiple_payloads_function callback, COOKIE cookie)
+{
+	if (endpoint_name == nullptr)
+	{
+		return -1;
+	}
+
+	auto& bus = glue_loopback::instance();
+	const auto gather = std::make_shared<glue_loopback_gather>();
+	gather->name = endpoint_name;
+	gather->callback = callback;
+	gather->cookie = cookie;
+
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	const auto targets = glue_loopback_targets(bus, gather->name);
+	gather->results.resize(targets.size());
+	gather->pending = targets.size();
+	if (targets.empty())
+	{
+		gather->deliver();
+		return 0;
+	}
+
+	const glue_loopback_message request{ glue_loopback_encode(args, len), bus.app_name, 0 };
+	for (size_t i = 0; i < targets.size(); ++i)
+	{
+		glue_loopback_start_invocation(bus, targets[i], request, [gather, i](glue_loopback_message result)
+			{
+				gather->complete(i, std::move(result));
+			});
+	}
+	return 0;
+}
+
+int __cdecl glue_invoke_each(const char* endpoint_name, const glue_arg* args, int len, payload_function callback, COOKIE cookie)
+{
+	if (endpoint_name == nullptr)
+	{
+		return -1;
+	}
+
+	auto& bus = glue_loopback::instance();
+	std::string name = endpoint_name;
+	const auto deliver = glue_loopback_deliver_result(bus, name, callback, cookie);
+
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	const auto targets = glue_loopback_targets(bus, name);
+	const glue_loopback_message request{ glue_loopback_encode(args, len), bus.app_name, 0 };
+	for (const auto& target : targets)
+	{
+		glue_loopback_start_invocation(bus, target, request, deliver);
+	}
+	return static_cast<int>(targets.size());
+}
+
+// streams
+
+/**
+ * \brief A subscription to all (or the best) streams of a name - attached to streams as they accept it.
+ */
+class glue_loopback_stream_subscription : public glue_loopback_resource
+{
+public:
+	std::string stream;
+	payload_function callback;
+	COOKIE cookie;
+	bool single;
+	glue_loopback_message request;
+	// the number of streams it was offered to - guarded by the bus
+	int offered = 0;
+
+	void close() override;
+};
+
+/**
+ * \brief A branch of a stream - pushes reach the subscribers assigned to it.
+ */
+class glue_loopback_branch : public glue_loopback_resource
+{
+public:
+	glue_loopback_branch(std::shared_ptr<glue_loopback_stream> stream, std::string name) : stream_(std::move(stream)), name_(std::move(name))
+	{
+	}
+
+	int push(const glue_arg* args, int len) override;
+
+	/**
+	 * \brief Gets the stream or nullptr once it is destroyed - call with the bus locked.
+	 */
+	std::shared_ptr<glue_loopback_stream> stream() const
+	{
+		return stream_;
+	}
+
+	/**
+	 * \brief Drops the stream - call with the bus locked.
+	 */
+	void release()
+	{
+		stream_ = nullptr;
+	}
+
+private:
+	// released when the stream is destroyed
+	std::shared_ptr<glue_loopback_stream> stream_;
+	std::string name_;
+};
+
+class glue_loopback_stream : public glue_loopback_resource
+{
+public:
+	struct subscriber
+	{
+		std::shared_ptr<glue_loopback_stream_subscription> subscription;
+		// "" for the main branch
+		std::string branch;
+	};
+
+	std::string name;
+	stream_callback_function accept;
+	invocation_callback_function invoke;
+	COOKIE cookie;
+
+	// guarded by the bus
+	std::vector<subscriber> subscribers;
+	std::vector<std::pair<std::string, std::shared_ptr<glue_loopback_branch>>> branches;
+
+	/**
+	 * \brief Counters and timings of the stream's pushes - shared with the deliveries in flight.
+	 */
+	struct statistics
+	{
+		std::atomic<long long> pushes{ 0 };
+		std::atomic<long long> encodes{ 0 };
+		std::atomic<long long> deliveries{ 0 };
+		std::atomic<long long> encode_ns{ 0 };
+		std::atomic<long long> fan_out_ns{ 0 };
+		std::atomic<long long> last_encode_ns{ 0 };
+		std::atomic<long long> last_fan_out_ns{ 0 };
+	};
+
+	const std::shared_ptr<statistics> stats = std::make_shared<statistics>();
+
+	int push(const glue_arg* args, int len) override
+	{
+		return publish(nullptr, args, len);
+	}
+
+	/**
+	 * \brief Pushes to the subscribers of a branch or, for nullptr, to all subscribers - encoding the args once
+	 * into a buffer shared by all of them.
+	 */
+	int publish(const std::string* branch, const glue_arg* args, int len)
+	{
+		auto& bus = glue_loopback::instance();
+		std::vector<std::shared_ptr<glue_loopback_stream_subscription>> targets;
+		glue_loopback_message message;
+		bool branched;
+		{
+			std::lock_guard<std::mutex> lock(bus.mutex);
+			if (closed)
+			{
+				return -1;
+			}
+			for (const auto& s : subscribers)
+			{
+				if (branch == nullptr || s.branch == *branch)
+				{
+					targets.push_back(s.subscription);
+				}
+			}
+			message.origin = bus.app_name;
+			branched = !branches.empty();
+		}
+		if (targets.empty())
+		{
+			return 0;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		message.block = branched ? encode_shared(args, len) : encode(args, len);
+		const auto encode_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		stats->pushes.fetch_add(1, std::memory_order_relaxed);
+		stats->encode_ns.fetch_add(encode_ns, std::memory_order_relaxed);
+		stats->last_encode_ns.store(encode_ns, std::memory_order_relaxed);
+
+		bus.post([targets = std::move(targets), message = std::move(message), stream = name, stats = stats]
+			{
+				const auto start = std::chrono::steady_clock::now();
+				long long delivered = 0;
+				for (const auto& subscription : targets)
+				{
+					if (subscription->closed)
+					{
+						continue;
+					}
+					glue_loopback_deliver(message, [&](const glue_payload* payload)
+						{
+							subscription->callback(stream.c_str(), subscription->cookie, payload);
+						});
+					++delivered;
+				}
+				const auto fan_out_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+				stats->deliveries.fetch_add(delivered, std::memory_order_relaxed);
+				stats->fan_out_ns.fetch_add(fan_out_ns, std::memory_order_relaxed);
+				stats->last_fan_out_ns.store(fan_out_ns, std::memory_order_relaxed);
+			});
+		return 0;
+	}
+
+	/**
+	 * \brief Asks the stream's callback to accept a subscription - on the dispatcher thread.
+	 */
+	void offer(const std::shared_ptr<glue_loopback_stream>& self, const std::shared_ptr<glue_loopback_stream_subscription>& subscription)
+	{
+		glue_loopback::instance().post([self, subscription]
+			{
+				const char* branch = nullptr;
+				auto accepted = true;
+				if (self->accept != nullptr)
+				{
+					glue_loopback_deliver(subscription->request, [&](const glue_payload* payload)
+						{
+							accepted = self->accept(self->name.c_str(), self->cookie, payload, branch);
+						});
+				}
+				if (!accepted)
+				{
+					return;
+				}
+
+				auto& bus = glue_loopback::instance();
+				std::lock_guard<std::mutex> lock(bus.mutex);
+				if (!self->closed && !subscription->closed)
+				{
+					self->subscribers.push_back(subscriber{ subscription, branch != nullptr ? branch : "" });
+				}
+			});
+	}
+
+	void close() override
+	{
+		{
+			std::lock_guard<std::mutex> lock(last_mutex_);
+			last_block_ = nullptr;
+		}
+
+		auto& bus = glue_loopback::instance();
+		std::lock_guard<std::mutex> lock(bus.mutex);
+		bus.streams.erase(std::remove_if(bus.streams.begin(), bus.streams.end(),
+			[this](const std::shared_ptr<glue_loopback_stream>& s) { return s.get() == this; }), bus.streams.end());
+		if (invoke != nullptr)
+		{
+			bus.methods.erase(std::remove_if(bus.methods.begin(), bus.methods.end(),
+				[this](const glue_loopback_method& m) { return m.stream == this; }), bus.methods.end());
+		}
+		for (const auto& branch : branches)
+		{
+			branch.second->closed = true;
+			branch.second->release();
+			bus.resources.erase(branch.second.get());
+		}
+		branches.clear();
+		subscribers.clear();
+		bus.post_status(name, false);
+	}
+
+private:
+	std::shared_ptr<const void> encode(const glue_arg* args, int len)
+	{
+		auto block = glue_loopback_encode(args, len);
+		stats->encodes.fetch_add(block != nullptr ? 1 : 0, std::memory_order_relaxed);
+		return block;
+	}
+
+	/**
+	 * \brief Encodes args unless they equal the last payload pushed - publishers of streams with branches
+	 * often push the same data to several of them, which then share one buffer.
+	 */
+	std::shared_ptr<const void> encode_shared(const glue_arg* args, int len)
+	{
+		if (args == nullptr || len <= 0)
+		{
+			return nullptr;
+		}
+
+		std::shared_ptr<const void> last;
+		{
+			std::lock_guard<std::mutex> lock(last_mutex_);
+			last = last_block_;
+		}
+		if (last != nullptr)
+		{
+			// a comparison stops at the first difference - far cheaper than encoding when the data differs
+			int last_len;
+			const auto last_args = glue_flat_args(last.get(), last_len);
+			if (glue_args_equal(args, len, last_args, last_len))
+			{
+				return last;
+			}
+		}
+
+		auto block = encode(args, len);
+		std::lock_guard<std::mutex> lock(last_mutex_);
+		last_block_ = block;
+		return block;
+	}
+
+	std::mutex last_mutex_;
+	std::shared_ptr<const void> last_block_;
+};
+
+int glue_loopback_branch::push(const glue_arg* args, int len)
+{
+	std::shared_ptr<glue_loopback_stream> stream;
+	{
+		auto& bus = glue_loopback::instance();
+		std::lock_guard<std::mutex> lock(bus.mutex);
+		stream = stream_;
+	}
+	return stream != nullptr ? stream->publish(&name_, args, len) : -1;
+}
+
+void glue_loopback_stream_subscription::close()
+{
+	auto& bus = glue_loopback::instance();
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	auto& subscriptions = bus.stream_subscriptions;
+	subscriptions.erase(std::remove_if(subscriptions.begin(), subscriptions.end(),
+		[this](const std::shared_ptr<glue_loopback_stream_subscription>& s) { return s.get() == this; }), subscriptions.end());
+	for (const auto& stream : bus.streams)
+	{
+		auto& subscribers = stream->subscribers;
+		subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+			[this](const glue_loopback_stream::subscriber& s) { return s.subscription.get() == this; }), subscribers.end());
+	}
+}
+
+void glue_loopback::attach(const std::shared_ptr<glue_loopback_stream_subscription>& subscription)
+{
+	for (const auto& stream : streams)
+	{
+		if (subscription->single && subscription->offered > 0)
+		{
+			return;
+		}
+		if (stream->name == subscription->stream)
+		{
+			++subscription->offered;
+			stream->offer(stream, subscription);
+		}
+	}
+}
+
+const void* __cdecl glue_register_streaming_endpoint(const char* endpoint_name, stream_callback_function stream_callback, invocation_callback_function invocation_callback, COOKIE cookie)
+{
+	if (endpoint_name == nullptr)
+	{
+		return nullptr;
+	}
+
+	auto& bus = glue_loopback::instance();
+	const auto stream = std::make_shared<glue_loopback_stream>();
+	stream->name = endpoint_name;
+	stream->accept = stream_callback;
+	stream->invoke = invocation_callback;
+	stream->cookie = cookie;
+
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	bus.streams.push_back(stream);
+	if (invocation_callback != nullptr)
+	{
+		bus.methods.push_back(glue_loopback_method{ endpoint_name, invocation_callback, cookie, stream.get() });
+	}
+	bus.post_status(endpoint_name, true);
+
+	// subscriptions made before the stream was registered
+	for (const auto& subscription : bus.stream_subscriptions)
+	{
+		if (subscription->stream == stream->name && (!subscription->single || subscription->offered == 0))
+		{
+			++subscription->offered;
+			stream->offer(stream, subscription);
+		}
+	}
+	return bus.add(stream);
+}
+
+const void* __cdecl glue_open_streaming_branch(const void* stream, const char* branch)
+{
+	auto& bus = glue_loopback::instance();
+	std::lock_guard<std::mutex> lock(bus.mutex);
+	const auto owner = bus.find<glue_loopback_stream>(stream);
+	if (owner == nullptr)
+	{
+		return nullptr;
+	}
+
+	const std::string name = branch != nullptr ? branch : "";
+	for (const auto& open : owner->branches)
+	{
+		if (open.first == name)
+		{
+			return open.second.get();
+		}
+	}
+
+	const auto opened = std::make_shared<glue_loopback_branch>(owner, name);
+	owner->branches.emplace_back(name, opened);
+	return bus.add(opened);
+}
+
+namespace
+{
+	const void* glue_loopback_subscribe(const char* stream, payload_function callback, const glue_arg* args, int len, COOKIE cookie, bool single)
+	{
+		if (stream == nullptr || callback == nullptr)
+		{
+			return nullptr;
+		}
+
+		auto& bus = glue_loopback::instance();
+		const auto subscription = std::make_shared<glue_loopback_stream_subscription>();
+		subscription->stream = stream;
+		subscription->callback = callback;
+		subscription->cookie = cookie;
+		subscription->single = single;
+		subscription->request.block = glue_loopback_encode(args, len);
+
+		std::lock_guard<std::mutex> lock(bus.mutex);
+		subscription->request.origin = bus.app_name;
+		bus.stream_subscriptions.push_back(subscription);
+		bus.attach(subscription);
+		return bus.add(subscription);
+	}
+}
+
+const void* __cdecl glue_subscribe_stream(const char* stream, payload_function stream_callback, const glue_arg* args, int len, COOKIE cookie)
+{
+	return glue_loopback_subscribe(stream, stream_callback, args, len, cookie, false);
+}
+
+const void* __cdecl glue_subscribe_single_stream(const char* stream, payload_function stream_callback, const glue_arg* args, int len, COOKIE cookie)
+{
+	return glue_loopback_subscribe(stream, stream_callback, args, len, cookie, true);
+}
+
+int __cdecl glue_get_stream_stats(const void* stream, glue_stream_stats* stats)
+{
+	if (stats == nullptr)
+	{
+		return -1;
+	}
+
+	auto& bus = glue_loopback::instance();
+	std::shared_ptr<glue_loopback_stream> found;
+	{
+		std::lock_guard<std::mutex> lock(bus.mutex);
+		found = bus.find<glue_loopback_stream>(stream);
+		if (found == nullptr)
+		{
+			const auto branch = bus.find<glue_loopback_branch>(stream);
+			found = branch != nullptr ? branch->stream() : nullptr;
+		}
+	}
+	if (found == nullptr)
+	{
+		return -1;
+	}
+
+	const auto& counters = *found->stats;
+	stats->pushes = counters.pushes.load(std::memory_order_relaxed);
+	stats->encodes = counters.encodes.load(std::memory_order_relaxed);
+	stats->deliveries = counters.deliveries.load(std::memory_order_relaxed);
+	stats->encode_ns = counters.encode_ns.load(std::memory_order_relaxed);
+	stats->fan_out_ns = counters.fan_out_ns.load(std::memory_order_relaxed);
+	stats->last_encode_ns = counters.last_encode_ns.load(std::memory_order_relaxed);
+	stats->last_fan_out_ns = counters.last_fan_out_ns.load(std::memory_order_relaxed);
+	return 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "../GlueCLILib.h"
+
+/*
+ * Invocations of the loopback backend beyond GlueCLILib.h - not exported by GlueCLILib.dll, so use
+ * them only in builds against the loopback (these define GLUE_LOOPBACK):
+ *
+ *	const auto targets = glue_invoke_each("Pricing.Quote", args, len, &on_quote, cookie);
+ *	// on_quote is called once per target, as each of them responds
+ */
+
+/**
+ * \brief Invokes all methods available at the moment of invocation - as glue_invoke_all, but the result of
+ * each target is delivered on its own, as soon as the target responds.
+ * \param endpoint_name The name of the method to be invoked - for all targets.
+ * \param args Invocation arguments.
+ * \param len The size of the invocation arguments.
+ * \param callback Callback to be called with the result of each target - the callback may run before the call returns.
+ * \param cookie Optional callback cookie.
+ * \return The number of targets invoked (the number of results to come) or -1.
+ */
+extern "C" GLUE_LIB_API int __cdecl glue_invoke_each(const char* endpoint_name, const glue_arg* args, int len, payload_function callback = nullptr, COOKIE cookie = nullptr);
@@ -0,0 +1,39 @@
+#pragma once
+#include "../GlueCLILib.h"
+
+/*
+ * Diagnostics of the loopback backend - not exported by GlueCLILib.dll, so use them only in builds
+ * against the loopback (these define GLUE_LOOPBACK):
+ *
+ *	glue_stream_stats stats;
+ *	if (glue_get_stream_stats(stream, &stats) == 0 && stats.pushes > 0)
+ *	{
+ *		const auto encode_per_push = stats.encode_ns / stats.pushes;
+ *	}
+ */
+
+/**
+ * \brief Counters and timings of the pushes to a stream, cumulative since the stream was registered.
+ * Only pushes reaching at least one subscriber are counted.
+ */
+struct glue_stream_stats
+{
+	long long pushes;
+	// payloads encoded - one per push at most; pushes sharing the buffer of an equal payload pushed to another branch encode none
+	long long encodes;
+	// payloads handed to subscriber callbacks
+	long long deliveries;
+	// time spent encoding payloads and delivering them to all their subscribers (including the subscribers' callbacks)
+	long long encode_ns;
+	long long fan_out_ns;
+	// of the last push
+	long long last_encode_ns;
+	long long last_fan_out_ns;
+};
+
+/**
+ * \brief Gets the counters and timings of a stream.
+ * \param stream A stream registered via glue_register_streaming_endpoint or a branch opened via glue_open_streaming_branch.
+ * \return 0 or -1 if the stream is not known (e.g. it has been destroyed).
+ */
+extern "C" GLUE_LIB_API int __cdecl glue_get_stream_stats(const void* stream, glue_stream_stats* stats);
@@ -54,7 +54,7 @@ CGlueCExpMFCApp theApp;
 void glue_window_callback(const glue_window_command state, const char* state_message, COOKIE cookie)
 {
 	auto main_wnd = static_cast<CMainFrame*>(const_cast<void*>(cookie));
-	main_wnd->OnWindowEvent(state, state_message);
+	main_wnd->OnGlueWindowEvent(state, state_message);
 }
 
 // handle app instance commands
@@ -95,7 +95,7 @@ void factory_callback(glue_app_command command, const void* callback, const glue
 			[](glue_window_command command, const char* context_name, COOKIE cookie)
 			{
 				auto main_wnd = static_cast<CMainFrame*>(const_cast<void*>(cookie));
-				main_wnd->OnWindowEvent(command, context_name);
+				main_wnd->OnGlueWindowEvent(command, context_name);
 			}, pFrame);
 		break;
 	}
@@ -211,7 +211,7 @@ BOOL CGlueCExpMFCApp::InitInstance()
 							[](glue_window_command command, const char* context_name, COOKIE cookie)
 							{
 								auto main_wnd = static_cast<CMainFrame*>(const_cast<void*>(cookie));
-								main_wnd->OnWindowEvent(command, context_name);
+								main_wnd->OnGlueWindowEvent(command, context_name);
 							}, pFrame);
 
 						// or alternatively, factories can 'deny' creating instances by pushing failure
@@ -248,7 +248,7 @@ BOOL CGlueCExpMFCApp::InitInstance()
 				[](glue_window_command command, const char* context_name, COOKIE cookie)
 				{
 					auto main_wnd = static_cast<CMainFrame*>(const_cast<void*>(cookie));
-					main_wnd->OnWindowEvent(command, context_name);
+					main_wnd->OnGlueWindowEvent(command, context_name);
 				}, "Main MFC", app->m_pMainWnd);			
 
 			/****
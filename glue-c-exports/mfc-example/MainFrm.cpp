@@ -24,6 +24,7 @@ BEGIN_MESSAGE_MAP(CMainFrame, CFrameWnd)
 	ON_WM_CLOSE()
 	ON_COMMAND_RANGE(ID_VIEW_APPLOOK_WIN_2000, ID_VIEW_APPLOOK_WINDOWS_7, &CMainFrame::OnApplicationLook)
 	ON_UPDATE_COMMAND_UI_RANGE(ID_VIEW_APPLOOK_WIN_2000, ID_VIEW_APPLOOK_WINDOWS_7, &CMainFrame::OnUpdateApplicationLook)
+	ON_MESSAGE(WM_GLUE_CONTEXT_UPDATES, &CMainFrame::OnGlueContextUpdates)
 END_MESSAGE_MAP()
 
 static UINT indicators[] =
@@ -37,6 +38,7 @@ static UINT indicators[] =
 // CMainFrame construction/destruction
 
 CMainFrame::CMainFrame() noexcept
+	: m_contextUpdates([this] { ::PostMessage(GetSafeHwnd(), WM_GLUE_CONTEXT_UPDATES, 0, 0); })
 {
 	// TODO: add member initialization code here
 }
@@ -213,6 +215,31 @@ void CMainFrame::OnUpdateApplicationLook(CCmdUI* pCmdUI)
 	pCmdUI->SetRadio(theApp.m_nAppLook == pCmdUI->m_nID);
 }
 
+/**
+ * \brief Window event received on the Glue thread - data updates are left to the UI thread, conflated,
+ * so a burst of updates to a context refreshes the window once rather than once per update
+ */
+void CMainFrame::OnGlueWindowEvent(glue_window_command command, const char* context_name)
+{
+	if (command == glue_window_command::data_update)
+	{
+		m_contextUpdates.offer(context_name, nullptr, nullptr);
+		return;
+	}
+
+	OnWindowEvent(command, context_name);
+}
+
+LRESULT CMainFrame::OnGlueContextUpdates(WPARAM wParam, LPARAM lParam)
+{
+	// updates conflated meanwhile are counted - see ConflatedContextUpdates
+	m_contextUpdates.drain([this](const char* context_name, const char*, const glue_value*, int)
+		{
+			OnWindowEvent(glue_window_command::data_update, context_name);
+		});
+	return 0;
+}
+
 
 BOOL CMainFrame::LoadFrame(UINT nIDResource, DWORD dwDefaultStyle, CWnd* pParentWnd, CCreateContext* pContext)
 {
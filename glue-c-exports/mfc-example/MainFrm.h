@@ -4,6 +4,10 @@
 
 #pragma once
 #include "ChildView.h"
+#include "../glue-cli-lib/GlueConflate.h"
+
+// posted when context updates are pending
+#define WM_GLUE_CONTEXT_UPDATES (WM_APP + 1)
 
 class CMainFrame : public CFrameWnd
 {
@@ -18,6 +22,9 @@ public:
 
 // Operations
 public:
+	void OnGlueWindowEvent(glue_window_command command, const char* context_name);
+	// data updates replaced by later ones before the UI thread handled them
+	long long ConflatedContextUpdates() const { return m_contextUpdates.conflated(); }
 
 // Overrides
 public:
@@ -38,6 +45,9 @@ protected:  // control bar embedded members
 	CStatusBar        m_wndStatusBar;
 	CButton			  m_button;
 
+	// data updates received on the Glue thread - handled on the UI thread, once per context
+	glue_conflating_queue m_contextUpdates;
+
 // Generated message map functions
 protected:
 	afx_msg int OnCreate(LPCREATESTRUCT lpCreateStruct);
@@ -45,6 +55,7 @@ protected:
 	afx_msg void OnClose();
 	afx_msg void OnApplicationLook(UINT id);
 	afx_msg void OnUpdateApplicationLook(CCmdUI* pCmdUI);
+	afx_msg LRESULT OnGlueContextUpdates(WPARAM wParam, LPARAM lParam);
 	DECLARE_MESSAGE_MAP()
 
 };